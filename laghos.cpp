@@ -58,6 +58,10 @@
 
 #include "laghos_solver.hpp"
 #include "laghos_timeinteg.hpp"
+#include "laghos_checkpoint.hpp"
+#include "laghos_snapshot.hpp"
+#include "laghos_output.hpp"
+#include <cstring>
 #include <fstream>
 
 using namespace std;
@@ -72,11 +76,47 @@ void v0(const Vector &, Vector &);
 double e0(const Vector &);
 double gamma(const Vector &);
 void display_banner(ostream & os);
+void GetMemoryReport(const LagrangianHydroOperator &oper, const Vector &S,
+                     int ode_solver_type, ParFiniteElementSpace &H1FESpace,
+                     ParFiniteElementSpace &L2FESpace, MemoryReport &mem);
+
+// Same as MPI_Session, but MPI is initialized with MPI_THREAD_FUNNELED. The
+// OpenMP zone loops and the asynchronous output thread make the process
+// multithreaded, while only the main thread calls MPI.
+class MPIFunneledSession
+{
+private:
+   int world_rank, world_size;
+
+public:
+   MPIFunneledSession(int &argc, char **&argv)
+   {
+      int provided;
+      MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+      MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+      MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+      if (provided < MPI_THREAD_FUNNELED)
+      {
+         if (world_rank == 0)
+         {
+            cout << "The MPI library does not provide MPI_THREAD_FUNNELED."
+                 << endl;
+         }
+         MPI_Abort(MPI_COMM_WORLD, 1);
+      }
+   }
+
+   ~MPIFunneledSession() { MPI_Finalize(); }
+
+   int WorldRank() const { return world_rank; }
+   int WorldSize() const { return world_size; }
+   bool Root() const { return world_rank == 0; }
+};
 
 int main(int argc, char *argv[])
 {
    // Initialize MPI.
-   MPI_Session mpi(argc, argv);
+   MPIFunneledSession mpi(argc, argv);
    int myid = mpi.WorldRank();
 
    // Print the banner.
@@ -90,18 +130,40 @@ int main(int argc, char *argv[])
    int order_v = 2;
    int order_e = 1;
    int ode_solver_type = 4;
+   int mr_levels = 3;
    double t_final = 0.6;
    double cfl = 0.5;
    double cg_tol = 1e-8;
    int cg_max_iter = 300;
+   bool pipelined_cg = false;
+   int cg_recycle = 0;
+   int cheb_degree = 0;
+   bool amg = false;
    int max_tsteps = -1;
+   bool adaptive_retry = false;
    bool p_assembly = true;
+   int simd_width = 0;
+   bool fused_force = false;
+   int energy_solver = 0;
+   const char *precision = "double";
+   bool recompute_jac0inv = false;
+   bool dense_mass = false;
+   bool stream_probe = false;
+   int stream_mb = 0;
    bool visualization = false;
    int vis_steps = 5;
    bool visit = false;
    bool gfprint = false;
+   bool snapshots = false;
+   bool snapshot_float = false;
+   int async_slots = 0;
+   const char *diag_file = "";
    const char *basename = "results/Laghos";
    int partition_type = 111;
+   const char *bench_report = "";
+   bool memory_report = false;
+   int checkpoint_every = 0;
+   const char *restart_dir = "";
 
    OptionsParser args(argc, argv);
    args.AddOption(&mesh_file, "-m", "--mesh",
@@ -118,7 +180,10 @@ int main(int argc, char *argv[])
    args.AddOption(&ode_solver_type, "-s", "--ode-solver",
                   "ODE solver: 1 - Forward Euler,\n\t"
                   "            2 - RK2 SSP, 3 - RK3 SSP, 4 - RK4, 6 - RK6,\n\t"
-                  "            7 - RK2Avg.");
+                  "            7 - RK2Avg, 8 - multirate (PA only).");
+   args.AddOption(&mr_levels, "-mrl", "--multirate-levels",
+                  "Number of zone levels of the multirate solver: the zones take\n\t"
+                  "steps of 1, 2, ..., 2^(levels-1) fine steps.");
    args.AddOption(&t_final, "-tf", "--t-final",
                   "Final time; start time is 0.");
    args.AddOption(&cfl, "-cfl", "--cfl", "CFL-condition number.");
@@ -126,11 +191,58 @@ int main(int argc, char *argv[])
                   "Relative CG tolerance (velocity linear solve).");
    args.AddOption(&cg_max_iter, "-cgm", "--cg-max-steps",
                   "Maximum number of CG iterations (velocity linear solve).");
+   args.AddOption(&pipelined_cg, "-pcg", "--pipelined-cg", "-no-pcg",
+                  "--no-pipelined-cg",
+                  "Use pipelined CG for the velocity linear solve (one\n\t"
+                  "nonblocking reduction per iteration).");
+   args.AddOption(&cg_recycle, "-cgr", "--cg-recycle",
+                  "Number of previous velocity solutions used for the initial\n\t"
+                  "CG guess (0 - zero initial guess).");
+   args.AddOption(&cheb_degree, "-cheb", "--chebyshev-degree",
+                  "Degree of the Chebyshev preconditioner for the PA velocity\n\t"
+                  "linear solve (0 - Jacobi preconditioner).");
+   args.AddOption(&amg, "-amg", "--amg-preconditioner", "-no-amg",
+                  "--no-amg-preconditioner",
+                  "Use BoomerAMG instead of Jacobi for the full assembly velocity\n\t"
+                  "linear solve.");
    args.AddOption(&max_tsteps, "-ms", "--max-steps",
                   "Maximum number of steps (negative means no restriction).");
+   args.AddOption(&adaptive_retry, "-dtr", "--adaptive-retry", "-no-dtr",
+                  "--no-adaptive-retry",
+                  "Repeat the steps rejected by the time step estimate with 0.9\n\t"
+                  "times the estimate (in [0.1, 0.85] dt), instead of 0.85 dt.");
    args.AddOption(&p_assembly, "-pa", "--partial-assembly", "-fa",
                   "--full-assembly",
                   "Activate 1D tensor-based assembly (partial assembly).");
+   args.AddOption(&simd_width, "-sw", "--simd-width",
+                  "Zone-interleaved quadrature data layout for partial assembly:\n\t"
+                  "0 - standard layout, 4 or 8 - zones per SIMD block.");
+   args.AddOption(&fused_force, "-ff", "--fused-force", "-no-ff",
+                  "--no-fused-force",
+                  "Compute the force right-hand sides together with the quadrature\n\t"
+                  "data, without storing the stress (partial assembly only).");
+   args.AddOption(&energy_solver, "-ems", "--energy-mass-solver",
+                  "Energy mass solver for partial assembly: 0 - CG in each zone,\n\t"
+                  "1 - batched zone inverses, 2 - batched CG (no stored matrices).");
+   args.AddOption(&precision, "-prec", "--precision",
+                  "Precision of the partial assembly quadrature data: double, or\n\t"
+                  "mixed - float storage with double kernels and solvers.");
+   args.AddOption(&recompute_jac0inv, "-rj0", "--recompute-jac0inv", "-no-rj0",
+                  "--no-recompute-jac0inv",
+                  "Recompute the initial Jacobians from the initial mesh positions\n\t"
+                  "when needed, instead of storing them (partial assembly only).");
+   args.AddOption(&dense_mass, "-dm", "--dense-mass", "-no-dm",
+                  "--no-dense-mass",
+                  "With partial assembly, also assemble the velocity mass matrix and\n\t"
+                  "the dense zone energy mass matrices, and compute the energies\n\t"
+                  "with them. Full assembly always assembles them.");
+   args.AddOption(&stream_probe, "-stream", "--stream-probe", "-no-stream",
+                  "--no-stream-probe",
+                  "Measure the memory bandwidth at startup, as the reference of\n\t"
+                  "the roofline report (partial assembly only).");
+   args.AddOption(&stream_mb, "-stream-mb", "--stream-array-mb",
+                  "Size in MB of each array of the bandwidth probe of every rank.\n\t"
+                  "0 = four times the last level cache, at least 32 MB.");
    args.AddOption(&visualization, "-vis", "--visualization", "-no-vis",
                   "--no-visualization",
                   "Enable or disable GLVis visualization.");
@@ -140,8 +252,36 @@ int main(int argc, char *argv[])
                   "Enable or disable VisIt visualization.");
    args.AddOption(&gfprint, "-print", "--print", "-no-print", "--no-print",
                   "Enable or disable result output (files in mfem format).");
+   args.AddOption(&snapshots, "-snap", "--snapshots", "-no-snap",
+                  "--no-snapshots",
+                  "Enable or disable aggregated binary snapshots (one MPI-IO file\n\t"
+                  "per output step, with the mesh topology written once).");
+   args.AddOption(&snapshot_float, "-snap32", "--snapshot-float32", "-snap64",
+                  "--snapshot-float64",
+                  "Precision of the values in the binary snapshots.");
+   args.AddOption(&async_slots, "-aio", "--async-output",
+                  "Write the -print and -snap output on a background thread, with\n\t"
+                  "this many staging buffers (0 - synchronous output).");
+   args.AddOption(&diag_file, "-diag", "--diagnostics",
+                  "Monitor the energies, extrema and mass at every timestep, with\n\t"
+                  "one nonblocking reduction per step, and write them to this\n\t"
+                  "file. Empty string means only at the output steps.");
    args.AddOption(&basename, "-k", "--outputfilename",
                   "Name of the visit dump files");
+   args.AddOption(&bench_report, "-br", "--bench-report",
+                  "Write the configuration, sizes, step counts, timings and rates\n\t"
+                  "of the run to this file: CSV if its name ends with .csv, JSON\n\t"
+                  "otherwise. Empty string means no report.");
+   args.AddOption(&memory_report, "-mem", "--memory-report", "-no-mem",
+                  "--no-memory-report",
+                  "Print the memory of the main data structures (min/max over the\n\t"
+                  "ranks) and the peak RSS at startup and at the end of the run.");
+   args.AddOption(&checkpoint_every, "-ce", "--checkpoint-every",
+                  "Write a binary checkpoint every n-th timestep, to the directory\n\t"
+                  "<outputfilename>_checkpoint_<step> (0 - no checkpoints).");
+   args.AddOption(&restart_dir, "-rst", "--restart",
+                  "Restart from this checkpoint directory. The run options and the\n\t"
+                  "number of MPI tasks must be those of the checkpointed run.");
    args.AddOption(&partition_type, "-pt", "--partition",
                   "Customized x/y/z Cartesian MPI partitioning of the serial mesh.\n\t"
                   "Here x,y,z are relative task ratios in each direction.\n\t"
@@ -159,6 +299,8 @@ int main(int argc, char *argv[])
    }
    if (mpi.Root()) { args.PrintOptions(cout); }
 
+   profiler.Begin("Setup");
+
    // Read the serial mesh from the given mesh file on all processors.
    // Refine the mesh in serial to increase the resolution.
    Mesh *mesh = new Mesh(mesh_file, 1, 1);
@@ -174,6 +316,94 @@ int main(int argc, char *argv[])
       }
    }
 
+   if (simd_width != 0 && simd_width != 4 && simd_width != 8)
+   {
+      if (myid == 0)
+      {
+         cout << "Unsupported SIMD width: " << simd_width << '\n';
+      }
+      delete mesh;
+      MPI_Finalize();
+      return 3;
+   }
+   if (strcmp(precision, "double") != 0 && strcmp(precision, "mixed") != 0)
+   {
+      if (myid == 0)
+      {
+         cout << "Unknown precision: " << precision << '\n';
+      }
+      delete mesh;
+      MPI_Finalize();
+      return 3;
+   }
+   if (mr_levels < 1 || mr_levels > 16)
+   {
+      if (myid == 0)
+      {
+         cout << "Invalid number of multirate levels: " << mr_levels << '\n';
+      }
+      delete mesh;
+      MPI_Finalize();
+      return 3;
+   }
+   if (energy_solver < 0 || energy_solver > 2)
+   {
+      if (myid == 0)
+      {
+         cout << "Unknown energy mass solver: " << energy_solver << '\n';
+      }
+      delete mesh;
+      MPI_Finalize();
+      return 3;
+   }
+   bool mixed_precision = (strcmp(precision, "mixed") == 0);
+   if (mixed_precision && !p_assembly)
+   {
+      mixed_precision = false;
+      if (myid == 0)
+      {
+         cout << "Mixed precision needs PA. Switching to double." << endl;
+      }
+   }
+   if (recompute_jac0inv && !p_assembly)
+   {
+      recompute_jac0inv = false;
+      if (myid == 0)
+      {
+         cout << "Recomputing Jac0inv needs PA. Storing it." << endl;
+      }
+   }
+   if (!p_assembly) { simd_width = 0; }
+   if (ode_solver_type == 8 && !p_assembly)
+   {
+      ode_solver_type = 7;
+      if (myid == 0)
+      {
+         cout << "The multirate solver needs PA. Switching to RK2Avg." << endl;
+      }
+   }
+   if (cheb_degree > 0 && !p_assembly)
+   {
+      // The full assembly solve uses Jacobi or BoomerAMG, see -amg.
+      cheb_degree = 0;
+      if (myid == 0)
+      {
+         cout << "The Chebyshev preconditioner needs PA. Switching it off."
+              << endl;
+      }
+   }
+   if (fused_force && (!p_assembly || ode_solver_type >= 7))
+   {
+      // RK2Avg and the multirate solver compute the energy right-hand side
+      // with an updated velocity.
+      fused_force = false;
+      if (myid == 0)
+      {
+         cout << "The fused force computation needs PA and an RK solver other "
+              << "than RK2Avg and the multirate one. Switching it off." << endl;
+      }
+   }
+
    // Parallel partitioning of the mesh.
    ParMesh *pmesh = NULL;
    const int num_tasks = mpi.WorldSize(); int unit;
@@ -280,6 +510,8 @@ int main(int argc, char *argv[])
    MPI_Reduce(&nzones, &nzones_max, 1, MPI_INT, MPI_MAX, 0, pmesh->GetComm());
    if (myid == 0)
    { cout << "Zones min/max: " << nzones_min << " " << nzones_max << endl; }
+   if (mpi.Root())
+   { cout << "Threads per MPI task: " << GetNumThreads() << endl; }
 
 
    // Define the parallel finite element spaces. We use:
@@ -315,6 +547,7 @@ int main(int argc, char *argv[])
       case 4: ode_solver = new RK4Solver; break;
       case 6: ode_solver = new RK6Solver; break;
       case 7: ode_solver = new RK2AvgSolver; break;
+      case 8: ode_solver = new MultirateSolver(mr_levels); break;
       default:
          if (myid == 0)
          {
@@ -418,17 +651,61 @@ int main(int argc, char *argv[])
 
    LagrangianHydroOperator oper(S.Size(), H1FESpace, L2FESpace,
                                 ess_tdofs, rho, source, cfl, mat_gf_coeff,
-                                visc, p_assembly, cg_tol, cg_max_iter);
+                                visc, p_assembly, cg_tol, cg_max_iter,
+                                pipelined_cg, cg_recycle, cheb_degree, amg,
+                                simd_width, fused_force, energy_solver,
+                                mixed_precision, recompute_jac0inv,
+                                dense_mass);
+
+   if (p_assembly && stream_probe)
+   {
+      // All ranks run the probe at the same time, so that each one measures
+      // its share of the node bandwidth.
+      // The arrays are several times the last level cache, so that the triad
+      // runs from memory also when only a few ranks share the cache.
+      long bytes = (long) stream_mb << 20;
+      if (bytes <= 0) { bytes = max(4 * GetLastLevelCacheSize(), 32L << 20); }
+      MPI_Barrier(pmesh->GetComm());
+      const double my_bw =
+         StreamTriadBandwidth((int) (bytes / sizeof(double)), 5);
+      double bw;
+      MPI_Allreduce(&my_bw, &bw, 1, MPI_DOUBLE, MPI_SUM, pmesh->GetComm());
+      oper.SetStreamBandwidth(bw);
+      if (mpi.Root())
+      {
+         cout << "STREAM triad bandwidth (all ranks): " << 1e-9 * bw
+              << " GB/s" << endl;
+      }
+   }
 
    socketstream vis_rho, vis_v, vis_e;
    char vishost[] = "localhost";
    int  visport   = 19916;
 
+   // State of the time loop, which is overwritten when restarting. The mesh
+   // and the spaces above are set up as in the checkpointed run, and then the
+   // solution, which includes the mesh positions, is replaced.
+   CheckpointState cs;
+   const bool restart = (restart_dir[0] != '\0');
+   if (restart)
+   {
+      LoadCheckpoint(restart_dir, pmesh->GetComm(), cs, S, oper);
+      pmesh->NewNodes(x_gf, false);
+      if (mpi.Root())
+      {
+         cout << "Restarting from " << restart_dir << " at step " << cs.ti
+              << ", t = " << cs.t << endl;
+      }
+   }
+
    ParGridFunction rho_gf;
-   if (visualization || visit) { oper.ComputeDensity(rho_gf); }
+   if (visualization || visit || snapshots) { oper.ComputeDensity(rho_gf); }
 
-   const double energy_init = oper.InternalEnergy(e_gf) +
-                              oper.KineticEnergy(v_gf);
+   if (!restart)
+   {
+      cs.energy_init = oper.InternalEnergy(e_gf) + oper.KineticEnergy(v_gf);
+   }
+   const double energy_init = cs.energy_init;
 
    if (visualization)
    {
@@ -465,21 +742,72 @@ int main(int argc, char *argv[])
       visit_dc.RegisterField("Density",  &rho_gf);
       visit_dc.RegisterField("Velocity", &v_gf);
       visit_dc.RegisterField("Specific Internal Energy", &e_gf);
-      visit_dc.SetCycle(0);
-      visit_dc.SetTime(0.0);
+      visit_dc.SetCycle(cs.ti);
+      visit_dc.SetTime(cs.t);
       visit_dc.Save();
    }
 
+   // Aggregated binary snapshots, which start with the initial state. After a
+   // restart, the index keeps the snapshots of the earlier steps.
+   SnapshotWriter *snapshot_writer = NULL;
+   if (snapshots)
+   {
+      snapshot_writer = new SnapshotWriter(basename, H1FESpace, L2FESpace,
+                                           snapshot_float,
+                                           restart ? cs.ti : -1);
+      snapshot_writer->Save(cs.ti, cs.t, x_gf, v_gf, e_gf, rho_gf);
+   }
+   AsyncOutput *async_output = NULL;
+   if (async_slots > 0 && (gfprint || snapshots))
+   {
+      async_output = new AsyncOutput(async_slots, *pmesh, H1FESpace,
+                                     L2FESpace, basename, gfprint,
+                                     snapshot_writer);
+   }
+
    // Perform time-integration (looping over the time iterations, ti, with a
    // time-step dt). The object oper is of type LagrangianHydroOperator that
    // defines the Mult() method that used by the time integrators.
    ode_solver->Init(oper);
+   if (memory_report)
+   {
+      MemoryReport mem;
+      GetMemoryReport(oper, S, ode_solver_type, H1FESpace, L2FESpace, mem);
+      mem.Print(pmesh->GetComm(), cout, "Memory usage at startup");
+   }
    oper.ResetTimeStepEstimate();
-   double t = 0.0, dt = oper.GetTimeStepEstimate(S), t_old;
+   // The multirate steps have mr_substeps fine steps, each within the time
+   // step estimate of the fastest zones.
+   const int mr_substeps = (ode_solver_type == 8) ? 1 << (mr_levels - 1) : 1;
+   // After a restart, LoadCheckpoint has already updated the quadrature data,
+   // as GetTimeStepEstimate does.
+   double t = cs.t, t_old,
+          dt = restart ? cs.dt : oper.GetTimeStepEstimate(S) * mr_substeps;
+   profiler.End();
+   profiler.Begin("Time loop");
    bool last_step = false;
-   int steps = 0;
+   int steps = cs.steps, rejected_steps = cs.rejected_steps;
+   // Heap allocations in the time steps after the first one (debug builds).
+   long heap_allocs = 0;
+   int heap_steps = 0;
    BlockVector S_old(S);
-   for (int ti = 1; !last_step; ti++)
+   // Global monitoring quantities. Their reduction is started at the end of a
+   // step and completes during the next one, or right away at output steps.
+   Diagnostics diag(pmesh->GetComm());
+   const bool diag_every_step = (diag_file[0] != '\0');
+   ofstream diag_log;
+   if (diag_every_step && mpi.Root())
+   {
+      // A restarted run continues the log of the checkpointed one.
+      if (restart) { diag_log.open(diag_file, ios::app); }
+      else
+      {
+         diag_log.open(diag_file);
+         Diagnostics::PrintHeader(diag_log);
+      }
+      diag.SetLog(&diag_log);
+   }
+   for (int ti = cs.ti + 1; !last_step; ti++)
    {
       if (t + dt >= t_final)
       {
@@ -494,16 +822,60 @@ int main(int argc, char *argv[])
 
       // S is the vector of dofs, t is the current time, and dt is the time step
       // to advance.
+      const long allocs_begin = GetHeapAllocationCount();
+      profiler.Begin("Step");
       ode_solver->Step(S, t, dt);
+      profiler.End();
       steps++;
 
-      // Adaptive time step control.
-      const double dt_est = oper.GetTimeStepEstimate(S);
-      if (dt_est < dt)
+      // Adaptive time step control. A step that was aborted in one of its
+      // stages, due to mesh tangling, is repeated right away. The global
+      // reduction of the estimate is posted right after the quadrature data
+      // update of the new state, and completed after the local work of the
+      // new state: the mesh update, the local diagnostics and, at output
+      // steps, the density. These are computed provisionally, and a rejected
+      // step discards them; the next accepted step sets them again.
+      const bool aborted = oper.StepAborted(),
+                 output_step = last_step || (ti % vis_steps) == 0;
+      double dt_est = 0.0;
+      if (!aborted)
+      {
+         profiler.Begin("Time step estimate");
+         oper.StartTimeStepEstimate(S);
+         profiler.End();
+
+         // Make sure that the mesh corresponds to the new solution state.
+         // This is needed, because some time integrators use different S-type
+         // vectors and the oper object might have redirected the mesh
+         // positions to those. A rejected step restores S in place.
+         pmesh->NewNodes(x_gf, false);
+         if (diag_every_step || output_step)
+         {
+            ProfileRegion region("Diagnostics");
+            oper.SetDiagnostics(S, diag);
+         }
+         diag.Test();
+         if (output_step && (visualization || visit || gfprint || snapshots))
+         {
+            ProfileRegion region("Output");
+            oper.ComputeDensity(rho_gf);
+         }
+
+         dt_est = oper.FinishTimeStepEstimate() * mr_substeps;
+      }
+      const bool rejected = aborted || dt_est < dt;
+      if (allocs_begin >= 0 && steps > 1)
+      {
+         heap_allocs += GetHeapAllocationCount() - allocs_begin;
+         heap_steps++;
+      }
+      if (rejected)
       {
          // Repeat (solve again) with a decreased time step - decrease of the
          // time estimate suggests appearance of oscillations.
-         dt *= 0.85;
+         ProfileRegion region("Rejected step");
+         rejected_steps++;
+         dt = oper.RetryTimeStep(t_old, dt, dt_est, adaptive_retry);
          if (dt < numeric_limits<double>::epsilon())
          { MFEM_ABORT("The time step crashed!"); }
          t = t_old;
@@ -515,16 +887,13 @@ int main(int argc, char *argv[])
       }
       else if (dt_est > 1.25 * dt) { dt *= 1.02; }
 
-      // Make sure that the mesh corresponds to the new solution state. This is
-      // needed, because some time integrators use different S-type vectors
-      // and the oper object might have redirected the mesh positions to those.
-      pmesh->NewNodes(x_gf, false);
+      if (diag_every_step || output_step) { diag.Start(ti, t); }
 
-      if (last_step || (ti % vis_steps) == 0)
+      if (output_step)
       {
-         double loc_norm = e_gf * e_gf, tot_norm;
-         MPI_Allreduce(&loc_norm, &tot_norm, 1, MPI_DOUBLE, MPI_SUM,
-                       pmesh->GetComm());
+         ProfileRegion region("Output");
+         diag.Finish();
+         const double tot_norm = diag.Get(Diagnostics::E_NORM2);
          if (mpi.Root())
          {
             cout << fixed;
@@ -539,7 +908,6 @@ int main(int argc, char *argv[])
          // another set of GLVis connections (one from each rank):
          MPI_Barrier(pmesh->GetComm());
 
-         if (visualization || visit || gfprint) { oper.ComputeDensity(rho_gf); }
          if (visualization)
          {
             int Wx = 0, Wy = 0; // window position
@@ -568,7 +936,17 @@ int main(int argc, char *argv[])
             visit_dc.Save();
          }
 
-         if (gfprint)
+         if (async_output)
+         {
+            async_output->Submit(ti, t, x_gf, v_gf, e_gf, rho_gf);
+         }
+
+         if (snapshots && !async_output)
+         {
+            snapshot_writer->Save(ti, t, x_gf, v_gf, e_gf, rho_gf);
+         }
+
+         if (gfprint && !async_output)
          {
             ostringstream mesh_name, rho_name, v_name, e_name;
             mesh_name << basename << "_" << ti
@@ -601,7 +979,33 @@ int main(int argc, char *argv[])
             e_ofs.close();
          }
       }
+
+      if (checkpoint_every > 0 && (ti % checkpoint_every) == 0 && !last_step)
+      {
+         ProfileRegion region("Checkpoint");
+         ostringstream dir;
+         dir << basename << "_checkpoint_" << setfill('0') << setw(6) << ti;
+         cs.t = t;
+         cs.dt = dt;
+         cs.ti = ti;
+         cs.steps = steps;
+         cs.rejected_steps = rejected_steps;
+         SaveCheckpoint(dir.str(), pmesh->GetComm(), cs, S, oper);
+         if (mpi.Root()) { cout << "Checkpoint " << dir.str() << endl; }
+      }
    }
+   if (async_output)
+   {
+      async_output->Finish();
+      if (mpi.Root())
+      {
+         cout << "Asynchronous output: " << async_output->WriteTime()
+              << " s of writes, " << async_output->WaitTime()
+              << " s of waiting in the time loop (rank 0)." << endl;
+      }
+   }
+   profiler.End();
+   const int time_steps = steps;
 
    switch (ode_solver_type)
    {
@@ -609,26 +1013,159 @@ int main(int argc, char *argv[])
       case 3: steps *= 3; break;
       case 4: steps *= 4; break;
       case 6: steps *= 6; break;
-      case 7: steps *= 2;
+      case 7: steps *= 2; break;
+      case 8: steps *= mr_substeps + 1;
    }
    oper.PrintTimingData(mpi.Root(), steps);
+   if (GetHeapAllocationCount() >= 0 && heap_steps > 0)
+   {
+      long max_heap_allocs;
+      MPI_Reduce(&heap_allocs, &max_heap_allocs, 1, MPI_LONG, MPI_MAX, 0,
+                 pmesh->GetComm());
+      if (mpi.Root())
+      {
+         cout << endl;
+         cout << "Heap allocations per time step (max over ranks): "
+              << (double) max_heap_allocs / heap_steps << endl;
+      }
+   }
+
+   profiler.Print(pmesh->GetComm(), cout);
+   if (memory_report)
+   {
+      MemoryReport mem;
+      GetMemoryReport(oper, S, ode_solver_type, H1FESpace, L2FESpace, mem);
+      mem.Print(pmesh->GetComm(), cout, "Memory usage at the end of the run");
+   }
 
-   const double energy_final = oper.InternalEnergy(e_gf) +
-                               oper.KineticEnergy(v_gf);
+   // The final energies and, for problems 0 and 4, whose exact velocity is
+   // constant in time, the velocity errors, all in one reduction.
+   const bool v_exact = (problem == 0 || problem == 4);
+   diag.Finish();
+   diag.SetLog(NULL);
+   oper.SetDiagnostics(S, diag);
+   if (v_exact)
+   {
+      const double error_l2 = v_gf.GridFunction::ComputeL2Error(v_coeff);
+      diag.Set(Diagnostics::VELOCITY_ERROR_MAX,
+               v_gf.GridFunction::ComputeMaxError(v_coeff));
+      diag.Set(Diagnostics::VELOCITY_ERROR_L1,
+               v_gf.GridFunction::ComputeL1Error(v_coeff));
+      diag.Set(Diagnostics::VELOCITY_ERROR_L2SQ, error_l2 * error_l2);
+   }
+   diag.Start(time_steps, t);
+   diag.Finish();
+   const double energy_final = diag.Get(Diagnostics::INTERNAL_ENERGY) +
+                               diag.Get(Diagnostics::KINETIC_ENERGY);
+   // Deviation of the final forces and of the mass data from double precision.
+   double mp_force_diff = 0.0, mp_mass_rounding = 0.0;
+   if (mixed_precision)
+   {
+      oper.MixedPrecisionCheck(S, mp_force_diff, mp_mass_rounding);
+   }
    if (mpi.Root())
    {
       cout << endl;
       cout << "Energy  diff: " << scientific << setprecision(2)
            << fabs(energy_init - energy_final) << endl;
+      if (mixed_precision)
+      {
+         cout << "Mixed precision, force diff (relative): " << mp_force_diff
+              << ", mass rounding (relative): " << mp_mass_rounding << endl;
+      }
+   }
+
+   if (bench_report[0] != '\0')
+   {
+      TimingSummary ts;
+      oper.ComputeTimingSummary(steps, ts);
+      vector<RegionProfiler::Stats> regions;
+      profiler.Gather(pmesh->GetComm(), regions);
+      // The max over the ranks of the total of the memory report and of the
+      // peak RSS.
+      MemoryReport mem;
+      GetMemoryReport(oper, S, ode_solver_type, H1FESpace, L2FESpace, mem);
+      long mem_loc[2] = { mem.GetTotal(), GetPeakResidentSetSize() };
+      long mem_max[2];
+      MPI_Reduce(mem_loc, mem_max, 2, MPI_LONG, MPI_MAX, 0, pmesh->GetComm());
+      if (mpi.Root())
+      {
+         BenchReport report;
+         report.Add("config.problem", problem);
+         report.Add("config.mesh", mesh_file);
+         report.Add("config.dim", dim);
+         report.Add("config.refine_serial", rs_levels);
+         report.Add("config.refine_parallel", rp_levels);
+         report.Add("config.order_kinematic", order_v);
+         report.Add("config.order_thermo", order_e);
+         report.Add("config.ranks", mpi.WorldSize());
+         report.Add("config.threads", GetNumThreads());
+         report.Add("config.assembly", p_assembly ? "pa" : "fa");
+         report.Add("config.ode_solver", ode_solver_type);
+         report.Add("config.multirate_levels",
+                    (ode_solver_type == 8) ? mr_levels : 0);
+         report.Add("config.t_final", t_final);
+         report.Add("config.cfl", cfl);
+         report.Add("config.cg_tol", cg_tol);
+         report.Add("config.cg_max_steps", cg_max_iter);
+         report.Add("config.fused_force", (int) fused_force);
+         report.Add("config.energy_mass_solver", energy_solver);
+         report.Add("config.precision", mixed_precision ? "mixed" : "double");
+         report.Add("config.simd_width", simd_width);
+         report.Add("config.recompute_jac0inv", (int) recompute_jac0inv);
+         report.Add("config.dense_mass", (int) (dense_mass || !p_assembly));
+         report.Add("energy.init", energy_init);
+         report.Add("dofs.h1", (long) glob_size_h1);
+         report.Add("dofs.l2", (long) glob_size_l2);
+         report.Add("steps.total", time_steps);
+         report.Add("steps.rejected", rejected_steps);
+         report.Add("steps.stages", steps);
+         report.Add("timing.cg_h1.iterations", ts.H1cg_iter);
+         report.Add("timing.cg_h1.warm_start_reductions",
+                    ts.H1cg_reductions);
+         report.Add("timing.cg_h1.time", ts.H1cg_time);
+         report.Add("timing.cg_h1.rate", ts.H1cg_rate);
+         report.Add("timing.cg_l2.time", ts.L2cg_time);
+         report.Add("timing.cg_l2.rate", ts.L2cg_rate);
+         report.Add("timing.forces.time", ts.force_time);
+         report.Add("timing.forces.rate", ts.force_rate);
+         report.Add("timing.update_quad_data.time", ts.quad_time);
+         report.Add("timing.update_quad_data.rate", ts.quad_rate);
+         report.Add("timing.total.time", ts.total_time);
+         report.Add("timing.total.rate", ts.total_rate);
+         if (p_assembly)
+         {
+            const char *kernels[RL_NUM_KERNELS] =
+            { "force", "mass", "update_quad_data", "cg_l2" };
+            for (int k = 0; k < RL_NUM_KERNELS; k++)
+            {
+               const string prefix = string("roofline.") + kernels[k];
+               report.Add(prefix + ".gflops", ts.gflops[k]);
+               report.Add(prefix + ".gbytes", ts.gbytes[k]);
+            }
+            report.Add("roofline.stream_bw", ts.stream_bw);
+         }
+         report.Add("result.energy_diff", fabs(energy_init - energy_final));
+         if (mixed_precision)
+         {
+            report.Add("result.mixed_precision.force_diff", mp_force_diff);
+            report.Add("result.mixed_precision.mass_rounding",
+                       mp_mass_rounding);
+         }
+         report.Add("memory.total_max", mem_max[0]);
+         report.Add("memory.rss_peak_max", mem_max[1]);
+         report.Add(regions);
+         report.Write(bench_report);
+      }
    }
 
    // Print the error.
-   // For problems 0 and 4 the exact velocity is constant in time.
-   if (problem == 0 || problem == 4)
+   if (v_exact)
    {
-      const double error_max = v_gf.ComputeMaxError(v_coeff),
-                   error_l1  = v_gf.ComputeL1Error(v_coeff),
-                   error_l2  = v_gf.ComputeL2Error(v_coeff);
+      const double error_max = diag.Get(Diagnostics::VELOCITY_ERROR_MAX),
+                   error_l1  = diag.Get(Diagnostics::VELOCITY_ERROR_L1),
+                   error_l2  =
+                      sqrt(diag.Get(Diagnostics::VELOCITY_ERROR_L2SQ));
       if (mpi.Root())
       {
          cout << "L_inf  error: " << error_max << endl
@@ -644,6 +1181,8 @@ int main(int argc, char *argv[])
    }
 
    // Free the used memory.
+   delete async_output;
+   delete snapshot_writer;
    delete ode_solver;
    delete pmesh;
    delete mat_gf_coeff;
@@ -773,3 +1312,33 @@ void display_banner(ostream & os)
       << "   /_____/\\__,_/\\__, /_/ /_/\\____/____/  " << endl
       << "               /____/                       " << endl << endl;
 }
+
+void GetMemoryReport(const LagrangianHydroOperator &oper, const Vector &S,
+                     int ode_solver_type, ParFiniteElementSpace &H1FESpace,
+                     ParFiniteElementSpace &L2FESpace, MemoryReport &mem)
+{
+   oper.AddMemoryUsage(mem);
+   mem.Add("State S", MemoryUsage(S));
+
+   // Work vectors of the ODE solvers, some of which are allocated only in the
+   // first step: the stage and temporary state vectors of the MFEM Runge-Kutta
+   // solvers (RK6 has eight stages), and the H1 vector V with the full vectors
+   // dS_dt and S0 of RK2Avg. Those of the multirate solver are reported by the
+   // operator.
+   const long v_bytes = MemoryUsage(S), h1_bytes =
+                           H1FESpace.GetVSize() * (long) sizeof(double);
+   long ode_bytes = 0;
+   switch (ode_solver_type)
+   {
+      case 1: ode_bytes = v_bytes; break;
+      case 2: ode_bytes = 2 * v_bytes; break;
+      case 3: ode_bytes = 2 * v_bytes; break;
+      case 4: ode_bytes = 3 * v_bytes; break;
+      case 6: ode_bytes = 9 * v_bytes; break;
+      case 7: ode_bytes = h1_bytes + 2 * v_bytes; break;
+   }
+   mem.Add("ODE solver work vectors", ode_bytes);
+
+   mem.Add("H1 space", MemoryUsage(H1FESpace));
+   mem.Add("L2 space", MemoryUsage(L2FESpace));
+}
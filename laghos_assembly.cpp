@@ -16,6 +16,29 @@
 
 #include "laghos_assembly.hpp"
 
+#ifdef LAGHOS_DEBUG
+#include <cstdlib>
+#include <new>
+
+// Counting versions of the global allocation functions, used to verify that
+// the time stepping loop does not allocate.
+static long laghos_heap_allocations = 0;
+
+static void *CountedAllocation(std::size_t size)
+{
+   #pragma omp atomic
+   laghos_heap_allocations++;
+   void *ptr = std::malloc(size > 0 ? size : 1);
+   if (!ptr) { throw std::bad_alloc(); }
+   return ptr;
+}
+
+void *operator new(std::size_t size) { return CountedAllocation(size); }
+void *operator new[](std::size_t size) { return CountedAllocation(size); }
+void operator delete(void *ptr) throw() { std::free(ptr); }
+void operator delete[](void *ptr) throw() { std::free(ptr); }
+#endif
+
 using namespace std;
 
 namespace mfem
@@ -27,6 +50,18 @@ namespace hydrodynamics
 const Tensors1D *tensors1D = NULL;
 const FastEvaluator *evaluator = NULL;
 
+long GetHeapAllocationCount()
+{
+#ifdef LAGHOS_DEBUG
+   long count;
+   #pragma omp atomic read
+   count = laghos_heap_allocations;
+   return count;
+#else
+   return -1;
+#endif
+}
+
 Tensors1D::Tensors1D(int H1order, int L2order, int nqp1D)
    : HQshape1D(H1order + 1, nqp1D),
      HQgrad1D(H1order + 1, nqp1D),
@@ -55,14 +90,225 @@ Tensors1D::Tensors1D(int H1order, int L2order, int nqp1D)
    }
 }
 
+template <typename T>
+void ZoneInterleavedArray<T>::SetSize(int W_, int nzones_, int ncomp_,
+                                      int nqp_)
+{
+   W = W_; nzones = nzones_; ncomp = ncomp_; nqp = nqp_;
+   const int nblocks = (nzones + W - 1) / W, size = nblocks * ncomp * nqp * W;
+
+   // Over-allocate by 64 bytes and shift the start to a 64-byte boundary.
+   // Array::SetSize keeps the memory when shrinking, which would defeat the
+   // release of the versions that are not used.
+   const int align = 64 / sizeof(T);
+   storage.DeleteAll();
+   storage.SetSize(size + align);
+   storage = T(0);
+   const size_t offset = reinterpret_cast<size_t>(storage.GetData()) % 64;
+   data = storage.GetData() + (offset ? (64 - offset) / sizeof(T) : 0);
+}
+
+template class ZoneInterleavedArray<double>;
+template class ZoneInterleavedArray<float>;
+
+void QuadratureData::SetZoneInterleaved(int W)
+{
+   simd_width = W;
+   stressJinvT_zi.SetSize(W, nzones, dim * dim, nqp);
+   stressJinvT.SetSize(0, 0, 0);
+   rho0DetJ0w_zi.SetSize(W, nzones, 1, nqp);
+   SetRho0DetJ0w(rho0DetJ0w);
+   Jac0inv_zi.SetSize(W, (Jac0inv.SizeK() > 0) ? nzones : 0, dim * dim, nqp);
+   SetJac0inv(Jac0inv);
+   Jac0inv.SetSize(0, 0, 0);
+}
+
+void QuadratureData::SetSinglePrecision()
+{
+   MFEM_VERIFY(simd_width > 0, "Mixed precision needs the zone-interleaved "
+               "layout.");
+   const int W = simd_width;
+   DenseTensor J;
+   GetJac0inv(J);
+
+   single_qdata = true;
+   stressJinvT_zf.SetSize(W, nzones, dim * dim, nqp);
+   stressJinvT_zi.SetSize(W, 0, dim * dim, nqp);
+   rho0DetJ0w_zf.SetSize(W, nzones, 1, nqp);
+   rho0DetJ0w_zi.SetSize(W, 0, 1, nqp);
+   SetRho0DetJ0w(rho0DetJ0w);
+   Jac0inv_zf.SetSize(W, Jac0inv_zi.NumZones(), dim * dim, nqp);
+   Jac0inv_zi.SetSize(W, 0, dim * dim, nqp);
+   SetJac0inv(J);
+
+   rho0DetJ0w_rounding = 0.0;
+   for (int z = 0; z < nzones; z++)
+   {
+      for (int q = 0; q < nqp; q++)
+      {
+         const double r = rho0DetJ0w(z*nqp + q);
+         rho0DetJ0w_rounding = std::max(rho0DetJ0w_rounding,
+                                        fabs(rho0DetJ0w_zf(z, 0, q) - r) /
+                                        fabs(r));
+      }
+   }
+   rho0DetJ0w.Destroy();
+}
+
+double *QuadratureData::GetRho0DetJ0w(int z, double *buf) const
+{
+   if (rho0DetJ0w.Size() > 0) { return rho0DetJ0w.GetData() + z*nqp; }
+   for (int q = 0; q < nqp; q++) { buf[q] = rho0DetJ0w_zf(z, 0, q); }
+   return buf;
+}
+
+double QuadratureData::SumRho0DetJ0w() const
+{
+   if (rho0DetJ0w.Size() > 0) { return rho0DetJ0w.Sum(); }
+   double sum = 0.0;
+   for (int z = 0; z < nzones; z++)
+   {
+      for (int q = 0; q < nqp; q++) { sum += rho0DetJ0w_zf(z, 0, q); }
+   }
+   return sum;
+}
+
+void QuadratureData::GetRho0DetJ0w(Vector &r) const
+{
+   r.SetSize(nzones * nqp);
+   for (int z = 0; z < nzones; z++)
+   {
+      const double *r_z = GetRho0DetJ0w(z, r.GetData() + z*nqp);
+      for (int q = 0; q < nqp; q++) { r(z*nqp + q) = r_z[q]; }
+   }
+}
+
+void QuadratureData::SetRho0DetJ0w(const Vector &r)
+{
+   MFEM_VERIFY(r.Size() == nzones * nqp, "rho0DetJ0w size mismatch.");
+   if (rho0DetJ0w.Size() > 0 && r.GetData() != rho0DetJ0w.GetData())
+   {
+      rho0DetJ0w = r;
+   }
+   if (simd_width == 0) { return; }
+   for (int z = 0; z < nzones; z++)
+   {
+      for (int q = 0; q < nqp; q++)
+      {
+         if (single_qdata)
+         {
+            rho0DetJ0w_zf(z, 0, q) = (float) r(z*nqp + q);
+         }
+         else { rho0DetJ0w_zi(z, 0, q) = r(z*nqp + q); }
+      }
+   }
+}
+
+void QuadratureData::GetJac0inv(DenseTensor &J) const
+{
+   DenseTensor &J0 = const_cast<DenseTensor &>(Jac0inv);
+   const int nz = (simd_width == 0) ? J0.SizeK() / nqp :
+                  single_qdata ? Jac0inv_zf.NumZones() : Jac0inv_zi.NumZones();
+   J.SetSize(dim, dim, nz * nqp);
+   double *J_data = J.Data();
+   for (int z = 0; z < nz; z++)
+   {
+      for (int q = 0; q < nqp; q++)
+      {
+         for (int c = 0; c < dim * dim; c++)
+         {
+            // Entry (i,j) of the point is at i + j*dim, with c = i*dim + j.
+            const int idx = (z*nqp + q)*dim*dim + (c % dim)*dim + c / dim;
+            J_data[idx] = (simd_width == 0) ? J0.Data()[idx] :
+                          single_qdata ? Jac0inv_zf(z, c, q) :
+                          Jac0inv_zi(z, c, q);
+         }
+      }
+   }
+}
+
+void QuadratureData::SetJac0inv(const DenseTensor &J)
+{
+   const int nz = (simd_width == 0) ? Jac0inv.SizeK() / nqp :
+                  single_qdata ? Jac0inv_zf.NumZones() : Jac0inv_zi.NumZones();
+   MFEM_VERIFY(J.SizeK() == nz * nqp, "Jac0inv size mismatch.");
+   const double *J_data = const_cast<DenseTensor &>(J).Data();
+   if (simd_width == 0)
+   {
+      if (J_data == Jac0inv.Data()) { return; }
+      for (int i = 0; i < nz * nqp * dim * dim; i++)
+      {
+         Jac0inv.Data()[i] = J_data[i];
+      }
+      return;
+   }
+   for (int z = 0; z < nz; z++)
+   {
+      for (int q = 0; q < nqp; q++)
+      {
+         for (int c = 0; c < dim * dim; c++)
+         {
+            const int idx = (z*nqp + q)*dim*dim + (c % dim)*dim + c / dim;
+            if (single_qdata) { Jac0inv_zf(z, c, q) = (float) J_data[idx]; }
+            else { Jac0inv_zi(z, c, q) = J_data[idx]; }
+         }
+      }
+   }
+}
+
+void QuadratureData::AddMemoryUsage(MemoryReport &mem) const
+{
+   mem.Add("QuadratureData: Jac0inv", MemoryUsage(Jac0inv) +
+           Jac0inv_zi.MemoryUsage() + Jac0inv_zf.MemoryUsage());
+   mem.Add("QuadratureData: stressJinvT", MemoryUsage(stressJinvT) +
+           stressJinvT_zi.MemoryUsage() + stressJinvT_zf.MemoryUsage());
+   mem.Add("QuadratureData: rho0DetJ0w", MemoryUsage(rho0DetJ0w) +
+           rho0DetJ0w_zi.MemoryUsage() + rho0DetJ0w_zf.MemoryUsage());
+}
+
+int KernelWorkspaceSize(const QuadratureData &quad_data, int dim, int nzones,
+                        int max_order, int W)
+{
+   if (nzones == 0) { return 0; }
+   const int nqp = quad_data.nqp,
+             Q1D = (int) floor(0.7 + pow(nqp, 1.0 / dim)),
+             n1D = std::max(max_order + 1, Q1D);
+   int size = 16 * W;
+   for (int d = 0; d < dim; d++) { size *= n1D; }
+   return size;
+}
+
+FastEvaluator::FastEvaluator(FiniteElementSpace &h1fes)
+   : dim(h1fes.GetMesh()->Dimension()), H1FESpace(h1fes)
+{
+   // GetVectorGrad uses at most 4 arrays of n1D^dim values.
+   const int n1D = std::max(tensors1D->HQshape1D.Height(),
+                            tensors1D->HQshape1D.Width());
+   int size = 4;
+   for (int d = 0; d < dim; d++) { size *= n1D; }
+   work.SetSize(GetNumThreads());
+   for (int t = 0; t < work.Size(); t++)
+   {
+      work[t] = new WorkspaceArena;
+      work[t]->SetSize(size);
+   }
+}
+
+FastEvaluator::~FastEvaluator()
+{
+   for (int t = 0; t < work.Size(); t++) { delete work[t]; }
+}
+
 void FastEvaluator::GetL2Values(const Vector &vecL2, Vector &vecQ) const
 {
+   WorkspaceArena &work = *this->work[GetThreadId()];
+   work.Reset();
    const int nL2dof1D = tensors1D->LQshape1D.Height(),
              nqp1D    = tensors1D->LQshape1D.Width();
    if (dim == 2)
    {
       DenseMatrix E(vecL2.GetData(), nL2dof1D, nL2dof1D);
-      DenseMatrix LQ(nL2dof1D, nqp1D);
+      DenseMatrix LQ(work.Reserve(nL2dof1D * nqp1D), nL2dof1D, nqp1D);
 
       vecQ.SetSize(nqp1D * nqp1D);
       DenseMatrix QQ(vecQ.GetData(), nqp1D, nqp1D);
@@ -75,9 +321,11 @@ void FastEvaluator::GetL2Values(const Vector &vecL2, Vector &vecQ) const
    else
    {
       DenseMatrix E(vecL2.GetData(), nL2dof1D*nL2dof1D, nL2dof1D);
-      DenseMatrix LL_Q(nL2dof1D * nL2dof1D, nqp1D),
+      DenseMatrix LL_Q(work.Reserve(nL2dof1D * nL2dof1D * nqp1D),
+                       nL2dof1D * nL2dof1D, nqp1D),
                   L_LQ(LL_Q.GetData(), nL2dof1D, nL2dof1D*nqp1D),
-                  Q_LQ(nqp1D, nL2dof1D*nqp1D);
+                  Q_LQ(work.Reserve(nqp1D * nL2dof1D * nqp1D),
+                       nqp1D, nL2dof1D*nqp1D);
 
       vecQ.SetSize(nqp1D * nqp1D * nqp1D);
       DenseMatrix QQ_Q(vecQ.GetData(), nqp1D * nqp1D, nqp1D);
@@ -108,6 +356,8 @@ void FastEvaluator::GetL2Values(const Vector &vecL2, Vector &vecQ) const
 
 void FastEvaluator::GetVectorGrad(const DenseMatrix &vec, DenseTensor &J) const
 {
+   WorkspaceArena &work = *this->work[GetThreadId()];
+   work.Reset();
    const int nH1dof1D = tensors1D->HQshape1D.Height(),
              nqp1D    = tensors1D->LQshape1D.Width();
    DenseMatrix X;
@@ -115,8 +365,9 @@ void FastEvaluator::GetVectorGrad(const DenseMatrix &vec, DenseTensor &J) const
    if (dim == 2)
    {
       const int nH1dof = nH1dof1D * nH1dof1D;
-      DenseMatrix HQ(nH1dof1D, nqp1D), QQ(nqp1D, nqp1D);
-      Vector x(nH1dof);
+      DenseMatrix HQ(work.Reserve(nH1dof1D * nqp1D), nH1dof1D, nqp1D),
+                  QQ(work.Reserve(nqp1D * nqp1D), nqp1D, nqp1D);
+      Vector x(work.Reserve(nH1dof), nH1dof);
 
       const H1_QuadrilateralElement *fe =
          dynamic_cast<const H1_QuadrilateralElement *>(H1FESpace.GetFE(0));
@@ -163,10 +414,14 @@ void FastEvaluator::GetVectorGrad(const DenseMatrix &vec, DenseTensor &J) const
    else
    {
       const int nH1dof = nH1dof1D * nH1dof1D * nH1dof1D;
-      DenseMatrix HH_Q(nH1dof1D * nH1dof1D, nqp1D),
+      DenseMatrix HH_Q(work.Reserve(nH1dof1D * nH1dof1D * nqp1D),
+                       nH1dof1D * nH1dof1D, nqp1D),
                   H_HQ(HH_Q.GetData(), nH1dof1D, nH1dof1D * nqp1D),
-                  Q_HQ(nqp1D, nH1dof1D*nqp1D), QQ_Q(nqp1D * nqp1D, nqp1D);
-      Vector x(nH1dof);
+                  Q_HQ(work.Reserve(nqp1D * nH1dof1D * nqp1D),
+                       nqp1D, nH1dof1D*nqp1D),
+                  QQ_Q(work.Reserve(nqp1D * nqp1D * nqp1D),
+                       nqp1D * nqp1D, nqp1D);
+      Vector x(work.Reserve(nH1dof), nH1dof);
 
       const H1_HexahedronElement *fe =
          dynamic_cast<const H1_HexahedronElement *>(H1FESpace.GetFE(0));
@@ -289,7 +544,9 @@ void DensityIntegrator::AssembleRHSElementVect(const FiniteElement &fe,
                                                Vector &elvect)
 {
    const int ip_cnt = IntRule->GetNPoints();
-   Vector shape(fe.GetDof());
+   Vector shape(fe.GetDof()), buf(ip_cnt);
+   const double *rho0DetJ0w = quad_data.GetRho0DetJ0w(Tr.ElementNo,
+                                                      buf.GetData());
 
    elvect.SetSize(fe.GetDof());
    elvect = 0.0;
@@ -298,7 +555,7 @@ void DensityIntegrator::AssembleRHSElementVect(const FiniteElement &fe,
    {
       fe.CalcShape(IntRule->IntPoint(q), shape);
       // Note that rhoDetJ = rho0DetJ0.
-      shape *= quad_data.rho0DetJ0w(Tr.ElementNo*ip_cnt + q);
+      shape *= rho0DetJ0w[q];
       elvect += shape;
    }
 }
@@ -346,6 +603,9 @@ void ForceIntegrator::AssembleElementMatrix2(const FiniteElement &trial_fe,
 
 void ForcePAOperator::Mult(const Vector &vecL2, Vector &vecH1) const
 {
+   if (quad_data->single_qdata ? MultStored<float>(NULL, vecL2, vecH1) :
+       MultStored<double>(NULL, vecL2, vecH1)) { return; }
+
    if      (dim == 2) { MultQuad(vecL2, vecH1); }
    else if (dim == 3) { MultHex(vecL2, vecH1); }
    else { MFEM_ABORT("Unsupported dimension"); }
@@ -353,26 +613,131 @@ void ForcePAOperator::Mult(const Vector &vecL2, Vector &vecH1) const
 
 void ForcePAOperator::MultTranspose(const Vector &vecH1, Vector &vecL2) const
 {
+   if (quad_data->single_qdata ?
+       MultTransposeStored<float>(NULL, vecH1, vecL2) :
+       MultTransposeStored<double>(NULL, vecH1, vecL2)) { return; }
+
    if      (dim == 2) { MultTransposeQuad(vecH1, vecL2); }
    else if (dim == 3) { MultTransposeHex(vecH1, vecL2); }
    else { MFEM_ABORT("Unsupported dimension"); }
 }
 
+void ForcePAOperator::MultZoneRanges(const Array<int> &zones,
+                                     const Vector &vecL2, Vector &vecH1) const
+{
+   if (quad_data->single_qdata ? MultStored<float>(&zones, vecL2, vecH1) :
+       MultStored<double>(&zones, vecL2, vecH1)) { return; }
+   Mult(vecL2, vecH1);
+}
+
+void ForcePAOperator::MultTransposeZoneRanges(const Array<int> &zones,
+                                              const Vector &vecH1,
+                                              Vector &vecL2) const
+{
+   if (quad_data->single_qdata ?
+       MultTransposeStored<float>(&zones, vecH1, vecL2) :
+       MultTransposeStored<double>(&zones, vecH1, vecL2)) { return; }
+   MultTranspose(vecH1, vecL2);
+}
+
+template<typename T>
+bool ForcePAOperator::MultStored(const Array<int> *zones, const Vector &vecL2,
+                                 Vector &vecH1) const
+{
+   typename KernelPtr<T>::Type kernel = GetMultKernel<T>();
+   if (!kernel) { return false; }
+   const T *stress;
+   int bstride, cstride;
+   GetStressData(stress, bstride, cstride);
+   vecH1 = 0.0;
+   if (!zones)
+   {
+      (this->*kernel)(stress, bstride, cstride, 0, nzones, vecL2, vecH1);
+      return true;
+   }
+   const int W = std::max(quad_data->simd_width, 1);
+   for (int i = 0; i < zones->Size(); i += 2)
+   {
+      const int z_begin = (*zones)[i];
+      (this->*kernel)(stress + z_begin / W * bstride, bstride, cstride,
+                      z_begin, (*zones)[i+1], vecL2, vecH1);
+   }
+   return true;
+}
+
+template<typename T>
+bool ForcePAOperator::MultTransposeStored(const Array<int> *zones,
+                                          const Vector &vecH1,
+                                          Vector &vecL2) const
+{
+   typename KernelPtr<T>::Type kernel = GetMultTransposeKernel<T>();
+   if (!kernel) { return false; }
+   const T *stress;
+   int bstride, cstride;
+   GetStressData(stress, bstride, cstride);
+   if (!zones)
+   {
+      (this->*kernel)(stress, bstride, cstride, 0, nzones, vecH1, vecL2);
+      return true;
+   }
+   const int W = std::max(quad_data->simd_width, 1);
+   for (int i = 0; i < zones->Size(); i += 2)
+   {
+      const int z_begin = (*zones)[i];
+      (this->*kernel)(stress + z_begin / W * bstride, bstride, cstride,
+                      z_begin, (*zones)[i+1], vecH1, vecL2);
+   }
+   return true;
+}
+
+bool ForcePAOperator::HasFixedKernels() const
+{
+   return GetMultKernel<double>() != NULL;
+}
+
+void ForcePAOperator::MultZones(const double *stress, int z_begin, int z_end,
+                                const Vector &vecL2, Vector &vecH1) const
+{
+   Kernel kernel = GetMultKernel<double>();
+   MFEM_VERIFY(kernel, "The fused force computation needs fixed-size kernels.");
+   const int cstride = GetNQP() * std::max(quad_data->simd_width, 1);
+   (this->*kernel)(stress, dim*dim*cstride, cstride, z_begin, z_end,
+                   vecL2, vecH1);
+}
+
+void ForcePAOperator::MultTransposeZones(const double *stress,
+                                         int z_begin, int z_end,
+                                         const Vector &vecH1,
+                                         Vector &vecL2) const
+{
+   Kernel kernel = GetMultTransposeKernel<double>();
+   MFEM_VERIFY(kernel, "The fused force computation needs fixed-size kernels.");
+   const int cstride = GetNQP() * std::max(quad_data->simd_width, 1);
+   (this->*kernel)(stress, dim*dim*cstride, cstride, z_begin, z_end,
+                   vecH1, vecL2);
+}
+
 // Force matrix action on quadrilateral elements in 2D.
 void ForcePAOperator::MultQuad(const Vector &vecL2, Vector &vecH1) const
 {
+   work.Reset();
    const int nH1dof1D = tensors1D->HQshape1D.Height(),
              nL2dof1D = tensors1D->LQshape1D.Height(),
              nqp1D    = tensors1D->HQshape1D.Width(),
-             nqp      =  nqp1D * nqp1D,
-             nH1dof   = nH1dof1D * nH1dof1D;
-   Array<int> h1dofs, l2dofs;
-   Vector e(nL2dof1D * nL2dof1D);
+             nqp      =  nqp1D * nqp1D;
+   const Table &h1_e2d = H1FESpace.GetElementToDofTable(),
+               &l2_e2d = L2FESpace.GetElementToDofTable();
+   const int h1_ndofs = H1FESpace.GetNDofs();
+   const int *h1dofs = NULL, *l2dofs = NULL;
+   Vector e(work.Reserve(nL2dof1D * nL2dof1D), nL2dof1D * nL2dof1D);
    DenseMatrix E(e.GetData(), nL2dof1D, nL2dof1D);
-   DenseMatrix LQ(nL2dof1D, nqp1D), HQ(nH1dof1D, nqp1D), QQ(nqp1D, nqp1D),
-               HHx(nH1dof1D, nH1dof1D), HHy(nH1dof1D, nH1dof1D);
+   DenseMatrix LQ(work.Reserve(nL2dof1D * nqp1D), nL2dof1D, nqp1D),
+               HQ(work.Reserve(nH1dof1D * nqp1D), nH1dof1D, nqp1D),
+               QQ(work.Reserve(nqp1D * nqp1D), nqp1D, nqp1D),
+               HHx(work.Reserve(nH1dof1D * nH1dof1D), nH1dof1D, nH1dof1D),
+               HHy(work.Reserve(nH1dof1D * nH1dof1D), nH1dof1D, nH1dof1D);
    // Quadrature data for a specific direction.
-   DenseMatrix QQd(nqp1D, nqp1D);
+   DenseMatrix QQd(work.Reserve(nqp1D * nqp1D), nqp1D, nqp1D);
    double *data_qd = QQd.GetData(), *data_q = QQ.GetData();
 
    const H1_QuadrilateralElement *fe =
@@ -383,8 +748,8 @@ void ForcePAOperator::MultQuad(const Vector &vecL2, Vector &vecH1) const
    for (int z = 0; z < nzones; z++)
    {
       // Note that the local numbering for L2 is the tensor numbering.
-      L2FESpace.GetElementDofs(z, l2dofs);
-      vecL2.GetSubVector(l2dofs, e);
+      l2dofs = l2_e2d.GetRow(z);
+      for (int j = 0; j < e.Size(); j++) { e(j) = vecL2(l2dofs[j]); }
 
       // LQ_j2_k1 = E_j1_j2 LQs_j1_k1  -- contract in x direction.
       // QQ_k1_k2 = LQ_j2_k1 LQs_j2_k2 -- contract in y direction.
@@ -411,7 +776,7 @@ void ForcePAOperator::MultQuad(const Vector &vecL2, Vector &vecH1) const
          MultABt(tensors1D->HQshape1D, HQ, HHy);
 
          // Set the c-component of the result.
-         H1FESpace.GetElementVDofs(z, h1dofs);
+         h1dofs = h1_e2d.GetRow(z);
          for (int i1 = 0; i1 < nH1dof1D; i1++)
          {
             for (int i2 = 0; i2 < nH1dof1D; i2++)
@@ -419,7 +784,7 @@ void ForcePAOperator::MultQuad(const Vector &vecL2, Vector &vecH1) const
                // Transfer from the mfem's H1 local numbering to the tensor
                // structure numbering.
                const int idx = i2 * nH1dof1D + i1;
-               vecH1[h1dofs[c*nH1dof + dof_map[idx]]] +=
+               vecH1[h1dofs[dof_map[idx]] + c*h1_ndofs] +=
                   HHx(i1, i2) + HHy(i1, i2);
             }
          }
@@ -430,27 +795,39 @@ void ForcePAOperator::MultQuad(const Vector &vecL2, Vector &vecH1) const
 // Force matrix action on hexahedral elements in 3D.
 void ForcePAOperator::MultHex(const Vector &vecL2, Vector &vecH1) const
 {
+   work.Reset();
    const int nH1dof1D = tensors1D->HQshape1D.Height(),
              nL2dof1D = tensors1D->LQshape1D.Height(),
              nqp1D    = tensors1D->HQshape1D.Width(),
-             nqp      = nqp1D * nqp1D * nqp1D,
-             nH1dof   = nH1dof1D * nH1dof1D * nH1dof1D;
-   Array<int> h1dofs, l2dofs;
-
-   Vector e(nL2dof1D * nL2dof1D * nL2dof1D);
+             nqp      = nqp1D * nqp1D * nqp1D;
+   const Table &h1_e2d = H1FESpace.GetElementToDofTable(),
+               &l2_e2d = L2FESpace.GetElementToDofTable();
+   const int h1_ndofs = H1FESpace.GetNDofs();
+   const int *h1dofs = NULL, *l2dofs = NULL;
+
+   Vector e(work.Reserve(nL2dof1D * nL2dof1D * nL2dof1D),
+            nL2dof1D * nL2dof1D * nL2dof1D);
    DenseMatrix E(e.GetData(), nL2dof1D*nL2dof1D, nL2dof1D);
 
-   DenseMatrix HH_Q(nH1dof1D * nH1dof1D, nqp1D),
+   DenseMatrix HH_Q(work.Reserve(nH1dof1D * nH1dof1D * nqp1D),
+                    nH1dof1D * nH1dof1D, nqp1D),
                H_HQ(HH_Q.GetData(), nH1dof1D, nH1dof1D*nqp1D),
-               Q_HQ(nqp1D, nH1dof1D*nqp1D);
-   DenseMatrix LL_Q(nL2dof1D * nL2dof1D, nqp1D),
+               Q_HQ(work.Reserve(nqp1D * nH1dof1D * nqp1D),
+                    nqp1D, nH1dof1D*nqp1D);
+   DenseMatrix LL_Q(work.Reserve(nL2dof1D * nL2dof1D * nqp1D),
+                    nL2dof1D * nL2dof1D, nqp1D),
                L_LQ(LL_Q.GetData(), nL2dof1D, nL2dof1D*nqp1D),
-               Q_LQ(nqp1D, nL2dof1D*nqp1D);
-   DenseMatrix QQ_Q(nqp1D * nqp1D, nqp1D), QQ_Qc(nqp1D * nqp1D, nqp1D);
+               Q_LQ(work.Reserve(nqp1D * nL2dof1D * nqp1D),
+                    nqp1D, nL2dof1D*nqp1D);
+   DenseMatrix QQ_Q(work.Reserve(nqp1D * nqp1D * nqp1D), nqp1D * nqp1D, nqp1D),
+               QQ_Qc(work.Reserve(nqp1D * nqp1D * nqp1D), nqp1D * nqp1D, nqp1D);
    double *qqq = QQ_Q.GetData(), *qqqc = QQ_Qc.GetData();
-   DenseMatrix HHHx(nH1dof1D * nH1dof1D, nH1dof1D),
-               HHHy(nH1dof1D * nH1dof1D, nH1dof1D),
-               HHHz(nH1dof1D * nH1dof1D, nH1dof1D);
+   DenseMatrix HHHx(work.Reserve(nH1dof1D * nH1dof1D * nH1dof1D),
+                    nH1dof1D * nH1dof1D, nH1dof1D),
+               HHHy(work.Reserve(nH1dof1D * nH1dof1D * nH1dof1D),
+                    nH1dof1D * nH1dof1D, nH1dof1D),
+               HHHz(work.Reserve(nH1dof1D * nH1dof1D * nH1dof1D),
+                    nH1dof1D * nH1dof1D, nH1dof1D);
 
    const H1_HexahedronElement *fe =
       dynamic_cast<const H1_HexahedronElement *>(H1FESpace.GetFE(0));
@@ -460,8 +837,8 @@ void ForcePAOperator::MultHex(const Vector &vecL2, Vector &vecH1) const
    for (int z = 0; z < nzones; z++)
    {
       // Note that the local numbering for L2 is the tensor numbering.
-      L2FESpace.GetElementDofs(z, l2dofs);
-      vecL2.GetSubVector(l2dofs, e);
+      l2dofs = l2_e2d.GetRow(z);
+      for (int j = 0; j < e.Size(); j++) { e(j) = vecL2(l2dofs[j]); }
 
       // LLQ_j1_j2_k3  = E_j1_j2_j3 LQs_j3_k3   -- contract in z direction.
       // QLQ_k1_j2_k3  = LQs_j1_k1 LLQ_j1_j2_k3 -- contract in x direction.
@@ -567,7 +944,7 @@ void ForcePAOperator::MultHex(const Vector &vecL2, Vector &vecH1) const
          MultABt(HH_Q, tensors1D->HQgrad1D, HHHz);
 
          // Set the c-component of the result.
-         H1FESpace.GetElementVDofs(z, h1dofs);
+         h1dofs = h1_e2d.GetRow(z);
          for (int i1 = 0; i1 < nH1dof1D; i1++)
          {
             for (int i2 = 0; i2 < nH1dof1D; i2++)
@@ -577,7 +954,7 @@ void ForcePAOperator::MultHex(const Vector &vecL2, Vector &vecH1) const
                   // Transfer from the mfem's H1 local numbering to the tensor
                   // structure numbering.
                   const int idx = i3*nH1dof1D*nH1dof1D + i2*nH1dof1D + i1;
-                  vecH1[h1dofs[c*nH1dof + dof_map[idx]]] +=
+                  vecH1[h1dofs[dof_map[idx]] + c*h1_ndofs] +=
                      HHHx(i1 + i2*nH1dof1D, i3) +
                      HHHy(i1 + i2*nH1dof1D, i3) +
                      HHHz(i1 + i2*nH1dof1D, i3);
@@ -592,16 +969,23 @@ void ForcePAOperator::MultHex(const Vector &vecL2, Vector &vecH1) const
 void ForcePAOperator::MultTransposeQuad(const Vector &vecH1,
                                         Vector &vecL2) const
 {
+   work.Reset();
    const int nH1dof1D = tensors1D->HQshape1D.Height(),
              nL2dof1D = tensors1D->LQshape1D.Height(),
              nqp1D    = tensors1D->HQshape1D.Width(),
              nqp      = nqp1D * nqp1D,
              nH1dof   = nH1dof1D * nH1dof1D;
-   Array<int> h1dofs, l2dofs;
-   Vector v(nH1dof * 2), e(nL2dof1D * nL2dof1D);
+   const Table &h1_e2d = H1FESpace.GetElementToDofTable(),
+               &l2_e2d = L2FESpace.GetElementToDofTable();
+   const int h1_ndofs = H1FESpace.GetNDofs();
+   const int *h1dofs = NULL, *l2dofs = NULL;
+   Vector v(work.Reserve(nH1dof * 2), nH1dof * 2),
+          e(work.Reserve(nL2dof1D * nL2dof1D), nL2dof1D * nL2dof1D);
    DenseMatrix V, E(e.GetData(), nL2dof1D, nL2dof1D);
-   DenseMatrix HQ(nH1dof1D, nqp1D), LQ(nL2dof1D, nqp1D),
-               QQc(nqp1D, nqp1D), QQ(nqp1D, nqp1D);
+   DenseMatrix HQ(work.Reserve(nH1dof1D * nqp1D), nH1dof1D, nqp1D),
+               LQ(work.Reserve(nL2dof1D * nqp1D), nL2dof1D, nqp1D),
+               QQc(work.Reserve(nqp1D * nqp1D), nqp1D, nqp1D),
+               QQ(work.Reserve(nqp1D * nqp1D), nqp1D, nqp1D);
    double *qqc = QQc.GetData();
 
    const H1_QuadrilateralElement *fe =
@@ -610,7 +994,7 @@ void ForcePAOperator::MultTransposeQuad(const Vector &vecH1,
 
    for (int z = 0; z < nzones; z++)
    {
-      H1FESpace.GetElementVDofs(z, h1dofs);
+      h1dofs = h1_e2d.GetRow(z);
 
       // Form (stress:grad_v) at all quadrature points.
       QQ = 0.0;
@@ -620,7 +1004,7 @@ void ForcePAOperator::MultTransposeQuad(const Vector &vecH1,
          // numbering.
          for (int j = 0; j < nH1dof; j++)
          {
-            v[c*nH1dof + j] = vecH1[h1dofs[c*nH1dof + dof_map[j]]];
+            v[c*nH1dof + j] = vecH1[h1dofs[dof_map[j]] + c*h1_ndofs];
          }
          // Connect to [v_c], i.e., the c-component of v.
          V.UseExternalData(v.GetData() + c*nH1dof, nH1dof1D, nH1dof1D);
@@ -651,31 +1035,42 @@ void ForcePAOperator::MultTransposeQuad(const Vector &vecH1,
       mfem::Mult(tensors1D->LQshape1D, QQ, LQ);
       MultABt(LQ, tensors1D->LQshape1D, E);
 
-      L2FESpace.GetElementDofs(z, l2dofs);
-      vecL2.SetSubVector(l2dofs, e);
+      l2dofs = l2_e2d.GetRow(z);
+      for (int j = 0; j < e.Size(); j++) { vecL2(l2dofs[j]) = e(j); }
    }
 }
 
 // Transpose force matrix action on hexahedral elements in 3D.
 void ForcePAOperator::MultTransposeHex(const Vector &vecH1, Vector &vecL2) const
 {
+   work.Reset();
    const int nH1dof1D = tensors1D->HQshape1D.Height(),
              nL2dof1D = tensors1D->LQshape1D.Height(),
              nqp1D    = tensors1D->HQshape1D.Width(),
              nqp      = nqp1D * nqp1D * nqp1D,
              nH1dof   = nH1dof1D * nH1dof1D * nH1dof1D;
-   Array<int> h1dofs, l2dofs;
-
-   Vector v(nH1dof * 3), e(nL2dof1D * nL2dof1D * nL2dof1D);
+   const Table &h1_e2d = H1FESpace.GetElementToDofTable(),
+               &l2_e2d = L2FESpace.GetElementToDofTable();
+   const int h1_ndofs = H1FESpace.GetNDofs();
+   const int *h1dofs = NULL, *l2dofs = NULL;
+
+   Vector v(work.Reserve(nH1dof * 3), nH1dof * 3),
+          e(work.Reserve(nL2dof1D * nL2dof1D * nL2dof1D),
+            nL2dof1D * nL2dof1D * nL2dof1D);
    DenseMatrix V, E(e.GetData(), nL2dof1D * nL2dof1D, nL2dof1D);
 
-   DenseMatrix HH_Q(nH1dof1D * nH1dof1D, nqp1D),
+   DenseMatrix HH_Q(work.Reserve(nH1dof1D * nH1dof1D * nqp1D),
+                    nH1dof1D * nH1dof1D, nqp1D),
                H_HQ(HH_Q.GetData(), nH1dof1D, nH1dof1D * nqp1D),
-               Q_HQ(nqp1D, nH1dof1D*nqp1D);
-   DenseMatrix LL_Q(nL2dof1D * nL2dof1D, nqp1D),
+               Q_HQ(work.Reserve(nqp1D * nH1dof1D * nqp1D),
+                    nqp1D, nH1dof1D*nqp1D);
+   DenseMatrix LL_Q(work.Reserve(nL2dof1D * nL2dof1D * nqp1D),
+                    nL2dof1D * nL2dof1D, nqp1D),
                L_LQ(LL_Q.GetData(), nL2dof1D, nL2dof1D * nqp1D),
-               Q_LQ(nqp1D, nL2dof1D*nqp1D);
-   DenseMatrix QQ_Q(nqp1D * nqp1D, nqp1D),  QQ_Qc(nqp1D * nqp1D, nqp1D);
+               Q_LQ(work.Reserve(nqp1D * nL2dof1D * nqp1D),
+                    nqp1D, nL2dof1D*nqp1D);
+   DenseMatrix QQ_Q(work.Reserve(nqp1D * nqp1D * nqp1D), nqp1D * nqp1D, nqp1D),
+               QQ_Qc(work.Reserve(nqp1D * nqp1D * nqp1D), nqp1D * nqp1D, nqp1D);
    double *qqqc = QQ_Qc.GetData();
 
    const H1_HexahedronElement *fe =
@@ -684,7 +1079,7 @@ void ForcePAOperator::MultTransposeHex(const Vector &vecH1, Vector &vecL2) const
 
    for (int z = 0; z < nzones; z++)
    {
-      H1FESpace.GetElementVDofs(z, h1dofs);
+      h1dofs = h1_e2d.GetRow(z);
 
       // Form (stress:grad_v) at all quadrature points.
       QQ_Q = 0.0;
@@ -694,7 +1089,7 @@ void ForcePAOperator::MultTransposeHex(const Vector &vecH1, Vector &vecL2) const
          // numbering.
          for (int j = 0; j < nH1dof; j++)
          {
-            v[c*nH1dof + j] = vecH1[h1dofs[c*nH1dof + dof_map[j]]];
+            v[c*nH1dof + j] = vecH1[h1dofs[dof_map[j]] + c*h1_ndofs];
          }
          // Connect to [v_c], i.e., the c-component of v.
          V.UseExternalData(v.GetData() + c*nH1dof, nH1dof1D*nH1dof1D, nH1dof1D);
@@ -803,164 +1198,1083 @@ void ForcePAOperator::MultTransposeHex(const Vector &vecH1, Vector &vecL2) const
       mfem::Mult(tensors1D->LQshape1D, Q_LQ, L_LQ);
       MultABt(LL_Q, tensors1D->LQshape1D, E);
 
-      L2FESpace.GetElementDofs(z, l2dofs);
-      vecL2.SetSubVector(l2dofs, e);
+      l2dofs = l2_e2d.GetRow(z);
+      for (int j = 0; j < e.Size(); j++) { vecL2(l2dofs[j]) = e(j); }
    }
 }
 
-void MassPAOperator::ComputeDiagonal2D(Vector &diag) const
+// Copies the 1D shape functions and gradients into fixed-size local arrays.
+template<int H1D, int L2D, int Q1D>
+static void CopyTensors1D(double B[H1D][Q1D], double G[H1D][Q1D],
+                          double L[L2D][Q1D])
 {
-   const H1_QuadrilateralElement *fe_H1 =
-      dynamic_cast<const H1_QuadrilateralElement *>(FESpace.GetFE(0));
-   const Array<int> &dof_map = fe_H1->GetDofMap();
-   const DenseMatrix &HQs = tensors1D->HQshape1D;
-
-   const int ndof1D = HQs.Height(), nqp1D = HQs.Width(), nqp = nqp1D * nqp1D;
-   Vector dz(ndof1D * ndof1D);
-   DenseMatrix HQ(ndof1D, nqp1D), D(dz.GetData(), ndof1D, ndof1D);
-   Array<int> dofs;
-
-   diag.SetSize(height);
-   diag = 0.0;
-
-   // Squares of the shape functions at all quadrature points.
-   DenseMatrix HQs_sq(ndof1D, nqp1D);
-   for (int i = 0; i < ndof1D; i++)
+   for (int i = 0; i < H1D; i++)
    {
-      for (int k = 0; k < nqp1D; k++)
+      for (int k = 0; k < Q1D; k++)
       {
-         HQs_sq(i, k) = HQs(i, k) * HQs(i, k);
+         B[i][k] = tensors1D->HQshape1D(i, k);
+         G[i][k] = tensors1D->HQgrad1D(i, k);
       }
    }
-
-   for (int z = 0; z < nzones; z++)
+   for (int j = 0; j < L2D; j++)
    {
-      DenseMatrix QQ(quad_data->rho0DetJ0w.GetData() + z*nqp, nqp1D, nqp1D);
-
-      // HQ_i1_k2 = HQs_i1_k1^2 QQ_k1_k2    -- contract in x direction.
-      // Y_i1_i2  = HQ_i1_k2    HQs_i2_k2^2 -- contract in y direction.
-      mfem::Mult(HQs_sq, QQ, HQ);
-      MultABt(HQ, HQs_sq, D);
-
-      // Transfer from the tensor structure numbering to mfem's H1 numbering.
-      FESpace.GetElementDofs(z, dofs);
-      for (int j = 0; j < dz.Size(); j++)
-      {
-         diag[dofs[dof_map[j]]] += dz[j];
-      }
+      for (int k = 0; k < Q1D; k++) { L[j][k] = tensors1D->LQshape1D(j, k); }
    }
+}
 
-   for (int i = 0; i < height / 2; i++)
+int ForcePAOperator::GetNQP() const
+{
+   const int nqp1D = tensors1D->HQshape1D.Width();
+   return (dim == 2) ? nqp1D * nqp1D : nqp1D * nqp1D * nqp1D;
+}
+
+void ForcePAOperator::GetStressData(const double *&stress, int &bstride,
+                                    int &cstride) const
+{
+   const int nqp = GetNQP(), W = quad_data->simd_width;
+   if (W > 0)
    {
-      diag(i + height / 2) = diag(i);
+      cstride = nqp * W;
+      bstride = dim * dim * cstride;
+      stress = quad_data->stressJinvT_zi.GetData();
+      return;
    }
+   cstride = nzones * nqp;
+   bstride = nqp;
+   stress = quad_data->stressJinvT.Data();
 }
 
-void MassPAOperator::ComputeDiagonal3D(Vector &diag) const
+void ForcePAOperator::GetStressData(const float *&stress, int &bstride,
+                                    int &cstride) const
 {
-   const H1_HexahedronElement *fe_H1 =
-      dynamic_cast<const H1_HexahedronElement *>(FESpace.GetFE(0));
-   const Array<int> &dof_map = fe_H1->GetDofMap();
-   const DenseMatrix &HQs = tensors1D->HQshape1D;
+   // The single precision data is always zone-interleaved.
+   cstride = GetNQP() * quad_data->simd_width;
+   bstride = dim * dim * cstride;
+   stress = quad_data->stressJinvT_zf.GetData();
+}
 
-   const int ndof1D = HQs.Height(), nqp1D = HQs.Width(),
-             nqp = nqp1D * nqp1D * nqp1D;
-   DenseMatrix HH_Q(ndof1D * ndof1D, nqp1D), Q_HQ(nqp1D, ndof1D*nqp1D);
-   DenseMatrix H_HQ(HH_Q.GetData(), ndof1D, ndof1D*nqp1D);
-   Vector dz(ndof1D * ndof1D * ndof1D);
-   DenseMatrix D(dz.GetData(), ndof1D*ndof1D, ndof1D);
-   Array<int> dofs;
+// Force matrix action on quadrilateral elements in 2D, fixed sizes.
+template<int H1D, int L2D, int Q1D, int W, typename T>
+void ForcePAOperator::MultQuadFixed(const T *stress, int bstride,
+                                    int cstride, int z_begin, int z_end,
+                                    const Vector &vecL2, Vector &vecH1) const
+{
+   const int nH1dof = H1D * H1D, nL2dof = L2D * L2D,
+             nblocks = (z_end - z_begin + W - 1) / W;
+   double B[H1D][Q1D], G[H1D][Q1D], L[L2D][Q1D];
+   CopyTensors1D<H1D, L2D, Q1D>(B, G, L);
+   const Table &h1_e2d = H1FESpace.GetElementToDofTable(),
+               &l2_e2d = L2FESpace.GetElementToDofTable();
+   const int h1_ndofs = H1FESpace.GetNDofs();
+   const int *h1dofs = NULL, *l2dofs = NULL;
 
-   diag.SetSize(height);
-   diag = 0.0;
+   const H1_QuadrilateralElement *fe =
+      dynamic_cast<const H1_QuadrilateralElement *>(H1FESpace.GetFE(0));
+   const Array<int> &dof_map = fe->GetDofMap();
 
-   // Squares of the shape functions at all quadrature points.
-   DenseMatrix HQs_sq(ndof1D, nqp1D);
-   for (int i = 0; i < ndof1D; i++)
+   // All local arrays have the W zones of the block as the last dimension.
+   double E[L2D][L2D][W], LQ[L2D][Q1D][W], QQ[Q1D][Q1D][W],
+          QQx[Q1D][Q1D][W], QQy[Q1D][Q1D][W],
+          HQx[Q1D][H1D][W], HQy[Q1D][H1D][W], HH[2][H1D][H1D][W];
+
+   for (int b = 0; b < nblocks; b++)
    {
-      for (int k = 0; k < nqp1D; k++)
+      // The last block might not be full; its missing zones are zeros.
+      const int nz_b = std::min(W, z_end - z_begin - b * W);
+      const T *s_b = stress + b * bstride;
+
+      // Note that the local numbering for L2 is the tensor numbering.
+      for (int w = 0; w < W; w++)
       {
-         HQs_sq(i, k) = HQs(i, k) * HQs(i, k);
+         if (w < nz_b)
+         {
+            l2dofs = l2_e2d.GetRow(z_begin + b * W + w);
+         }
+         for (int j = 0; j < nL2dof; j++)
+         {
+            E[j / L2D][j % L2D][w] = (w < nz_b) ? vecL2(l2dofs[j]) : 0.0;
+         }
       }
-   }
-
-   for (int z = 0; z < nzones; z++)
-   {
-      DenseMatrix QQ_Q(quad_data->rho0DetJ0w.GetData() + z*nqp,
-                       nqp1D * nqp1D, nqp1D);
 
-      // QHQ_k1_i2_k3 = QQQ_k1_k2_k3 HQs_i2_k2^2  -- contract in y direction.
-      // The first step does some reordering (it's not product of matrices).
-      // HHQ_i1_i2_k3 = HQs_i1_k1^2  QHQ_k1_i2_k3 -- contract in x direction.
-      // D_i1_i2_i3   = HHQ_i1_i2_k3 HQs_i3_k3^2  -- contract in z direction.
-      for (int k1 = 0; k1 < nqp1D; k1++)
+      // LQ_j2_k1 = E_j1_j2 LQs_j1_k1  -- contract in x direction.
+      // QQ_k1_k2 = LQ_j2_k1 LQs_j2_k2 -- contract in y direction.
+      for (int j2 = 0; j2 < L2D; j2++)
       {
-         for (int i2 = 0; i2 < ndof1D; i2++)
+         for (int k1 = 0; k1 < Q1D; k1++)
          {
-            for (int k3 = 0; k3 < nqp1D; k3++)
+            for (int w = 0; w < W; w++) { LQ[j2][k1][w] = 0.0; }
+            for (int j1 = 0; j1 < L2D; j1++)
             {
-               Q_HQ(k1, i2 + ndof1D*k3) = 0.0;
-               for (int k2 = 0; k2 < nqp1D; k2++)
+               for (int w = 0; w < W; w++)
                {
-                  Q_HQ(k1, i2 + ndof1D*k3) +=
-                     QQ_Q(k1 + nqp1D*k2, k3) * HQs_sq(i2, k2);
+                  LQ[j2][k1][w] += L[j1][k1] * E[j2][j1][w];
                }
             }
          }
       }
-      mfem::Mult(HQs_sq, Q_HQ, H_HQ);
-      MultABt(HH_Q, HQs_sq, D);
-
-      // Transfer from the tensor structure numbering to mfem's H1 numbering.
-      FESpace.GetElementDofs(z, dofs);
-      for (int j = 0; j < dz.Size(); j++)
+      for (int k2 = 0; k2 < Q1D; k2++)
       {
-         diag[dofs[dof_map[j]]] += dz[j];
+         for (int k1 = 0; k1 < Q1D; k1++)
+         {
+            for (int w = 0; w < W; w++) { QQ[k2][k1][w] = 0.0; }
+            for (int j2 = 0; j2 < L2D; j2++)
+            {
+               for (int w = 0; w < W; w++)
+               {
+                  QQ[k2][k1][w] += L[j2][k2] * LQ[j2][k1][w];
+               }
+            }
+         }
       }
-   }
-
-   for (int i = 0; i < height / 3; i++)
-   {
-      diag(i + height / 3) = diag(i);
-      diag(i + 2 * height / 3) = diag(i);
-   }
-}
 
-void MassPAOperator::Mult(const Vector &x, Vector &y) const
-{
-   const int comp_size = FESpace.GetNDofs();
-   for (int c = 0; c < dim; c++)
-   {
-      Vector x_comp(x.GetData() + c * comp_size, comp_size),
-             y_comp(y.GetData() + c * comp_size, comp_size);
-      if      (dim == 2) { MultQuad(x_comp, y_comp); }
-      else if (dim == 3) { MultHex(x_comp, y_comp); }
-      else { MFEM_ABORT("Unsupported dimension"); }
-   }
-}
+      // Iterate over the components (x and y) of the result.
+      for (int c = 0; c < 2; c++)
+      {
+         // QQx_k1_k2 = QQ_k1_k2 stress_k1_k2(c,0) -- scales d[v_c]_dx.
+         // QQy_k1_k2 = QQ_k1_k2 stress_k1_k2(c,1) -- scales d[v_c]_dy.
+         const T *sx = s_b + (2*c + 0) * cstride,
+                  *sy = s_b + (2*c + 1) * cstride;
+         for (int k2 = 0; k2 < Q1D; k2++)
+         {
+            for (int k1 = 0; k1 < Q1D; k1++)
+            {
+               const int q = k2 * Q1D + k1;
+               for (int w = 0; w < W; w++)
+               {
+                  QQx[k2][k1][w] = QQ[k2][k1][w] * sx[q*W + w];
+                  QQy[k2][k1][w] = QQ[k2][k1][w] * sy[q*W + w];
+               }
+            }
+         }
 
-// Mass matrix action on quadrilateral elements in 2D.
-void MassPAOperator::MultQuad(const Vector &x, Vector &y) const
+         // HQx_i1_k2 = HQg_i1_k1 QQx_k1_k2 -- gradients in x direction.
+         // HQy_i1_k2 = HQs_i1_k1 QQy_k1_k2 -- contract  in x direction.
+         for (int k2 = 0; k2 < Q1D; k2++)
+         {
+            for (int i1 = 0; i1 < H1D; i1++)
+            {
+               for (int w = 0; w < W; w++)
+               {
+                  HQx[k2][i1][w] = 0.0;
+                  HQy[k2][i1][w] = 0.0;
+               }
+               for (int k1 = 0; k1 < Q1D; k1++)
+               {
+                  for (int w = 0; w < W; w++)
+                  {
+                     HQx[k2][i1][w] += G[i1][k1] * QQx[k2][k1][w];
+                     HQy[k2][i1][w] += B[i1][k1] * QQy[k2][k1][w];
+                  }
+               }
+            }
+         }
+
+         // HH_i1_i2 = HQx_i1_k2 HQs_i2_k2 + HQy_i1_k2 HQg_i2_k2
+         //   -- contract in y direction for HQx, gradients for HQy.
+         for (int i2 = 0; i2 < H1D; i2++)
+         {
+            for (int i1 = 0; i1 < H1D; i1++)
+            {
+               for (int w = 0; w < W; w++) { HH[c][i2][i1][w] = 0.0; }
+               for (int k2 = 0; k2 < Q1D; k2++)
+               {
+                  for (int w = 0; w < W; w++)
+                  {
+                     HH[c][i2][i1][w] += B[i2][k2] * HQx[k2][i1][w] +
+                                         G[i2][k2] * HQy[k2][i1][w];
+                  }
+               }
+            }
+         }
+      }
+
+      // Transfer from the tensor structure numbering to mfem's H1 numbering.
+      for (int w = 0; w < nz_b; w++)
+      {
+         h1dofs = h1_e2d.GetRow(z_begin + b * W + w);
+         for (int c = 0; c < 2; c++)
+         {
+            for (int j = 0; j < nH1dof; j++)
+            {
+               vecH1(h1dofs[dof_map[j]] + c*h1_ndofs) +=
+                  HH[c][j / H1D][j % H1D][w];
+            }
+         }
+      }
+   }
+}
+
+// Force matrix action on hexahedral elements in 3D, fixed sizes.
+template<int H1D, int L2D, int Q1D, int W, typename T>
+void ForcePAOperator::MultHexFixed(const T *stress, int bstride,
+                                   int cstride, int z_begin, int z_end,
+                                   const Vector &vecL2, Vector &vecH1) const
+{
+   const int nH1dof = H1D * H1D * H1D,
+             nL2dof = L2D * L2D * L2D, nblocks = (z_end - z_begin + W - 1) / W;
+   double B[H1D][Q1D], G[H1D][Q1D], L[L2D][Q1D];
+   CopyTensors1D<H1D, L2D, Q1D>(B, G, L);
+   const Table &h1_e2d = H1FESpace.GetElementToDofTable(),
+               &l2_e2d = L2FESpace.GetElementToDofTable();
+   const int h1_ndofs = H1FESpace.GetNDofs();
+   const int *h1dofs = NULL, *l2dofs = NULL;
+
+   const H1_HexahedronElement *fe =
+      dynamic_cast<const H1_HexahedronElement *>(H1FESpace.GetFE(0));
+   const Array<int> &dof_map = fe->GetDofMap();
+
+   // All local arrays have the W zones of the block as the last dimension.
+   double E[L2D][L2D][L2D][W], LLQ[L2D][L2D][Q1D][W],
+          LQQ[L2D][Q1D][Q1D][W], QQQ[Q1D][Q1D][Q1D][W],
+          QQHx[Q1D][Q1D][H1D][W], QQHy[Q1D][Q1D][H1D][W],
+          QQHz[Q1D][Q1D][H1D][W], QHHxy[Q1D][H1D][H1D][W],
+          QHHz[Q1D][H1D][H1D][W], HHH[3][H1D][H1D][H1D][W];
+
+   for (int b = 0; b < nblocks; b++)
+   {
+      // The last block might not be full; its missing zones are zeros.
+      const int nz_b = std::min(W, z_end - z_begin - b * W);
+      const T *s_b = stress + b * bstride;
+
+      // Note that the local numbering for L2 is the tensor numbering.
+      for (int w = 0; w < W; w++)
+      {
+         if (w < nz_b)
+         {
+            l2dofs = l2_e2d.GetRow(z_begin + b * W + w);
+         }
+         for (int j = 0; j < nL2dof; j++)
+         {
+            E[j / (L2D*L2D)][(j / L2D) % L2D][j % L2D][w] =
+               (w < nz_b) ? vecL2(l2dofs[j]) : 0.0;
+         }
+      }
+
+      // LLQ_j3_j2_k1 = E_j3_j2_j1 LQs_j1_k1   -- contract in x direction.
+      // LQQ_j3_k2_k1 = LLQ_j3_j2_k1 LQs_j2_k2 -- contract in y direction.
+      // QQQ_k3_k2_k1 = LQQ_j3_k2_k1 LQs_j3_k3 -- contract in z direction.
+      for (int j3 = 0; j3 < L2D; j3++)
+      {
+         for (int j2 = 0; j2 < L2D; j2++)
+         {
+            for (int k1 = 0; k1 < Q1D; k1++)
+            {
+               for (int w = 0; w < W; w++) { LLQ[j3][j2][k1][w] = 0.0; }
+               for (int j1 = 0; j1 < L2D; j1++)
+               {
+                  for (int w = 0; w < W; w++)
+                  {
+                     LLQ[j3][j2][k1][w] += L[j1][k1] * E[j3][j2][j1][w];
+                  }
+               }
+            }
+         }
+      }
+      for (int j3 = 0; j3 < L2D; j3++)
+      {
+         for (int k2 = 0; k2 < Q1D; k2++)
+         {
+            for (int k1 = 0; k1 < Q1D; k1++)
+            {
+               for (int w = 0; w < W; w++) { LQQ[j3][k2][k1][w] = 0.0; }
+               for (int j2 = 0; j2 < L2D; j2++)
+               {
+                  for (int w = 0; w < W; w++)
+                  {
+                     LQQ[j3][k2][k1][w] += L[j2][k2] * LLQ[j3][j2][k1][w];
+                  }
+               }
+            }
+         }
+      }
+      for (int k3 = 0; k3 < Q1D; k3++)
+      {
+         for (int k2 = 0; k2 < Q1D; k2++)
+         {
+            for (int k1 = 0; k1 < Q1D; k1++)
+            {
+               for (int w = 0; w < W; w++) { QQQ[k3][k2][k1][w] = 0.0; }
+               for (int j3 = 0; j3 < L2D; j3++)
+               {
+                  for (int w = 0; w < W; w++)
+                  {
+                     QQQ[k3][k2][k1][w] += L[j3][k3] * LQQ[j3][k2][k1][w];
+                  }
+               }
+            }
+         }
+      }
+
+      // Iterate over the components (x, y, z) of the result.
+      for (int c = 0; c < 3; c++)
+      {
+         const T *sx = s_b + (3*c + 0) * cstride,
+                  *sy = s_b + (3*c + 1) * cstride,
+                  *sz = s_b + (3*c + 2) * cstride;
+
+         // QQHx_k3_k2_i1 = HQg_i1_k1 QQQ_k3_k2_k1 stress(c,0) -- grad in x.
+         // QQHy_k3_k2_i1 = HQs_i1_k1 QQQ_k3_k2_k1 stress(c,1) -- contract x.
+         // QQHz_k3_k2_i1 = HQs_i1_k1 QQQ_k3_k2_k1 stress(c,2) -- contract x.
+         for (int k3 = 0; k3 < Q1D; k3++)
+         {
+            for (int k2 = 0; k2 < Q1D; k2++)
+            {
+               double qx[Q1D][W], qy[Q1D][W], qz[Q1D][W];
+               for (int k1 = 0; k1 < Q1D; k1++)
+               {
+                  const int q = (k3 * Q1D + k2) * Q1D + k1;
+                  for (int w = 0; w < W; w++)
+                  {
+                     qx[k1][w] = QQQ[k3][k2][k1][w] * sx[q*W + w];
+                     qy[k1][w] = QQQ[k3][k2][k1][w] * sy[q*W + w];
+                     qz[k1][w] = QQQ[k3][k2][k1][w] * sz[q*W + w];
+                  }
+               }
+               for (int i1 = 0; i1 < H1D; i1++)
+               {
+                  for (int w = 0; w < W; w++)
+                  {
+                     QQHx[k3][k2][i1][w] = 0.0;
+                     QQHy[k3][k2][i1][w] = 0.0;
+                     QQHz[k3][k2][i1][w] = 0.0;
+                  }
+                  for (int k1 = 0; k1 < Q1D; k1++)
+                  {
+                     for (int w = 0; w < W; w++)
+                     {
+                        QQHx[k3][k2][i1][w] += G[i1][k1] * qx[k1][w];
+                        QQHy[k3][k2][i1][w] += B[i1][k1] * qy[k1][w];
+                        QQHz[k3][k2][i1][w] += B[i1][k1] * qz[k1][w];
+                     }
+                  }
+               }
+            }
+         }
+
+         // QHHxy_k3_i2_i1 = HQs_i2_k2 QQHx + HQg_i2_k2 QQHy -- y direction.
+         // QHHz_k3_i2_i1  = HQs_i2_k2 QQHz                  -- y direction.
+         for (int k3 = 0; k3 < Q1D; k3++)
+         {
+            for (int i2 = 0; i2 < H1D; i2++)
+            {
+               for (int i1 = 0; i1 < H1D; i1++)
+               {
+                  for (int w = 0; w < W; w++)
+                  {
+                     QHHxy[k3][i2][i1][w] = 0.0;
+                     QHHz[k3][i2][i1][w]  = 0.0;
+                  }
+                  for (int k2 = 0; k2 < Q1D; k2++)
+                  {
+                     const double b = B[i2][k2], g = G[i2][k2];
+                     for (int w = 0; w < W; w++)
+                     {
+                        QHHxy[k3][i2][i1][w] += b * QQHx[k3][k2][i1][w] +
+                                                g * QQHy[k3][k2][i1][w];
+                        QHHz[k3][i2][i1][w]  += b * QQHz[k3][k2][i1][w];
+                     }
+                  }
+               }
+            }
+         }
+
+         // HHH_i3_i2_i1 = HQs_i3_k3 QHHxy + HQg_i3_k3 QHHz -- z direction.
+         for (int i3 = 0; i3 < H1D; i3++)
+         {
+            for (int i2 = 0; i2 < H1D; i2++)
+            {
+               for (int i1 = 0; i1 < H1D; i1++)
+               {
+                  for (int w = 0; w < W; w++) { HHH[c][i3][i2][i1][w] = 0.0; }
+                  for (int k3 = 0; k3 < Q1D; k3++)
+                  {
+                     const double b = B[i3][k3], g = G[i3][k3];
+                     for (int w = 0; w < W; w++)
+                     {
+                        HHH[c][i3][i2][i1][w] += b * QHHxy[k3][i2][i1][w] +
+                                                 g * QHHz[k3][i2][i1][w];
+                     }
+                  }
+               }
+            }
+         }
+      }
+
+      // Transfer from the tensor structure numbering to mfem's H1 numbering.
+      for (int w = 0; w < nz_b; w++)
+      {
+         h1dofs = h1_e2d.GetRow(z_begin + b * W + w);
+         for (int c = 0; c < 3; c++)
+         {
+            for (int j = 0; j < nH1dof; j++)
+            {
+               vecH1(h1dofs[dof_map[j]] + c*h1_ndofs) +=
+                  HHH[c][j / (H1D*H1D)][(j / H1D) % H1D][j % H1D][w];
+            }
+         }
+      }
+   }
+}
+
+// Transpose force matrix action on quadrilateral elements in 2D, fixed sizes.
+template<int H1D, int L2D, int Q1D, int W, typename T>
+void ForcePAOperator::MultTransposeQuadFixed(const T *stress,
+                                             int bstride, int cstride,
+                                             int z_begin, int z_end,
+                                             const Vector &vecH1,
+                                             Vector &vecL2) const
+{
+   const int nH1dof = H1D * H1D, nL2dof = L2D * L2D,
+             nblocks = (z_end - z_begin + W - 1) / W;
+   double B[H1D][Q1D], G[H1D][Q1D], L[L2D][Q1D];
+   CopyTensors1D<H1D, L2D, Q1D>(B, G, L);
+   const Table &h1_e2d = H1FESpace.GetElementToDofTable(),
+               &l2_e2d = L2FESpace.GetElementToDofTable();
+   const int h1_ndofs = H1FESpace.GetNDofs();
+   const int *h1dofs = NULL, *l2dofs = NULL;
+
+   const H1_QuadrilateralElement *fe =
+      dynamic_cast<const H1_QuadrilateralElement *>(H1FESpace.GetFE(0));
+   const Array<int> &dof_map = fe->GetDofMap();
+
+   // All local arrays have the W zones of the block as the last dimension.
+   double V[2][H1D][H1D][W], HQg[H1D][Q1D][W], HQs[H1D][Q1D][W],
+          QQ[Q1D][Q1D][W], LQ[Q1D][L2D][W], E[L2D][L2D][W];
+
+   for (int b = 0; b < nblocks; b++)
+   {
+      // The last block might not be full; its missing zones are zeros.
+      const int nz_b = std::min(W, z_end - z_begin - b * W);
+      const T *s_b = stress + b * bstride;
+
+      // Transfer from the mfem's H1 local numbering to the tensor structure
+      // numbering.
+      for (int w = 0; w < W; w++)
+      {
+         if (w < nz_b)
+         {
+            h1dofs = h1_e2d.GetRow(z_begin + b * W + w);
+         }
+         for (int c = 0; c < 2; c++)
+         {
+            for (int j = 0; j < nH1dof; j++)
+            {
+               V[c][j / H1D][j % H1D][w] =
+                  (w < nz_b) ? vecH1(h1dofs[dof_map[j]] + c*h1_ndofs) : 0.0;
+            }
+         }
+      }
+
+      // Form (stress:grad_v) at all quadrature points.
+      for (int k2 = 0; k2 < Q1D; k2++)
+      {
+         for (int k1 = 0; k1 < Q1D; k1++)
+         {
+            for (int w = 0; w < W; w++) { QQ[k2][k1][w] = 0.0; }
+         }
+      }
+      for (int c = 0; c < 2; c++)
+      {
+         // HQg_i2_k1 = V_i2_i1 HQg_i1_k1 -- gradients in x direction.
+         // HQs_i2_k1 = V_i2_i1 HQs_i1_k1 -- contract  in x direction.
+         for (int i2 = 0; i2 < H1D; i2++)
+         {
+            for (int k1 = 0; k1 < Q1D; k1++)
+            {
+               for (int w = 0; w < W; w++)
+               {
+                  HQg[i2][k1][w] = 0.0;
+                  HQs[i2][k1][w] = 0.0;
+               }
+               for (int i1 = 0; i1 < H1D; i1++)
+               {
+                  for (int w = 0; w < W; w++)
+                  {
+                     HQg[i2][k1][w] += G[i1][k1] * V[c][i2][i1][w];
+                     HQs[i2][k1][w] += B[i1][k1] * V[c][i2][i1][w];
+                  }
+               }
+            }
+         }
+
+         // d[v_c]_dx = HQg_i2_k1 HQs_i2_k2, d[v_c]_dy = HQs_i2_k1 HQg_i2_k2.
+         // Add (stress(c,0) * d[v_c]_dx + stress(c,1) * d[v_c]_dy).
+         const T *sx = s_b + (2*c + 0) * cstride,
+                  *sy = s_b + (2*c + 1) * cstride;
+         for (int k2 = 0; k2 < Q1D; k2++)
+         {
+            for (int k1 = 0; k1 < Q1D; k1++)
+            {
+               double dx[W], dy[W];
+               for (int w = 0; w < W; w++) { dx[w] = 0.0; dy[w] = 0.0; }
+               for (int i2 = 0; i2 < H1D; i2++)
+               {
+                  for (int w = 0; w < W; w++)
+                  {
+                     dx[w] += HQg[i2][k1][w] * B[i2][k2];
+                     dy[w] += HQs[i2][k1][w] * G[i2][k2];
+                  }
+               }
+               const int q = k2 * Q1D + k1;
+               for (int w = 0; w < W; w++)
+               {
+                  QQ[k2][k1][w] += dx[w] * sx[q*W + w] + dy[w] * sy[q*W + w];
+               }
+            }
+         }
+      }
+
+      // LQ_k2_j1 = LQs_j1_k1 QQ_k1_k2 -- contract in x direction.
+      // E_j1_j2  = LQ_k2_j1 LQs_j2_k2 -- contract in y direction.
+      for (int k2 = 0; k2 < Q1D; k2++)
+      {
+         for (int j1 = 0; j1 < L2D; j1++)
+         {
+            for (int w = 0; w < W; w++) { LQ[k2][j1][w] = 0.0; }
+            for (int k1 = 0; k1 < Q1D; k1++)
+            {
+               for (int w = 0; w < W; w++)
+               {
+                  LQ[k2][j1][w] += L[j1][k1] * QQ[k2][k1][w];
+               }
+            }
+         }
+      }
+      for (int j2 = 0; j2 < L2D; j2++)
+      {
+         for (int j1 = 0; j1 < L2D; j1++)
+         {
+            for (int w = 0; w < W; w++) { E[j2][j1][w] = 0.0; }
+            for (int k2 = 0; k2 < Q1D; k2++)
+            {
+               for (int w = 0; w < W; w++)
+               {
+                  E[j2][j1][w] += L[j2][k2] * LQ[k2][j1][w];
+               }
+            }
+         }
+      }
+
+      for (int w = 0; w < nz_b; w++)
+      {
+         l2dofs = l2_e2d.GetRow(z_begin + b * W + w);
+         for (int j = 0; j < nL2dof; j++)
+         {
+            vecL2(l2dofs[j]) = E[j / L2D][j % L2D][w];
+         }
+      }
+   }
+}
+
+// Transpose force matrix action on hexahedral elements in 3D, fixed sizes.
+template<int H1D, int L2D, int Q1D, int W, typename T>
+void ForcePAOperator::MultTransposeHexFixed(const T *stress,
+                                            int bstride, int cstride,
+                                            int z_begin, int z_end,
+                                            const Vector &vecH1,
+                                            Vector &vecL2) const
+{
+   const int nqp = Q1D * Q1D * Q1D, nH1dof = H1D * H1D * H1D,
+             nL2dof = L2D * L2D * L2D, nblocks = (z_end - z_begin + W - 1) / W;
+   double B[H1D][Q1D], G[H1D][Q1D], L[L2D][Q1D];
+   CopyTensors1D<H1D, L2D, Q1D>(B, G, L);
+   const Table &h1_e2d = H1FESpace.GetElementToDofTable(),
+               &l2_e2d = L2FESpace.GetElementToDofTable();
+   const int h1_ndofs = H1FESpace.GetNDofs();
+   const int *h1dofs = NULL, *l2dofs = NULL;
+
+   const H1_HexahedronElement *fe =
+      dynamic_cast<const H1_HexahedronElement *>(H1FESpace.GetFE(0));
+   const Array<int> &dof_map = fe->GetDofMap();
+
+   // All local arrays have the W zones of the block as the last dimension.
+   double V[3][H1D][H1D][H1D][W], HHQg[H1D][H1D][Q1D][W],
+          HHQs[H1D][H1D][Q1D][W], HQQx[H1D][Q1D][Q1D][W],
+          HQQy[H1D][Q1D][Q1D][W], HQQz[H1D][Q1D][Q1D][W],
+          QQQ[Q1D][Q1D][Q1D][W], QQL[Q1D][Q1D][L2D][W],
+          QLL[Q1D][L2D][L2D][W], E[L2D][L2D][L2D][W];
+
+   for (int b = 0; b < nblocks; b++)
+   {
+      // The last block might not be full; its missing zones are zeros.
+      const int nz_b = std::min(W, z_end - z_begin - b * W);
+      const T *s_b = stress + b * bstride;
+
+      // Transfer from the mfem's H1 local numbering to the tensor structure
+      // numbering.
+      for (int w = 0; w < W; w++)
+      {
+         if (w < nz_b)
+         {
+            h1dofs = h1_e2d.GetRow(z_begin + b * W + w);
+         }
+         for (int c = 0; c < 3; c++)
+         {
+            for (int j = 0; j < nH1dof; j++)
+            {
+               V[c][j / (H1D*H1D)][(j / H1D) % H1D][j % H1D][w] =
+                  (w < nz_b) ? vecH1(h1dofs[dof_map[j]] + c*h1_ndofs) : 0.0;
+            }
+         }
+      }
+
+      // Form (stress:grad_v) at all quadrature points.
+      double *qqq = &QQQ[0][0][0][0];
+      for (int q = 0; q < nqp * W; q++) { qqq[q] = 0.0; }
+      for (int c = 0; c < 3; c++)
+      {
+         // HHQg_i3_i2_k1 = V_i3_i2_i1 HQg_i1_k1 -- gradients in x direction.
+         // HHQs_i3_i2_k1 = V_i3_i2_i1 HQs_i1_k1 -- contract  in x direction.
+         for (int i3 = 0; i3 < H1D; i3++)
+         {
+            for (int i2 = 0; i2 < H1D; i2++)
+            {
+               for (int k1 = 0; k1 < Q1D; k1++)
+               {
+                  for (int w = 0; w < W; w++)
+                  {
+                     HHQg[i3][i2][k1][w] = 0.0;
+                     HHQs[i3][i2][k1][w] = 0.0;
+                  }
+                  for (int i1 = 0; i1 < H1D; i1++)
+                  {
+                     for (int w = 0; w < W; w++)
+                     {
+                        HHQg[i3][i2][k1][w] += G[i1][k1] * V[c][i3][i2][i1][w];
+                        HHQs[i3][i2][k1][w] += B[i1][k1] * V[c][i3][i2][i1][w];
+                     }
+                  }
+               }
+            }
+         }
+
+         // HQQx_i3_k2_k1 = HHQg_i3_i2_k1 HQs_i2_k2 -- contract  in y direction.
+         // HQQy_i3_k2_k1 = HHQs_i3_i2_k1 HQg_i2_k2 -- gradients in y direction.
+         // HQQz_i3_k2_k1 = HHQs_i3_i2_k1 HQs_i2_k2 -- contract  in y direction.
+         for (int i3 = 0; i3 < H1D; i3++)
+         {
+            for (int k2 = 0; k2 < Q1D; k2++)
+            {
+               for (int k1 = 0; k1 < Q1D; k1++)
+               {
+                  for (int w = 0; w < W; w++)
+                  {
+                     HQQx[i3][k2][k1][w] = 0.0;
+                     HQQy[i3][k2][k1][w] = 0.0;
+                     HQQz[i3][k2][k1][w] = 0.0;
+                  }
+                  for (int i2 = 0; i2 < H1D; i2++)
+                  {
+                     for (int w = 0; w < W; w++)
+                     {
+                        HQQx[i3][k2][k1][w] += HHQg[i3][i2][k1][w] * B[i2][k2];
+                        HQQy[i3][k2][k1][w] += HHQs[i3][i2][k1][w] * G[i2][k2];
+                        HQQz[i3][k2][k1][w] += HHQs[i3][i2][k1][w] * B[i2][k2];
+                     }
+                  }
+               }
+            }
+         }
+
+         // d[v_c]_dx = HQQx HQs_i3_k3, d[v_c]_dy = HQQy HQs_i3_k3,
+         // d[v_c]_dz = HQQz HQg_i3_k3 -- z direction.
+         // Add (stress(c,0) * d[v_c]_dx + ... + stress(c,2) * d[v_c]_dz).
+         const T *sx = s_b + (3*c + 0) * cstride,
+                  *sy = s_b + (3*c + 1) * cstride,
+                  *sz = s_b + (3*c + 2) * cstride;
+         for (int k3 = 0; k3 < Q1D; k3++)
+         {
+            for (int k2 = 0; k2 < Q1D; k2++)
+            {
+               for (int k1 = 0; k1 < Q1D; k1++)
+               {
+                  double dx[W], dy[W], dz[W];
+                  for (int w = 0; w < W; w++)
+                  {
+                     dx[w] = 0.0; dy[w] = 0.0; dz[w] = 0.0;
+                  }
+                  for (int i3 = 0; i3 < H1D; i3++)
+                  {
+                     for (int w = 0; w < W; w++)
+                     {
+                        dx[w] += HQQx[i3][k2][k1][w] * B[i3][k3];
+                        dy[w] += HQQy[i3][k2][k1][w] * B[i3][k3];
+                        dz[w] += HQQz[i3][k2][k1][w] * G[i3][k3];
+                     }
+                  }
+                  const int q = (k3 * Q1D + k2) * Q1D + k1;
+                  for (int w = 0; w < W; w++)
+                  {
+                     QQQ[k3][k2][k1][w] += dx[w] * sx[q*W + w] +
+                                           dy[w] * sy[q*W + w] +
+                                           dz[w] * sz[q*W + w];
+                  }
+               }
+            }
+         }
+      }
+
+      // QQL_k3_k2_j1 = LQs_j1_k1 QQQ_k3_k2_k1 -- contract in x direction.
+      // QLL_k3_j2_j1 = LQs_j2_k2 QQL_k3_k2_j1 -- contract in y direction.
+      // E_j3_j2_j1   = LQs_j3_k3 QLL_k3_j2_j1 -- contract in z direction.
+      for (int k3 = 0; k3 < Q1D; k3++)
+      {
+         for (int k2 = 0; k2 < Q1D; k2++)
+         {
+            for (int j1 = 0; j1 < L2D; j1++)
+            {
+               for (int w = 0; w < W; w++) { QQL[k3][k2][j1][w] = 0.0; }
+               for (int k1 = 0; k1 < Q1D; k1++)
+               {
+                  for (int w = 0; w < W; w++)
+                  {
+                     QQL[k3][k2][j1][w] += L[j1][k1] * QQQ[k3][k2][k1][w];
+                  }
+               }
+            }
+         }
+      }
+      for (int k3 = 0; k3 < Q1D; k3++)
+      {
+         for (int j2 = 0; j2 < L2D; j2++)
+         {
+            for (int j1 = 0; j1 < L2D; j1++)
+            {
+               for (int w = 0; w < W; w++) { QLL[k3][j2][j1][w] = 0.0; }
+               for (int k2 = 0; k2 < Q1D; k2++)
+               {
+                  for (int w = 0; w < W; w++)
+                  {
+                     QLL[k3][j2][j1][w] += L[j2][k2] * QQL[k3][k2][j1][w];
+                  }
+               }
+            }
+         }
+      }
+      for (int j3 = 0; j3 < L2D; j3++)
+      {
+         for (int j2 = 0; j2 < L2D; j2++)
+         {
+            for (int j1 = 0; j1 < L2D; j1++)
+            {
+               for (int w = 0; w < W; w++) { E[j3][j2][j1][w] = 0.0; }
+               for (int k3 = 0; k3 < Q1D; k3++)
+               {
+                  for (int w = 0; w < W; w++)
+                  {
+                     E[j3][j2][j1][w] += L[j3][k3] * QLL[k3][j2][j1][w];
+                  }
+               }
+            }
+         }
+      }
+
+      for (int w = 0; w < nz_b; w++)
+      {
+         l2dofs = l2_e2d.GetRow(z_begin + b * W + w);
+         for (int j = 0; j < nL2dof; j++)
+         {
+            vecL2(l2dofs[j]) =
+               E[j / (L2D*L2D)][(j / L2D) % L2D][j % L2D][w];
+         }
+      }
+   }
+}
+
+template<int H1D, int L2D, int Q1D, typename T>
+typename ForcePAOperator::KernelPtr<T>::Type
+ForcePAOperator::MultKernel(int W) const
+{
+   if (dim == 2)
+   {
+      switch (W)
+      {
+         case 4: return &ForcePAOperator::MultQuadFixed<H1D, L2D, Q1D, 4, T>;
+         case 8: return &ForcePAOperator::MultQuadFixed<H1D, L2D, Q1D, 8, T>;
+         default: return &ForcePAOperator::MultQuadFixed<H1D, L2D, Q1D, 1, T>;
+      }
+   }
+   switch (W)
+   {
+      case 4: return &ForcePAOperator::MultHexFixed<H1D, L2D, Q1D, 4, T>;
+      case 8: return &ForcePAOperator::MultHexFixed<H1D, L2D, Q1D, 8, T>;
+      default: return &ForcePAOperator::MultHexFixed<H1D, L2D, Q1D, 1, T>;
+   }
+}
+
+template<int H1D, int L2D, int Q1D, typename T>
+typename ForcePAOperator::KernelPtr<T>::Type
+ForcePAOperator::MultTransposeKernel(int W) const
+{
+   if (dim == 2)
+   {
+      switch (W)
+      {
+         case 4: return &ForcePAOperator::
+                        MultTransposeQuadFixed<H1D, L2D, Q1D, 4, T>;
+         case 8: return &ForcePAOperator::
+                        MultTransposeQuadFixed<H1D, L2D, Q1D, 8, T>;
+         default: return &ForcePAOperator::
+                         MultTransposeQuadFixed<H1D, L2D, Q1D, 1, T>;
+      }
+   }
+   switch (W)
+   {
+      case 4: return &ForcePAOperator::
+                     MultTransposeHexFixed<H1D, L2D, Q1D, 4, T>;
+      case 8: return &ForcePAOperator::
+                     MultTransposeHexFixed<H1D, L2D, Q1D, 8, T>;
+      default: return &ForcePAOperator::
+                      MultTransposeHexFixed<H1D, L2D, Q1D, 1, T>;
+   }
+}
+
+// Key of a fixed-size kernel: the 1D sizes (each below 16).
+static inline int KernelId(int H1D, int L2D, int Q1D)
+{
+   return (H1D << 8) | (L2D << 4) | Q1D;
+}
+
+template<typename T>
+typename ForcePAOperator::KernelPtr<T>::Type
+ForcePAOperator::GetMultKernel() const
+{
+   if (dim != 2 && dim != 3) { return NULL; }
+   const int H1D = tensors1D->HQshape1D.Height(),
+             L2D = tensors1D->LQshape1D.Height(),
+             Q1D = tensors1D->HQshape1D.Width(),
+             W   = quad_data->simd_width;
+   // The instantiated combinations correspond to the orders (k, k-1) that are
+   // integrated with 2k quadrature points in 1D, for k = 1 .. 6.
+   switch (KernelId(H1D, L2D, Q1D))
+   {
+      case 0x212: return MultKernel<2, 1, 2, T>(W);
+      case 0x324: return MultKernel<3, 2, 4, T>(W);
+      case 0x436: return MultKernel<4, 3, 6, T>(W);
+      case 0x548: return MultKernel<5, 4, 8, T>(W);
+      case 0x65A: return MultKernel<6, 5, 10, T>(W);
+      case 0x76C: return MultKernel<7, 6, 12, T>(W);
+      default: return NULL;
+   }
+}
+
+template<typename T>
+typename ForcePAOperator::KernelPtr<T>::Type
+ForcePAOperator::GetMultTransposeKernel() const
+{
+   if (dim != 2 && dim != 3) { return NULL; }
+   const int H1D = tensors1D->HQshape1D.Height(),
+             L2D = tensors1D->LQshape1D.Height(),
+             Q1D = tensors1D->HQshape1D.Width(),
+             W   = quad_data->simd_width;
+   switch (KernelId(H1D, L2D, Q1D))
+   {
+      case 0x212: return MultTransposeKernel<2, 1, 2, T>(W);
+      case 0x324: return MultTransposeKernel<3, 2, 4, T>(W);
+      case 0x436: return MultTransposeKernel<4, 3, 6, T>(W);
+      case 0x548: return MultTransposeKernel<5, 4, 8, T>(W);
+      case 0x65A: return MultTransposeKernel<6, 5, 10, T>(W);
+      case 0x76C: return MultTransposeKernel<7, 6, 12, T>(W);
+      default: return NULL;
+   }
+}
+
+void MassPAOperator::ComputeDiagonal2D(Vector &diag) const
+{
+   const H1_QuadrilateralElement *fe_H1 =
+      dynamic_cast<const H1_QuadrilateralElement *>(FESpace.GetFE(0));
+   const Array<int> &dof_map = fe_H1->GetDofMap();
+   const DenseMatrix &HQs = tensors1D->HQshape1D;
+
+   const int ndof1D = HQs.Height(), nqp1D = HQs.Width(), nqp = nqp1D * nqp1D;
+   Vector dz(ndof1D * ndof1D), d_buf(nqp);
+   DenseMatrix HQ(ndof1D, nqp1D), D(dz.GetData(), ndof1D, ndof1D);
+   Array<int> dofs;
+
+   diag.SetSize(height);
+   diag = 0.0;
+
+   // Squares of the shape functions at all quadrature points.
+   DenseMatrix HQs_sq(ndof1D, nqp1D);
+   for (int i = 0; i < ndof1D; i++)
+   {
+      for (int k = 0; k < nqp1D; k++)
+      {
+         HQs_sq(i, k) = HQs(i, k) * HQs(i, k);
+      }
+   }
+
+   for (int z = 0; z < nzones; z++)
+   {
+      DenseMatrix QQ(quad_data->GetRho0DetJ0w(z, d_buf.GetData()),
+                     nqp1D, nqp1D);
+
+      // HQ_i1_k2 = HQs_i1_k1^2 QQ_k1_k2    -- contract in x direction.
+      // Y_i1_i2  = HQ_i1_k2    HQs_i2_k2^2 -- contract in y direction.
+      mfem::Mult(HQs_sq, QQ, HQ);
+      MultABt(HQ, HQs_sq, D);
+
+      // Transfer from the tensor structure numbering to mfem's H1 numbering.
+      FESpace.GetElementDofs(z, dofs);
+      for (int j = 0; j < dz.Size(); j++)
+      {
+         diag[dofs[dof_map[j]]] += dz[j];
+      }
+   }
+
+   for (int i = 0; i < height / 2; i++)
+   {
+      diag(i + height / 2) = diag(i);
+   }
+}
+
+void MassPAOperator::ComputeDiagonal3D(Vector &diag) const
+{
+   const H1_HexahedronElement *fe_H1 =
+      dynamic_cast<const H1_HexahedronElement *>(FESpace.GetFE(0));
+   const Array<int> &dof_map = fe_H1->GetDofMap();
+   const DenseMatrix &HQs = tensors1D->HQshape1D;
+
+   const int ndof1D = HQs.Height(), nqp1D = HQs.Width(),
+             nqp = nqp1D * nqp1D * nqp1D;
+   DenseMatrix HH_Q(ndof1D * ndof1D, nqp1D), Q_HQ(nqp1D, ndof1D*nqp1D);
+   DenseMatrix H_HQ(HH_Q.GetData(), ndof1D, ndof1D*nqp1D);
+   Vector dz(ndof1D * ndof1D * ndof1D), d_buf(nqp);
+   DenseMatrix D(dz.GetData(), ndof1D*ndof1D, ndof1D);
+   Array<int> dofs;
+
+   diag.SetSize(height);
+   diag = 0.0;
+
+   // Squares of the shape functions at all quadrature points.
+   DenseMatrix HQs_sq(ndof1D, nqp1D);
+   for (int i = 0; i < ndof1D; i++)
+   {
+      for (int k = 0; k < nqp1D; k++)
+      {
+         HQs_sq(i, k) = HQs(i, k) * HQs(i, k);
+      }
+   }
+
+   for (int z = 0; z < nzones; z++)
+   {
+      DenseMatrix QQ_Q(quad_data->GetRho0DetJ0w(z, d_buf.GetData()),
+                       nqp1D * nqp1D, nqp1D);
+
+      // QHQ_k1_i2_k3 = QQQ_k1_k2_k3 HQs_i2_k2^2  -- contract in y direction.
+      // The first step does some reordering (it's not product of matrices).
+      // HHQ_i1_i2_k3 = HQs_i1_k1^2  QHQ_k1_i2_k3 -- contract in x direction.
+      // D_i1_i2_i3   = HHQ_i1_i2_k3 HQs_i3_k3^2  -- contract in z direction.
+      for (int k1 = 0; k1 < nqp1D; k1++)
+      {
+         for (int i2 = 0; i2 < ndof1D; i2++)
+         {
+            for (int k3 = 0; k3 < nqp1D; k3++)
+            {
+               Q_HQ(k1, i2 + ndof1D*k3) = 0.0;
+               for (int k2 = 0; k2 < nqp1D; k2++)
+               {
+                  Q_HQ(k1, i2 + ndof1D*k3) +=
+                     QQ_Q(k1 + nqp1D*k2, k3) * HQs_sq(i2, k2);
+               }
+            }
+         }
+      }
+      mfem::Mult(HQs_sq, Q_HQ, H_HQ);
+      MultABt(HH_Q, HQs_sq, D);
+
+      // Transfer from the tensor structure numbering to mfem's H1 numbering.
+      FESpace.GetElementDofs(z, dofs);
+      for (int j = 0; j < dz.Size(); j++)
+      {
+         diag[dofs[dof_map[j]]] += dz[j];
+      }
+   }
+
+   for (int i = 0; i < height / 3; i++)
+   {
+      diag(i + height / 3) = diag(i);
+      diag(i + 2 * height / 3) = diag(i);
+   }
+}
+
+void MassPAOperator::Mult(const Vector &x, Vector &y) const
+{
+   ProfileRegion region("MassPA");
+   const int comp_size = FESpace.GetNDofs();
+   for (int c = 0; c < dim; c++)
+   {
+      Vector x_comp(x.GetData() + c * comp_size, comp_size),
+             y_comp(y.GetData() + c * comp_size, comp_size);
+      if      (quad_data->simd_width == 1) { MultZI<1>(x_comp, y_comp); }
+      else if (quad_data->simd_width == 4) { MultZI<4>(x_comp, y_comp); }
+      else if (quad_data->simd_width == 8) { MultZI<8>(x_comp, y_comp); }
+      else if (dim == 2) { MultQuad(x_comp, y_comp); }
+      else if (dim == 3) { MultHex(x_comp, y_comp); }
+      else { MFEM_ABORT("Unsupported dimension"); }
+   }
+}
+
+void MassPAOperator::MultStandard(const Vector &x, Vector &y) const
+{
+   const int comp_size = FESpace.GetNDofs();
+   y.SetSize(x.Size());
+   for (int c = 0; c < dim; c++)
+   {
+      Vector x_comp(x.GetData() + c * comp_size, comp_size),
+             y_comp(y.GetData() + c * comp_size, comp_size);
+      if      (dim == 2) { MultQuad(x_comp, y_comp); }
+      else if (dim == 3) { MultHex(x_comp, y_comp); }
+      else { MFEM_ABORT("Unsupported dimension"); }
+   }
+}
+
+template<int W>
+void MassPAOperator::MultZI(const Vector &x, Vector &y) const
+{
+   const float *d_sp = quad_data->rho0DetJ0w_zf.GetData();
+   const double *d = quad_data->rho0DetJ0w_zi.GetData();
+   const bool sp = quad_data->single_qdata;
+   if (dim == 2)
+   {
+      if (sp) { MultQuadZI<W>(d_sp, x, y); }
+      else    { MultQuadZI<W>(d, x, y); }
+   }
+   else if (dim == 3)
+   {
+      if (sp) { MultHexZI<W>(d_sp, x, y); }
+      else    { MultHexZI<W>(d, x, y); }
+   }
+   else { MFEM_ABORT("Unsupported dimension"); }
+}
+
+// Mass matrix action on quadrilateral elements in 2D.
+void MassPAOperator::MultQuad(const Vector &x, Vector &y) const
 {
+   work.Reset();
    const H1_QuadrilateralElement *fe_H1 =
       dynamic_cast<const H1_QuadrilateralElement *>(FESpace.GetFE(0));
    const DenseMatrix &HQs = tensors1D->HQshape1D;
 
    const int ndof1D = HQs.Height(), nqp1D = HQs.Width();
-   DenseMatrix HQ(ndof1D, nqp1D), QQ(nqp1D, nqp1D);
-   Vector xz(ndof1D * ndof1D), yz(ndof1D * ndof1D);
+   DenseMatrix HQ(work.Reserve(ndof1D * nqp1D), ndof1D, nqp1D),
+               QQ(work.Reserve(nqp1D * nqp1D), nqp1D, nqp1D);
+   Vector xz(work.Reserve(ndof1D * ndof1D), ndof1D * ndof1D),
+          yz(work.Reserve(ndof1D * ndof1D), ndof1D * ndof1D);
    DenseMatrix X(xz.GetData(), ndof1D, ndof1D),
                Y(yz.GetData(), ndof1D, ndof1D);
-   Array<int> dofs;
+   const Table &e2d = FESpace.GetElementToDofTable();
+   const int *dofs = NULL;
    double *qq = QQ.GetData();
    const int nqp = nqp1D * nqp1D;
+   double *d_buf = work.Reserve(nqp);
 
    y.SetSize(x.Size());
    y = 0.0;
 
    for (int z = 0; z < nzones; z++)
    {
-      FESpace.GetElementDofs(z, dofs);
+      dofs = e2d.GetRow(z);
       // Transfer from the mfem's H1 local numbering to the tensor structure
       // numbering.
       const Array<int> &dof_map = fe_H1->GetDofMap();
@@ -975,7 +2289,7 @@ void MassPAOperator::MultQuad(const Vector &x, Vector &y) const
       MultAtB(HQs, HQ, QQ);
 
       // QQ_k1_k2 *= quad_data_k1_k2 -- scaling with quadrature values.
-      double *d = quad_data->rho0DetJ0w.GetData() + z*nqp;
+      const double *d = quad_data->GetRho0DetJ0w(z, d_buf);
       for (int q = 0; q < nqp; q++) { qq[q] *= d[q]; }
 
       // HQ_i1_k2 = HQs_i1_k1 QQ_k1_k2 -- contract in x direction.
@@ -993,28 +2307,33 @@ void MassPAOperator::MultQuad(const Vector &x, Vector &y) const
 // Mass matrix action on hexahedral elements in 3D.
 void MassPAOperator::MultHex(const Vector &x, Vector &y) const
 {
+   work.Reset();
    const H1_HexahedronElement *fe_H1 =
       dynamic_cast<const H1_HexahedronElement *>(FESpace.GetFE(0));
    const DenseMatrix &HQs = tensors1D->HQshape1D;
 
    const int ndof1D = HQs.Height(), nqp1D = HQs.Width();
-   DenseMatrix HH_Q(ndof1D * ndof1D, nqp1D);
+   DenseMatrix HH_Q(work.Reserve(ndof1D * ndof1D * nqp1D),
+                    ndof1D * ndof1D, nqp1D);
    DenseMatrix H_HQ(HH_Q.GetData(), ndof1D, ndof1D*nqp1D);
-   DenseMatrix Q_HQ(nqp1D, ndof1D*nqp1D);
-   DenseMatrix QQ_Q(nqp1D*nqp1D, nqp1D);
+   DenseMatrix Q_HQ(work.Reserve(nqp1D * ndof1D * nqp1D), nqp1D, ndof1D*nqp1D);
+   DenseMatrix QQ_Q(work.Reserve(nqp1D * nqp1D * nqp1D), nqp1D*nqp1D, nqp1D);
    double *qqq = QQ_Q.GetData();
-   Vector xz(ndof1D * ndof1D * ndof1D), yz(ndof1D * ndof1D * ndof1D);
+   Vector xz(work.Reserve(ndof1D * ndof1D * ndof1D), ndof1D * ndof1D * ndof1D),
+          yz(work.Reserve(ndof1D * ndof1D * ndof1D), ndof1D * ndof1D * ndof1D);
    DenseMatrix X(xz.GetData(), ndof1D*ndof1D, ndof1D),
                Y(yz.GetData(), ndof1D*ndof1D, ndof1D);
    const int nqp = nqp1D * nqp1D * nqp1D;
-   Array<int> dofs;
+   double *d_buf = work.Reserve(nqp);
+   const Table &e2d = FESpace.GetElementToDofTable();
+   const int *dofs = NULL;
 
    y.SetSize(x.Size());
    y = 0.0;
 
    for (int z = 0; z < nzones; z++)
    {
-      FESpace.GetElementDofs(z, dofs);
+      dofs = e2d.GetRow(z);
       // Transfer from the mfem's H1 local numbering to the tensor structure
       // numbering.
       const Array<int> &dof_map = fe_H1->GetDofMap();
@@ -1035,46 +2354,416 @@ void MassPAOperator::MultHex(const Vector &x, Vector &y) const
          {
             for (int k3 = 0; k3 < nqp1D; k3++)
             {
-               QQ_Q(k1 + nqp1D*k2, k3) = 0.0;
-               for (int i2 = 0; i2 < ndof1D; i2++)
+               QQ_Q(k1 + nqp1D*k2, k3) = 0.0;
+               for (int i2 = 0; i2 < ndof1D; i2++)
+               {
+                  QQ_Q(k1 + nqp1D*k2, k3) +=
+                     Q_HQ(k1, i2 + k3*ndof1D) * HQs(i2, k2);
+               }
+            }
+         }
+      }
+
+      // QQQ_k1_k2_k3 *= quad_data_k1_k2_k3 -- scaling with quadrature values.
+      const double *d = quad_data->GetRho0DetJ0w(z, d_buf);
+      for (int q = 0; q < nqp; q++) { qqq[q] *= d[q]; }
+
+      // QHQ_k1_i2_k3 = QQQ_k1_k2_k3 HQs_i2_k2 -- contract in y direction.
+      // The first step does some reordering (it's not product of matrices).
+      // HHQ_i1_i2_k3 = HQs_i1_k1 QHQ_k1_i2_k3 -- contract in x direction.
+      // Y_i1_i2_i3   = HHQ_i1_i2_k3 HQs_i3_k3 -- contract in z direction.
+      for (int k1 = 0; k1 < nqp1D; k1++)
+      {
+         for (int i2 = 0; i2 < ndof1D; i2++)
+         {
+            for (int k3 = 0; k3 < nqp1D; k3++)
+            {
+               Q_HQ(k1, i2 + ndof1D*k3) = 0.0;
+               for (int k2 = 0; k2 < nqp1D; k2++)
+               {
+                  Q_HQ(k1, i2 + ndof1D*k3) +=
+                     QQ_Q(k1 + nqp1D*k2, k3) * HQs(i2, k2);
+               }
+            }
+         }
+      }
+      mfem::Mult(HQs, Q_HQ, H_HQ);
+      MultABt(HH_Q, HQs, Y);
+
+      for (int j = 0; j < yz.Size(); j++)
+      {
+         y[dofs[dof_map[j]]] += yz[j];
+      }
+   }
+}
+
+// Mass matrix action on quadrilateral elements in 2D, zone-interleaved layout.
+template<int W, typename T>
+void MassPAOperator::MultQuadZI(const T *rho0DetJ0w, const Vector &x,
+                                Vector &y) const
+{
+   work.Reset();
+   const H1_QuadrilateralElement *fe_H1 =
+      dynamic_cast<const H1_QuadrilateralElement *>(FESpace.GetFE(0));
+   const Array<int> &dof_map = fe_H1->GetDofMap();
+   const DenseMatrix &HQs = tensors1D->HQshape1D;
+
+   const int H = HQs.Height(), Q = HQs.Width(), ndof = H * H, nqp = Q * Q,
+             nblocks = (nzones + W - 1) / W;
+   const double *B = HQs.GetData();
+   // Local arrays, with the W zones of the block as the last dimension.
+   Vector X_(work.Reserve(ndof * W), ndof * W),
+          HQ_(work.Reserve(H * Q * W), H * Q * W),
+          QQ_(work.Reserve(nqp * W), nqp * W);
+   double *X = X_.GetData(), *HQ = HQ_.GetData(), *QQ = QQ_.GetData();
+   const Table &e2d = FESpace.GetElementToDofTable();
+   const int *dofs = NULL;
+
+   y.SetSize(x.Size());
+   y = 0.0;
+
+   for (int b = 0; b < nblocks; b++)
+   {
+      // The last block might not be full; its missing zones are zeros.
+      const int nz_b = std::min(W, nzones - b * W);
+      const T *d = rho0DetJ0w + b * nqp * W;
+
+      // Transfer from the mfem's H1 local numbering to the tensor structure
+      // numbering.
+      for (int w = 0; w < W; w++)
+      {
+         if (w < nz_b) { dofs = e2d.GetRow(b * W + w); }
+         for (int j = 0; j < ndof; j++)
+         {
+            X[j*W + w] = (w < nz_b) ? x[dofs[dof_map[j]]] : 0.0;
+         }
+      }
+
+      // HQ_i2_k1 = X_i1_i2 HQs_i1_k1 -- contract in x direction.
+      for (int i2 = 0; i2 < H; i2++)
+      {
+         for (int k1 = 0; k1 < Q; k1++)
+         {
+            double *hq = HQ + (i2*Q + k1) * W;
+            for (int w = 0; w < W; w++) { hq[w] = 0.0; }
+            for (int i1 = 0; i1 < H; i1++)
+            {
+               const double s = B[i1 + H*k1], *xx = X + (i2*H + i1) * W;
+               for (int w = 0; w < W; w++) { hq[w] += s * xx[w]; }
+            }
+         }
+      }
+
+      // QQ_k1_k2 = HQ_i2_k1 HQs_i2_k2 -- contract in y direction.
+      // QQ_k1_k2 *= quad_data_k1_k2   -- scaling with quadrature values.
+      for (int k2 = 0; k2 < Q; k2++)
+      {
+         for (int k1 = 0; k1 < Q; k1++)
+         {
+            double *qq = QQ + (k2*Q + k1) * W;
+            for (int w = 0; w < W; w++) { qq[w] = 0.0; }
+            for (int i2 = 0; i2 < H; i2++)
+            {
+               const double s = B[i2 + H*k2], *hq = HQ + (i2*Q + k1) * W;
+               for (int w = 0; w < W; w++) { qq[w] += s * hq[w]; }
+            }
+            const T *dq = d + (k2*Q + k1) * W;
+            for (int w = 0; w < W; w++) { qq[w] *= dq[w]; }
+         }
+      }
+
+      // HQ_i1_k2 = HQs_i1_k1 QQ_k1_k2 -- contract in x direction.
+      for (int k2 = 0; k2 < Q; k2++)
+      {
+         for (int i1 = 0; i1 < H; i1++)
+         {
+            double *hq = HQ + (k2*H + i1) * W;
+            for (int w = 0; w < W; w++) { hq[w] = 0.0; }
+            for (int k1 = 0; k1 < Q; k1++)
+            {
+               const double s = B[i1 + H*k1], *qq = QQ + (k2*Q + k1) * W;
+               for (int w = 0; w < W; w++) { hq[w] += s * qq[w]; }
+            }
+         }
+      }
+
+      // Y_i1_i2 = HQ_i1_k2 HQs_i2_k2 -- contract in y direction.
+      double *Y = X;
+      for (int i2 = 0; i2 < H; i2++)
+      {
+         for (int i1 = 0; i1 < H; i1++)
+         {
+            double *yy = Y + (i2*H + i1) * W;
+            for (int w = 0; w < W; w++) { yy[w] = 0.0; }
+            for (int k2 = 0; k2 < Q; k2++)
+            {
+               const double s = B[i2 + H*k2], *hq = HQ + (k2*H + i1) * W;
+               for (int w = 0; w < W; w++) { yy[w] += s * hq[w]; }
+            }
+         }
+      }
+
+      for (int w = 0; w < nz_b; w++)
+      {
+         dofs = e2d.GetRow(b * W + w);
+         for (int j = 0; j < ndof; j++) { y[dofs[dof_map[j]]] += Y[j*W + w]; }
+      }
+   }
+}
+
+// Mass matrix action on hexahedral elements in 3D, zone-interleaved layout.
+template<int W, typename T>
+void MassPAOperator::MultHexZI(const T *rho0DetJ0w, const Vector &x,
+                               Vector &y) const
+{
+   work.Reset();
+   const H1_HexahedronElement *fe_H1 =
+      dynamic_cast<const H1_HexahedronElement *>(FESpace.GetFE(0));
+   const Array<int> &dof_map = fe_H1->GetDofMap();
+   const DenseMatrix &HQs = tensors1D->HQshape1D;
+
+   const int H = HQs.Height(), Q = HQs.Width(), ndof = H * H * H,
+             nqp = Q * Q * Q, nblocks = (nzones + W - 1) / W;
+   const double *B = HQs.GetData();
+   // Local arrays, with the W zones of the block as the last dimension. The
+   // buffers of the first half are reused in the second half.
+   Vector X_(work.Reserve(ndof * W), ndof * W),
+          HHQ_(work.Reserve(H * H * Q * W), H * H * Q * W),
+          HQQ_(work.Reserve(H * Q * Q * W), H * Q * Q * W),
+          QQQ_(work.Reserve(nqp * W), nqp * W);
+   double *X = X_.GetData(), *HHQ = HHQ_.GetData(), *HQQ = HQQ_.GetData(),
+          *QQQ = QQQ_.GetData();
+   const Table &e2d = FESpace.GetElementToDofTable();
+   const int *dofs = NULL;
+
+   y.SetSize(x.Size());
+   y = 0.0;
+
+   for (int b = 0; b < nblocks; b++)
+   {
+      // The last block might not be full; its missing zones are zeros.
+      const int nz_b = std::min(W, nzones - b * W);
+      const T *d = rho0DetJ0w + b * nqp * W;
+
+      // Transfer from the mfem's H1 local numbering to the tensor structure
+      // numbering.
+      for (int w = 0; w < W; w++)
+      {
+         if (w < nz_b) { dofs = e2d.GetRow(b * W + w); }
+         for (int j = 0; j < ndof; j++)
+         {
+            X[j*W + w] = (w < nz_b) ? x[dofs[dof_map[j]]] : 0.0;
+         }
+      }
+
+      // HHQ_i3_i2_k1 = X_i3_i2_i1 HQs_i1_k1   -- contract in x direction.
+      for (int i32 = 0; i32 < H * H; i32++)
+      {
+         for (int k1 = 0; k1 < Q; k1++)
+         {
+            double *o = HHQ + (i32*Q + k1) * W;
+            for (int w = 0; w < W; w++) { o[w] = 0.0; }
+            for (int i1 = 0; i1 < H; i1++)
+            {
+               const double s = B[i1 + H*k1], *in = X + (i32*H + i1) * W;
+               for (int w = 0; w < W; w++) { o[w] += s * in[w]; }
+            }
+         }
+      }
+      // HQQ_i3_k2_k1 = HHQ_i3_i2_k1 HQs_i2_k2 -- contract in y direction.
+      for (int i3 = 0; i3 < H; i3++)
+      {
+         for (int k2 = 0; k2 < Q; k2++)
+         {
+            for (int k1 = 0; k1 < Q; k1++)
+            {
+               double *o = HQQ + ((i3*Q + k2)*Q + k1) * W;
+               for (int w = 0; w < W; w++) { o[w] = 0.0; }
+               for (int i2 = 0; i2 < H; i2++)
+               {
+                  const double s = B[i2 + H*k2],
+                               *in = HHQ + ((i3*H + i2)*Q + k1) * W;
+                  for (int w = 0; w < W; w++) { o[w] += s * in[w]; }
+               }
+            }
+         }
+      }
+      // QQQ_k3_k2_k1 = HQQ_i3_k2_k1 HQs_i3_k3 -- contract in z direction.
+      // QQQ_k3_k2_k1 *= quad_data_k3_k2_k1    -- scaling with quad values.
+      for (int k3 = 0; k3 < Q; k3++)
+      {
+         for (int k21 = 0; k21 < Q * Q; k21++)
+         {
+            double *o = QQQ + (k3*Q*Q + k21) * W;
+            for (int w = 0; w < W; w++) { o[w] = 0.0; }
+            for (int i3 = 0; i3 < H; i3++)
+            {
+               const double s = B[i3 + H*k3], *in = HQQ + (i3*Q*Q + k21) * W;
+               for (int w = 0; w < W; w++) { o[w] += s * in[w]; }
+            }
+            const T *dq = d + (k3*Q*Q + k21) * W;
+            for (int w = 0; w < W; w++) { o[w] *= dq[w]; }
+         }
+      }
+
+      // QQH_k3_k2_i1 = HQs_i1_k1 QQQ_k3_k2_k1 -- contract in x direction.
+      double *QQH = HQQ;
+      for (int k32 = 0; k32 < Q * Q; k32++)
+      {
+         for (int i1 = 0; i1 < H; i1++)
+         {
+            double *o = QQH + (k32*H + i1) * W;
+            for (int w = 0; w < W; w++) { o[w] = 0.0; }
+            for (int k1 = 0; k1 < Q; k1++)
+            {
+               const double s = B[i1 + H*k1], *in = QQQ + (k32*Q + k1) * W;
+               for (int w = 0; w < W; w++) { o[w] += s * in[w]; }
+            }
+         }
+      }
+      // QHH_k3_i2_i1 = HQs_i2_k2 QQH_k3_k2_i1 -- contract in y direction.
+      double *QHH = HHQ;
+      for (int k3 = 0; k3 < Q; k3++)
+      {
+         for (int i2 = 0; i2 < H; i2++)
+         {
+            for (int i1 = 0; i1 < H; i1++)
+            {
+               double *o = QHH + ((k3*H + i2)*H + i1) * W;
+               for (int w = 0; w < W; w++) { o[w] = 0.0; }
+               for (int k2 = 0; k2 < Q; k2++)
                {
-                  QQ_Q(k1 + nqp1D*k2, k3) +=
-                     Q_HQ(k1, i2 + k3*ndof1D) * HQs(i2, k2);
+                  const double s = B[i2 + H*k2],
+                               *in = QQH + ((k3*Q + k2)*H + i1) * W;
+                  for (int w = 0; w < W; w++) { o[w] += s * in[w]; }
                }
             }
          }
       }
-
-      // QQQ_k1_k2_k3 *= quad_data_k1_k2_k3 -- scaling with quadrature values.
-      double *d = quad_data->rho0DetJ0w.GetData() + z*nqp;
-      for (int q = 0; q < nqp; q++) { qqq[q] *= d[q]; }
-
-      // QHQ_k1_i2_k3 = QQQ_k1_k2_k3 HQs_i2_k2 -- contract in y direction.
-      // The first step does some reordering (it's not product of matrices).
-      // HHQ_i1_i2_k3 = HQs_i1_k1 QHQ_k1_i2_k3 -- contract in x direction.
-      // Y_i1_i2_i3   = HHQ_i1_i2_k3 HQs_i3_k3 -- contract in z direction.
-      for (int k1 = 0; k1 < nqp1D; k1++)
+      // Y_i3_i2_i1 = HQs_i3_k3 QHH_k3_i2_i1 -- contract in z direction.
+      double *Y = X;
+      for (int i3 = 0; i3 < H; i3++)
       {
-         for (int i2 = 0; i2 < ndof1D; i2++)
+         for (int i21 = 0; i21 < H * H; i21++)
          {
-            for (int k3 = 0; k3 < nqp1D; k3++)
+            double *o = Y + (i3*H*H + i21) * W;
+            for (int w = 0; w < W; w++) { o[w] = 0.0; }
+            for (int k3 = 0; k3 < Q; k3++)
             {
-               Q_HQ(k1, i2 + ndof1D*k3) = 0.0;
-               for (int k2 = 0; k2 < nqp1D; k2++)
-               {
-                  Q_HQ(k1, i2 + ndof1D*k3) +=
-                     QQ_Q(k1 + nqp1D*k2, k3) * HQs(i2, k2);
-               }
+               const double s = B[i3 + H*k3], *in = QHH + (k3*H*H + i21) * W;
+               for (int w = 0; w < W; w++) { o[w] += s * in[w]; }
             }
          }
       }
-      mfem::Mult(HQs, Q_HQ, H_HQ);
-      MultABt(HH_Q, HQs, Y);
 
-      for (int j = 0; j < yz.Size(); j++)
+      for (int w = 0; w < nz_b; w++)
       {
-         y[dofs[dof_map[j]]] += yz[j];
+         dofs = e2d.GetRow(b * W + w);
+         for (int j = 0; j < ndof; j++) { y[dofs[dof_map[j]]] += Y[j*W + w]; }
+      }
+   }
+}
+
+void ChebyshevSolver::SetDiagonal(Vector &d)
+{
+   const Operator *P = FESpace.GetProlongationMatrix();
+   if (P == NULL) { inv_diag = d; }
+   else
+   {
+      inv_diag.SetSize(P->Width());
+      P->MultTranspose(d, inv_diag);
+   }
+   for (int i = 0; i < inv_diag.Size(); i++)
+   {
+      inv_diag(i) = 1.0 / inv_diag(i);
+   }
+   // The constrained operator is the identity on the essential dofs.
+   for (int i = 0; i < ess_tdofs.Size(); i++) { inv_diag(ess_tdofs[i]) = 1.0; }
+}
+
+double ChebyshevSolver::Dot(const Vector &x, const Vector &y) const
+{
+#ifdef MFEM_USE_MPI
+   ParFiniteElementSpace *pfes =
+      dynamic_cast<ParFiniteElementSpace *>(&FESpace);
+   if (pfes) { return InnerProduct(pfes->GetComm(), x, y); }
+#endif
+   return x * y;
+}
+
+void ChebyshevSolver::SetOperator(const Operator &op)
+{
+   oper = &op;
+   height = op.Height();
+   width  = op.Width();
+   if (lambda_max == 0.0) { EstimateEigenvalues(); }
+}
+
+void ChebyshevSolver::EstimateEigenvalues()
+{
+   const int n = oper->Height(), iter = 20;
+   Vector x(n), Ax(n), Dx(n);
+   res.SetSize(n); dir.SetSize(n); aux.SetSize(n);
+
+   // Power iterations for D^{-1} M, which is symmetric in the D-inner product.
+   // In the first pass x converges to the eigenvector of lambda_max; in the
+   // second, the iteration matrix is I - D^{-1} M / lambda_max, so x converges
+   // to the eigenvector of lambda_min. The essential dofs are excluded.
+   for (int pass = 0; pass < 2; pass++)
+   {
+      const double shift = (pass == 0) ? 0.0 : 1.0 / lambda_max;
+      x.Randomize(pass + 1);
+      x.SetSubVector(ess_tdofs, 0.0);
+      double lambda = 0.0;
+      for (int it = 0; it < iter; it++)
+      {
+         for (int i = 0; i < n; i++) { Dx(i) = x(i) / inv_diag(i); }
+         const double norm = sqrt(Dot(x, Dx));
+         x /= norm;
+         oper->Mult(x, Ax);
+         lambda = Dot(x, Ax);
+         for (int i = 0; i < n; i++)
+         {
+            x(i) = (pass == 0) ? inv_diag(i) * Ax(i)
+                   : x(i) - shift * inv_diag(i) * Ax(i);
+         }
+         x.SetSubVector(ess_tdofs, 0.0);
       }
+      if (pass == 0) { lambda_max = lambda; }
+      else           { lambda_min = lambda; }
+   }
+
+   // The polynomial stays positive below the interval, but not above it, so
+   // the upper bound is enlarged by a safety factor.
+   lambda_max *= 1.1;
+}
+
+void ChebyshevSolver::Mult(const Vector &x, Vector &y) const
+{
+   ProfileRegion region("Chebyshev");
+   // Chebyshev acceleration of Jacobi with zero initial guess, see Saad,
+   // "Iterative methods for sparse linear systems", Algorithm 12.1.
+   const int n = x.Size();
+   const double theta = 0.5 * (lambda_max + lambda_min),
+                delta = 0.5 * (lambda_max - lambda_min),
+                sigma = theta / delta;
+   double rho = 1.0 / sigma;
+
+   res = x;
+   for (int i = 0; i < n; i++) { dir(i) = inv_diag(i) * res(i) / theta; }
+   y = dir;
+   for (int k = 1; k < degree; k++)
+   {
+      oper->Mult(dir, aux);
+      res -= aux;
+      const double rho_new = 1.0 / (2.0 * sigma - rho);
+      for (int i = 0; i < n; i++)
+      {
+         dir(i) = rho_new * rho * dir(i) +
+                  2.0 * rho_new / delta * inv_diag(i) * res(i);
+      }
+      y += dir;
+      rho = rho_new;
    }
 }
 
@@ -1088,13 +2777,15 @@ void LocalMassPAOperator::Mult(const Vector &x, Vector &y) const
 // L2 mass matrix action on a single quadrilateral element in 2D.
 void LocalMassPAOperator::MultQuad(const Vector &x, Vector &y) const
 {
+   work.Reset();
    const DenseMatrix &LQs = tensors1D->LQshape1D;
 
    y.SetSize(x.Size());
    y = 0.0;
 
    const int ndof1D = LQs.Height(), nqp1D = LQs.Width();
-   DenseMatrix LQ(ndof1D, nqp1D), QQ(nqp1D, nqp1D);
+   DenseMatrix LQ(work.Reserve(ndof1D * nqp1D), ndof1D, nqp1D),
+               QQ(work.Reserve(nqp1D * nqp1D), nqp1D, nqp1D);
    DenseMatrix X(x.GetData(), ndof1D, ndof1D), Y(y.GetData(), ndof1D, ndof1D);
    double *qq = QQ.GetData();
    const int nqp = nqp1D * nqp1D;
@@ -1105,7 +2796,7 @@ void LocalMassPAOperator::MultQuad(const Vector &x, Vector &y) const
    MultAtB(LQs, LQ, QQ);
 
    // QQ_k1_k2 *= quad_data_k1_k2 -- scaling with quadrature values.
-   const double *d = quad_data->rho0DetJ0w.GetData() + zone_id*nqp;
+   const double *d = quad_data->GetRho0DetJ0w(zone_id, work.Reserve(nqp));
    for (int q = 0; q < nqp; q++) { qq[q] *= d[q]; }
 
    // LQ_i1_k2 = LQs_i1_k1 QQ_k1_k2 -- contract in x direction.
@@ -1117,16 +2808,18 @@ void LocalMassPAOperator::MultQuad(const Vector &x, Vector &y) const
 // L2 mass matrix action on a single hexahedral element in 3D.
 void LocalMassPAOperator::MultHex(const Vector &x, Vector &y) const
 {
+   work.Reset();
    const DenseMatrix &LQs = tensors1D->LQshape1D;
 
    y.SetSize(x.Size());
    y = 0.0;
 
    const int ndof1D = LQs.Height(), nqp1D = LQs.Width();
-   DenseMatrix LL_Q(ndof1D * ndof1D, nqp1D);
+   DenseMatrix LL_Q(work.Reserve(ndof1D * ndof1D * nqp1D),
+                    ndof1D * ndof1D, nqp1D);
    DenseMatrix L_LQ(LL_Q.GetData(), ndof1D, ndof1D*nqp1D);
-   DenseMatrix Q_LQ(nqp1D, ndof1D*nqp1D);
-   DenseMatrix QQ_Q(nqp1D*nqp1D, nqp1D);
+   DenseMatrix Q_LQ(work.Reserve(nqp1D * ndof1D * nqp1D), nqp1D, ndof1D*nqp1D);
+   DenseMatrix QQ_Q(work.Reserve(nqp1D * nqp1D * nqp1D), nqp1D*nqp1D, nqp1D);
    double *qqq = QQ_Q.GetData();
    DenseMatrix X(x.GetData(), ndof1D*ndof1D, ndof1D),
                Y(y.GetData(), ndof1D*ndof1D, ndof1D);
@@ -1155,7 +2848,7 @@ void LocalMassPAOperator::MultHex(const Vector &x, Vector &y) const
    }
 
    // QQQ_k1_k2_k3 *= quad_data_k1_k2_k3 -- scaling with quadrature values.
-   double *d = quad_data->rho0DetJ0w.GetData() + zone_id*nqp;
+   const double *d = quad_data->GetRho0DetJ0w(zone_id, work.Reserve(nqp));
    for (int q = 0; q < nqp; q++) { qqq[q] *= d[q]; }
 
    // QLQ_k1_i2_k3 = QQQ_k1_k2_k3 LQs_i2_k2 -- contract in y direction.
@@ -1181,6 +2874,543 @@ void LocalMassPAOperator::MultHex(const Vector &x, Vector &y) const
    MultABt(LL_Q, LQs, Y);
 }
 
+BatchedEnergyMassSolver::BatchedEnergyMassSolver(QuadratureData *quad_data_,
+                                                 FiniteElementSpace &fes,
+                                                 int W_, bool direct_)
+   : dim(fes.GetMesh()->Dimension()), nzones(fes.GetMesh()->GetNE()),
+     ndofs(fes.GetFE(0)->GetDof()),
+     nqp(quad_data_->nqp),
+     W(W_), direct(direct_), quad_data(quad_data_), L2FESpace(fes), Minv(),
+     Minv_sp()
+{
+   MFEM_VERIFY(W == 4 || W == 8, "Unsupported batch size: " << W);
+   const bool sp = quad_data->single_qdata;
+   thread_work.SetSize(GetNumThreads() * ThreadWorkSize());
+   if (!direct) { return; }
+
+   // The zone matrices are formed column by column from the PA action.
+   LocalMassPAOperator M_pa(quad_data, fes);
+   DenseMatrix M(ndofs), M_inv(ndofs);
+   Vector unit(ndofs), col;
+   if (sp) { Minv_sp.SetSize(W, nzones, ndofs, ndofs); }
+   else    { Minv.SetSize(W, nzones, ndofs, ndofs); }
+   for (int z = 0; z < nzones; z++)
+   {
+      M_pa.SetZoneId(z);
+      for (int j = 0; j < ndofs; j++)
+      {
+         unit = 0.0;
+         unit(j) = 1.0;
+         M_pa.Mult(unit, col);
+         for (int i = 0; i < ndofs; i++) { M(i, j) = col(i); }
+      }
+      DenseMatrixInverse inv(M);
+      inv.Factor();
+      inv.GetInverseMatrix(M_inv);
+      for (int j = 0; j < ndofs; j++)
+      {
+         for (int i = 0; i < ndofs; i++)
+         {
+            if (sp) { Minv_sp(z, i, j) = (float) M_inv(i, j); }
+            else    { Minv(z, i, j) = M_inv(i, j); }
+         }
+      }
+   }
+}
+
+int BatchedEnergyMassSolver::ThreadWorkSize() const
+{
+   // Right-hand side and solution of the batch, and in CG mode the quadrature
+   // data, the three CG vectors and the MassMult work array.
+   const int size = 2 * ndofs * W;
+   return direct ? size : size + nqp * W + 3 * ndofs * W + WorkSize();
+}
+
+int BatchedEnergyMassSolver::WorkSize() const
+{
+   const int nL1D = tensors1D->LQshape1D.Height(),
+             nQ1D = tensors1D->LQshape1D.Width();
+   // Three intermediate tensors of the 3D sum factorization (two in 2D).
+   return (nL1D*nL1D*nQ1D + nL1D*nQ1D*nQ1D + nQ1D*nQ1D*nQ1D) * W;
+}
+
+// Same as LocalMassPAOperator::MultQuad/MultHex, for W zones at once. All
+// arrays store the W zone values of each entry contiguously.
+template<int W_>
+void BatchedEnergyMassSolver::MassMult(const double *d, const double *x,
+                                       double *y, double *work) const
+{
+   const DenseMatrix &LQs = tensors1D->LQshape1D;
+   const int nL = LQs.Height(), nQ = LQs.Width();
+   const double *B = LQs.GetData();
+   double s[W_];
+
+   if (dim == 2)
+   {
+      double *LQ = work, *QQ = work + nL*nQ*W_;
+
+      // LQ_i1_k2 = X_i1_i2 LQs_i2_k2  -- contract in y direction.
+      for (int k2 = 0; k2 < nQ; k2++)
+      {
+         for (int i1 = 0; i1 < nL; i1++)
+         {
+            for (int w = 0; w < W_; w++) { s[w] = 0.0; }
+            for (int i2 = 0; i2 < nL; i2++)
+            {
+               const double b = B[i2 + nL*k2];
+               const double *xx = x + (i1 + nL*i2)*W_;
+               for (int w = 0; w < W_; w++) { s[w] += xx[w] * b; }
+            }
+            for (int w = 0; w < W_; w++) { LQ[(i1 + nL*k2)*W_ + w] = s[w]; }
+         }
+      }
+      // QQ_k1_k2 = LQs_i1_k1 LQ_i1_k2 quad_data_k1_k2 -- contract in x.
+      for (int k2 = 0; k2 < nQ; k2++)
+      {
+         for (int k1 = 0; k1 < nQ; k1++)
+         {
+            for (int w = 0; w < W_; w++) { s[w] = 0.0; }
+            for (int i1 = 0; i1 < nL; i1++)
+            {
+               const double b = B[i1 + nL*k1];
+               const double *lq = LQ + (i1 + nL*k2)*W_;
+               for (int w = 0; w < W_; w++) { s[w] += b * lq[w]; }
+            }
+            const int q = k1 + nQ*k2;
+            for (int w = 0; w < W_; w++)
+            {
+               QQ[q*W_ + w] = s[w] * d[q*W_ + w];
+            }
+         }
+      }
+      // LQ_i1_k2 = LQs_i1_k1 QQ_k1_k2 -- contract in x direction.
+      for (int k2 = 0; k2 < nQ; k2++)
+      {
+         for (int i1 = 0; i1 < nL; i1++)
+         {
+            for (int w = 0; w < W_; w++) { s[w] = 0.0; }
+            for (int k1 = 0; k1 < nQ; k1++)
+            {
+               const double b = B[i1 + nL*k1];
+               const double *qq = QQ + (k1 + nQ*k2)*W_;
+               for (int w = 0; w < W_; w++) { s[w] += b * qq[w]; }
+            }
+            for (int w = 0; w < W_; w++) { LQ[(i1 + nL*k2)*W_ + w] = s[w]; }
+         }
+      }
+      // Y_i1_i2 = LQ_i1_k2 LQs_i2_k2 -- contract in y direction.
+      for (int i2 = 0; i2 < nL; i2++)
+      {
+         for (int i1 = 0; i1 < nL; i1++)
+         {
+            for (int w = 0; w < W_; w++) { s[w] = 0.0; }
+            for (int k2 = 0; k2 < nQ; k2++)
+            {
+               const double b = B[i2 + nL*k2];
+               const double *lq = LQ + (i1 + nL*k2)*W_;
+               for (int w = 0; w < W_; w++) { s[w] += lq[w] * b; }
+            }
+            for (int w = 0; w < W_; w++) { y[(i1 + nL*i2)*W_ + w] = s[w]; }
+         }
+      }
+      return;
+   }
+
+   double *LLQ = work, *LQQ = LLQ + nL*nL*nQ*W_, *QQQ = LQQ + nL*nQ*nQ*W_;
+
+   // LLQ_i1_i2_k3 = X_i1_i2_i3 LQs_i3_k3     -- contract in z direction.
+   for (int k3 = 0; k3 < nQ; k3++)
+   {
+      for (int i12 = 0; i12 < nL*nL; i12++)
+      {
+         for (int w = 0; w < W_; w++) { s[w] = 0.0; }
+         for (int i3 = 0; i3 < nL; i3++)
+         {
+            const double b = B[i3 + nL*k3];
+            const double *xx = x + (i12 + nL*nL*i3)*W_;
+            for (int w = 0; w < W_; w++) { s[w] += xx[w] * b; }
+         }
+         for (int w = 0; w < W_; w++) { LLQ[(i12 + nL*nL*k3)*W_ + w] = s[w]; }
+      }
+   }
+   // LQQ_i1_k2_k3 = LLQ_i1_i2_k3 LQs_i2_k2   -- contract in y direction.
+   for (int k3 = 0; k3 < nQ; k3++)
+   {
+      for (int k2 = 0; k2 < nQ; k2++)
+      {
+         for (int i1 = 0; i1 < nL; i1++)
+         {
+            for (int w = 0; w < W_; w++) { s[w] = 0.0; }
+            for (int i2 = 0; i2 < nL; i2++)
+            {
+               const double b = B[i2 + nL*k2];
+               const double *llq = LLQ + (i1 + nL*i2 + nL*nL*k3)*W_;
+               for (int w = 0; w < W_; w++) { s[w] += llq[w] * b; }
+            }
+            const int j = i1 + nL*k2 + nL*nQ*k3;
+            for (int w = 0; w < W_; w++) { LQQ[j*W_ + w] = s[w]; }
+         }
+      }
+   }
+   // QQQ_k1_k2_k3 = LQs_i1_k1 LQQ_i1_k2_k3 quad_data_k1_k2_k3 -- contract in x.
+   for (int k23 = 0; k23 < nQ*nQ; k23++)
+   {
+      for (int k1 = 0; k1 < nQ; k1++)
+      {
+         for (int w = 0; w < W_; w++) { s[w] = 0.0; }
+         for (int i1 = 0; i1 < nL; i1++)
+         {
+            const double b = B[i1 + nL*k1];
+            const double *lqq = LQQ + (i1 + nL*k23)*W_;
+            for (int w = 0; w < W_; w++) { s[w] += b * lqq[w]; }
+         }
+         const int q = k1 + nQ*k23;
+         for (int w = 0; w < W_; w++) { QQQ[q*W_ + w] = s[w] * d[q*W_ + w]; }
+      }
+   }
+   // LQQ_i1_k2_k3 = LQs_i1_k1 QQQ_k1_k2_k3   -- contract in x direction.
+   for (int k23 = 0; k23 < nQ*nQ; k23++)
+   {
+      for (int i1 = 0; i1 < nL; i1++)
+      {
+         for (int w = 0; w < W_; w++) { s[w] = 0.0; }
+         for (int k1 = 0; k1 < nQ; k1++)
+         {
+            const double b = B[i1 + nL*k1];
+            const double *qqq = QQQ + (k1 + nQ*k23)*W_;
+            for (int w = 0; w < W_; w++) { s[w] += b * qqq[w]; }
+         }
+         for (int w = 0; w < W_; w++) { LQQ[(i1 + nL*k23)*W_ + w] = s[w]; }
+      }
+   }
+   // LLQ_i1_i2_k3 = LQQ_i1_k2_k3 LQs_i2_k2   -- contract in y direction.
+   for (int k3 = 0; k3 < nQ; k3++)
+   {
+      for (int i2 = 0; i2 < nL; i2++)
+      {
+         for (int i1 = 0; i1 < nL; i1++)
+         {
+            for (int w = 0; w < W_; w++) { s[w] = 0.0; }
+            for (int k2 = 0; k2 < nQ; k2++)
+            {
+               const double b = B[i2 + nL*k2];
+               const double *lqq = LQQ + (i1 + nL*k2 + nL*nQ*k3)*W_;
+               for (int w = 0; w < W_; w++) { s[w] += lqq[w] * b; }
+            }
+            const int j = i1 + nL*i2 + nL*nL*k3;
+            for (int w = 0; w < W_; w++) { LLQ[j*W_ + w] = s[w]; }
+         }
+      }
+   }
+   // Y_i1_i2_i3 = LLQ_i1_i2_k3 LQs_i3_k3     -- contract in z direction.
+   for (int i3 = 0; i3 < nL; i3++)
+   {
+      for (int i12 = 0; i12 < nL*nL; i12++)
+      {
+         for (int w = 0; w < W_; w++) { s[w] = 0.0; }
+         for (int k3 = 0; k3 < nQ; k3++)
+         {
+            const double b = B[i3 + nL*k3];
+            const double *llq = LLQ + (i12 + nL*nL*k3)*W_;
+            for (int w = 0; w < W_; w++) { s[w] += llq[w] * b; }
+         }
+         for (int w = 0; w < W_; w++) { y[(i12 + nL*nL*i3)*W_ + w] = s[w]; }
+      }
+   }
+}
+
+template<int W_, typename T>
+void BatchedEnergyMassSolver::DirectSolve(const T *M_all, int zb,
+                                          const double *b, double *x) const
+{
+   const T *M = M_all + zb*ndofs*ndofs*W_;
+   for (int i = 0; i < ndofs; i++)
+   {
+      double s[W_];
+      for (int w = 0; w < W_; w++) { s[w] = 0.0; }
+      for (int j = 0; j < ndofs; j++)
+      {
+         const T *m = M + (i*ndofs + j)*W_;
+         const double *bb = b + j*W_;
+         for (int w = 0; w < W_; w++) { s[w] += m[w] * bb[w]; }
+      }
+      for (int w = 0; w < W_; w++) { x[i*W_ + w] = s[w]; }
+   }
+}
+
+// Unpreconditioned CG with the parameters of the local CG solves in
+// LagrangianHydroOperator. Each zone stops updating when it has converged.
+// Returns the sum of the iteration counts of the W zones.
+template<int W_>
+int BatchedEnergyMassSolver::CGSolve(const double *d, const double *b,
+                                     double *x, double *work) const
+{
+   const double rel_tol = 1e-8;
+   const double abs_tol = 1e-8 * numeric_limits<double>::epsilon();
+   const int max_iter = 200, n = ndofs * W_;
+   double *r = work, *p = r + n, *Ap = p + n, *mass_work = Ap + n;
+   double nom[W_], r0[W_], den[W_], alpha[W_], beta[W_];
+
+   for (int k = 0; k < n; k++) { x[k] = 0.0; r[k] = p[k] = b[k]; }
+   for (int w = 0; w < W_; w++) { nom[w] = 0.0; }
+   for (int i = 0; i < ndofs; i++)
+   {
+      for (int w = 0; w < W_; w++) { nom[w] += r[i*W_ + w] * r[i*W_ + w]; }
+   }
+   for (int w = 0; w < W_; w++)
+   {
+      r0[w] = max(nom[w] * rel_tol * rel_tol, abs_tol * abs_tol);
+   }
+
+   int zone_iter = 0;
+   for (int it = 0; it < max_iter; it++)
+   {
+      bool active = false;
+      for (int w = 0; w < W_; w++) { active = active || (nom[w] > r0[w]); }
+      if (!active) { break; }
+
+      MassMult<W_>(d, p, Ap, mass_work);
+      for (int w = 0; w < W_; w++) { den[w] = 0.0; }
+      for (int i = 0; i < ndofs; i++)
+      {
+         for (int w = 0; w < W_; w++) { den[w] += p[i*W_ + w] * Ap[i*W_ + w]; }
+      }
+      for (int w = 0; w < W_; w++)
+      {
+         alpha[w] = (nom[w] > r0[w]) ? nom[w] / den[w] : 0.0;
+      }
+      for (int w = 0; w < W_; w++) { beta[w] = 0.0; }
+      for (int i = 0; i < ndofs; i++)
+      {
+         for (int w = 0; w < W_; w++)
+         {
+            x[i*W_ + w] += alpha[w] * p[i*W_ + w];
+            r[i*W_ + w] -= alpha[w] * Ap[i*W_ + w];
+            beta[w] += r[i*W_ + w] * r[i*W_ + w];
+         }
+      }
+      for (int w = 0; w < W_; w++)
+      {
+         if (nom[w] > r0[w])
+         {
+            const double nom_new = beta[w];
+            beta[w] = nom_new / nom[w];
+            nom[w] = nom_new;
+            zone_iter++;
+         }
+         else { beta[w] = 0.0; }
+      }
+      for (int i = 0; i < ndofs; i++)
+      {
+         for (int w = 0; w < W_; w++)
+         {
+            p[i*W_ + w] = r[i*W_ + w] + beta[w] * p[i*W_ + w];
+         }
+      }
+   }
+   return zone_iter;
+}
+
+template<int W_>
+int BatchedEnergyMassSolver::MultBatches(const Vector &b, Vector &x) const
+{
+   const int nbatches = (nzones + W_ - 1) / W_;
+   int dof_iter = 0;
+   const Table &e2d = L2FESpace.GetElementToDofTable();
+   #pragma omp parallel num_threads(GetNumThreads()) reduction(+:dof_iter)
+   {
+      double *tw = thread_work.GetData() + GetThreadId() * ThreadWorkSize();
+      Vector b_zb(tw, ndofs * W_), x_zb(tw + ndofs * W_, ndofs * W_), d_zb,
+             work;
+      if (!direct)
+      {
+         d_zb.SetDataAndSize(tw + 2 * ndofs * W_, nqp * W_);
+         work.SetDataAndSize(tw + (2 * ndofs + nqp) * W_,
+                             3 * ndofs * W_ + WorkSize());
+      }
+      #pragma omp for schedule(static)
+      for (int zb = 0; zb < nbatches; zb++)
+      {
+         const int nz = min(W_, nzones - zb * W_);
+
+         // Gather the batch. The unused zones of the last batch get zero
+         // right-hand sides, so their CG solves stop immediately.
+         b_zb = 0.0;
+         for (int w = 0; w < nz; w++)
+         {
+            const int *dofs = e2d.GetRow(zb*W_ + w);
+            for (int i = 0; i < ndofs; i++) { b_zb(i*W_ + w) = b(dofs[i]); }
+         }
+
+         if (direct)
+         {
+            if (quad_data->single_qdata)
+            {
+               DirectSolve<W_>(Minv_sp.GetData(), zb, b_zb.GetData(),
+                               x_zb.GetData());
+            }
+            else
+            {
+               DirectSolve<W_>(Minv.GetData(), zb, b_zb.GetData(),
+                               x_zb.GetData());
+            }
+            dof_iter += nz * ndofs;
+         }
+         else
+         {
+            if (quad_data->single_qdata && quad_data->simd_width == W_)
+            {
+               // Already interleaved with the batch width.
+               const float *d_sp = quad_data->rho0DetJ0w_zf.GetData() +
+                                   zb*nqp*W_;
+               for (int k = 0; k < nqp*W_; k++) { d_zb(k) = d_sp[k]; }
+            }
+            else if (quad_data->single_qdata)
+            {
+               d_zb = 1.0;
+               for (int w = 0; w < nz; w++)
+               {
+                  for (int q = 0; q < nqp; q++)
+                  {
+                     d_zb(q*W_ + w) = quad_data->rho0DetJ0w_zf(zb*W_ + w, 0, q);
+                  }
+               }
+            }
+            else
+            {
+               const double *rho0DetJ0w = quad_data->rho0DetJ0w.GetData();
+               d_zb = 1.0;
+               for (int w = 0; w < nz; w++)
+               {
+                  const double *d_z = rho0DetJ0w + (zb*W_ + w)*nqp;
+                  for (int q = 0; q < nqp; q++) { d_zb(q*W_ + w) = d_z[q]; }
+               }
+            }
+            const int iter = CGSolve<W_>(d_zb.GetData(), b_zb.GetData(),
+                                         x_zb.GetData(), work.GetData());
+            dof_iter += iter * ndofs;
+         }
+
+         for (int w = 0; w < nz; w++)
+         {
+            const int *dofs = e2d.GetRow(zb*W_ + w);
+            for (int i = 0; i < ndofs; i++) { x(dofs[i]) = x_zb(i*W_ + w); }
+         }
+      }
+   }
+   return dof_iter;
+}
+
+int BatchedEnergyMassSolver::Mult(const Vector &b, Vector &x) const
+{
+   switch (W)
+   {
+      case 4: return MultBatches<4>(b, x);
+      case 8: return MultBatches<8>(b, x);
+      default: MFEM_ABORT("Unsupported batch size: " << W);
+   }
+   return 0;
+}
+
+// Operations of the dim successive 1D contractions that take n1^dim values to
+// n2^dim values.
+static double ContractionFlops(int dim, int n1, int n2)
+{
+   double flops = 0.0;
+   for (int k = 1; k <= dim; k++)
+   {
+      flops += 2.0 * pow(n1, dim - k + 1) * pow(n2, k);
+   }
+   return flops;
+}
+
+KernelCost ForcePACost(int dim, int h1dofs1D, int l2dofs1D, int nqp1D,
+                       bool transpose, int qbytes)
+{
+   const double nH1 = pow(h1dofs1D, dim), nL2 = pow(l2dofs1D, dim),
+                nqp = pow(nqp1D, dim);
+   // Mult: L2 values at the points, then for each (component, derivative)
+   // pair, the stress scaling, the contractions back to the H1 dofs and the
+   // accumulation. MultTranspose: the gradients of each component at the
+   // points, the stress scaling and sum, then the contractions to the L2 dofs.
+   double flops;
+   if (!transpose)
+   {
+      flops = ContractionFlops(dim, l2dofs1D, nqp1D) +
+              dim * dim * (nqp + ContractionFlops(dim, nqp1D, h1dofs1D) + nH1);
+   }
+   else
+   {
+      flops = dim * dim * (ContractionFlops(dim, h1dofs1D, nqp1D) + 2 * nqp) +
+              ContractionFlops(dim, nqp1D, l2dofs1D);
+   }
+   // The L2 values are read or written once. The H1 values are read (and in
+   // Mult also written back). Each dof has a 4-byte index. The stress has
+   // dim*dim components.
+   const double h1_access = transpose ? 1.0 : 2.0;
+   const double bytes = 12.0 * nL2 + (8.0 * h1_access * dim + 4.0) * nH1 +
+                        qbytes * dim * dim * nqp;
+   return KernelCost(flops, bytes);
+}
+
+KernelCost MassPACost(int dim, int dofs1D, int nqp1D, int qbytes)
+{
+   const double ndofs = pow(dofs1D, dim), nqp = pow(nqp1D, dim);
+   // For each component: contractions to the points, scaling, contractions
+   // back to the dofs and accumulation. The indices are read per component.
+   const double flops = dim * (2 * ContractionFlops(dim, dofs1D, nqp1D) +
+                               nqp + ndofs);
+   const double bytes = dim * (qbytes * nqp + 3 * 8.0 * ndofs + 4.0 * ndofs);
+   return KernelCost(flops, bytes);
+}
+
+KernelCost LocalMassPACost(int dim, int dofs1D, int nqp1D)
+{
+   const double ndofs = pow(dofs1D, dim), nqp = pow(nqp1D, dim);
+   const double flops = 2 * ContractionFlops(dim, dofs1D, nqp1D) + nqp;
+   return KernelCost(flops, 8.0 * (2 * ndofs + nqp));
+}
+
+KernelCost L2ValuesCost(int dim, int l2dofs1D, int nqp1D)
+{
+   const double ndofs = pow(l2dofs1D, dim), nqp = pow(nqp1D, dim);
+   return KernelCost(ContractionFlops(dim, l2dofs1D, nqp1D),
+                     8.0 * (ndofs + nqp));
+}
+
+KernelCost VectorGradCost(int dim, int h1dofs1D, int nqp1D)
+{
+   const double ndofs = pow(h1dofs1D, dim), nqp = pow(nqp1D, dim);
+   return KernelCost(dim * dim * ContractionFlops(dim, h1dofs1D, nqp1D),
+                     8.0 * (dim * ndofs + dim * dim * nqp));
+}
+
+KernelCost QuadratureUpdateCost(int dim, int h1dofs1D, int l2dofs1D,
+                                int nqp1D, int qbytes, bool jac0)
+{
+   const double nH1 = pow(h1dofs1D, dim), nL2 = pow(l2dofs1D, dim),
+                nqp = pow(nqp1D, dim), d2 = dim * dim, d3 = d2 * dim;
+   // Energy values, Jacobians of x and v, then at each point: inverse and
+   // determinant, velocity gradient, Jac0inv product, eigenvalues, singular
+   // value, viscosity, time step estimate and stress.
+   KernelCost cost = L2ValuesCost(dim, l2dofs1D, nqp1D);
+   cost += VectorGradCost(dim, h1dofs1D, nqp1D) * 2;
+   cost.flops += nqp * (8.0 * d3 + 44.0 * d2 + 40.0);
+   // The traffic of the dof values and indices of e, x and v, and of the
+   // point data: Jac0inv and rho0DetJ0w read, the stress written.
+   cost.bytes = 12.0 * nL2 + 2 * (8.0 * dim + 4.0) * nH1 +
+                (8.0 * (d2 + 1) + qbytes * d2) * nqp;
+   if (!jac0)
+   {
+      // The gradient of the initial positions and the inverse at each point
+      // replace the Jac0inv traffic.
+      cost.flops += dim * dim * ContractionFlops(dim, h1dofs1D, nqp1D) +
+                    nqp * 8.0 * d2;
+      cost.bytes += (8.0 * dim + 4.0) * nH1 - 8.0 * d2 * nqp;
+   }
+   return cost;
+}
+
 } // namespace hydrodynamics
 
 } // namespace mfem
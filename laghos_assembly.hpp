@@ -18,6 +18,26 @@
 #define MFEM_LAGHOS_ASSEMBLY
 
 #include "mfem.hpp"
+#include "laghos_profiler.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// The zone loops are threaded only when LAGHOS_OPENMP is defined (make
+// LAGHOS_OPENMP=YES), not whenever the compiler flags enable OpenMP, e.g.,
+// through the options of an MFEM built with MFEM_USE_OPENMP=YES. The threaded
+// loops call methods of the shared FiniteElement and ElementTransformation
+// objects, e.g., CalcShape and Jacobian, which write to mutable member scratch
+// data unless MFEM is built with MFEM_THREAD_SAFE.
+#ifdef LAGHOS_OPENMP
+#ifndef _OPENMP
+#error "LAGHOS_OPENMP needs a compiler with OpenMP enabled."
+#endif
+#ifndef MFEM_THREAD_SAFE
+#error "LAGHOS_OPENMP=YES needs MFEM built with MFEM_THREAD_SAFE=YES."
+#endif
+#endif
 
 namespace mfem
 {
@@ -25,11 +45,97 @@ namespace mfem
 namespace hydrodynamics
 {
 
+// Number of threads used by the threaded zone loops (1 without LAGHOS_OPENMP).
+// The zone loops pass it to their parallel regions through num_threads.
+inline int GetNumThreads()
+{
+#ifdef LAGHOS_OPENMP
+   return omp_get_max_threads();
+#else
+   return 1;
+#endif
+}
+
+// Id of the calling thread within a threaded zone loop (0 without
+// LAGHOS_OPENMP).
+inline int GetThreadId()
+{
+#ifdef LAGHOS_OPENMP
+   return omp_get_thread_num();
+#else
+   return 0;
+#endif
+}
+
+// Number of calls to operator new so far. Only counted in debug builds
+// (LAGHOS_DEBUG), otherwise returns -1.
+long GetHeapAllocationCount();
+
+// Scratch memory that is allocated once and then handed out in consecutive
+// pieces, which are not initialized. Reset() releases all pieces at once, so
+// the kernels that take their temporaries from an arena do not touch the heap.
+class WorkspaceArena
+{
+private:
+   Vector storage;
+   int offset;
+
+public:
+   WorkspaceArena() : storage(), offset(0) { }
+
+   void SetSize(int size) { storage.SetSize(size); offset = 0; }
+
+   void Reset() { offset = 0; }
+
+   double *Reserve(int size)
+   {
+      MFEM_VERIFY(offset + size <= storage.Size(), "Workspace too small.");
+      double *ptr = storage.GetData() + offset;
+      offset += size;
+      return ptr;
+   }
+};
+
+// Values at all quadrature points of all zones, for several components, with
+// the zones interleaved in blocks of W. For each block, component and
+// quadrature point, the values of the W zones of the block are contiguous,
+// which lets the partial assembly kernels process W zones per SIMD instruction.
+// The number of zones is padded to a multiple of W with zero values, and the
+// data is aligned to 64 bytes. The values are stored as T, which is double, or
+// float in the mixed precision mode.
+template <typename T>
+class ZoneInterleavedArray
+{
+private:
+   Array<T> storage;
+   T *data;
+   int W, nzones, ncomp, nqp;
+
+public:
+   ZoneInterleavedArray()
+      : storage(), data(NULL), W(0), nzones(0), ncomp(0), nqp(0) { }
+
+   void SetSize(int W_, int nzones, int ncomp_, int nqp_);
+
+   T *GetData() const { return data; }
+   int NumZones() const { return nzones; }
+   long MemoryUsage() const { return storage.Size() * (long) sizeof(T); }
+
+   // Value of component c at quadrature point q of zone z.
+   T &operator()(int z, int c, int q) const
+   { return data[((z / W * ncomp + c) * nqp + q) * W + z % W]; }
+};
+typedef ZoneInterleavedArray<double> ZoneInterleavedData;
+typedef ZoneInterleavedArray<float> ZoneInterleavedFloatData;
+
 // Container for all data needed at quadrature points.
 struct QuadratureData
 {
    // TODO: use QuadratureFunctions?
 
+   // Dimension, number of zones and number of quadrature points per zone.
+   const int dim, nzones, nqp;
+
    // Reference to physical Jacobian for the initial mesh. These are computed
    // only at time zero and stored here.
    DenseTensor Jac0inv;
@@ -55,12 +161,69 @@ struct QuadratureData
    // recomputed at every time step to achieve adaptive time stepping.
    double dt_est;
 
-   QuadratureData(int dim, int nzones, int quads_per_zone)
-      : Jac0inv(dim, dim, nzones * quads_per_zone),
-        stressJinvT(nzones * quads_per_zone, dim, dim),
-        rho0DetJ0w(nzones * quads_per_zone) { }
+   // Extrema of the density, the pressure and the Jacobian determinant over
+   // the quadrature points of this rank, from the last update.
+   double rho_min, rho_max, p_min, p_max, detJ_min;
+
+   // Zone-interleaved versions of stressJinvT (component vd*dim + gd),
+   // rho0DetJ0w and Jac0inv (component i*dim + j), used by the partial
+   // assembly kernels and the quadrature data update when simd_width > 0. In
+   // that case stressJinvT and Jac0inv are not allocated, so the full assembly
+   // path (ForceIntegrator) always works with the standard layout.
+   int simd_width;
+   ZoneInterleavedData stressJinvT_zi, rho0DetJ0w_zi, Jac0inv_zi;
+
+   // Mixed precision mode: single precision versions of the zone-interleaved
+   // data, which replace the double versions; rho0DetJ0w is then not stored
+   // either. The kernels promote the values to double. With simd_width 1, the
+   // zone-interleaved layout is the standard zone order.
+   bool single_qdata;
+   ZoneInterleavedFloatData stressJinvT_zf, rho0DetJ0w_zf, Jac0inv_zf;
+
+   // Max relative rounding error of rho0DetJ0w_zf.
+   double rho0DetJ0w_rounding;
+
+   QuadratureData(int dim_, int nzones_, int quads_per_zone)
+      : dim(dim_), nzones(nzones_), nqp(quads_per_zone),
+        Jac0inv(dim, dim, nzones * nqp), stressJinvT(nzones * nqp, dim, dim),
+        rho0DetJ0w(nzones * nqp), rho_min(0.0), rho_max(0.0), p_min(0.0),
+        p_max(0.0), detJ_min(0.0), simd_width(0), single_qdata(false),
+        rho0DetJ0w_rounding(0.0) { }
+
+   // Switches the partial assembly data to the zone-interleaved layout with
+   // blocks of W zones. The current values of rho0DetJ0w and Jac0inv are
+   // copied; Jac0inv is released, or left empty if it is not stored.
+   void SetZoneInterleaved(int W);
+
+   // Switches the zone-interleaved data to single precision, see above.
+   void SetSinglePrecision();
+
+   // Values of rho0DetJ0w in zone z: a pointer into rho0DetJ0w, or, when only
+   // rho0DetJ0w_zf is stored, buf with the values promoted to double.
+   double *GetRho0DetJ0w(int z, double *buf) const;
+
+   // Sum of rho0DetJ0w, the mass of the zones.
+   double SumRho0DetJ0w() const;
+
+   // Copies of rho0DetJ0w and Jac0inv in the standard layout, from and to the
+   // versions in use. Used by the checkpoints, which do not depend on the
+   // layout and the precision. Jac0inv is empty when it is not stored.
+   void GetRho0DetJ0w(Vector &r) const;
+   void SetRho0DetJ0w(const Vector &r);
+   void GetJac0inv(DenseTensor &J) const;
+   void SetJac0inv(const DenseTensor &J);
+
+   // Adds the sizes of Jac0inv, stressJinvT and rho0DetJ0w, each with its
+   // zone-interleaved versions, to mem.
+   void AddMemoryUsage(MemoryReport &mem) const;
 };
 
+// Arena size for the sum factorization kernels below: 16 arrays of n1D^dim
+// values per zone of a block of W zones, where n1D is the largest of the 1D
+// numbers of dofs (order + 1) and quadrature points.
+int KernelWorkspaceSize(const QuadratureData &quad_data, int dim, int nzones,
+                        int max_order, int W = 1);
+
 // Stores values of the one-dimensional shape functions and gradients at all 1D
 // quadrature points. All sizes are (dofs1D_cnt x quads1D_cnt).
 struct Tensors1D
@@ -77,14 +240,18 @@ class FastEvaluator
    const int dim;
    FiniteElementSpace &H1FESpace;
 
+   // One arena per thread, as the evaluator is used in threaded zone loops.
+   Array<WorkspaceArena *> work;
+
 public:
-   FastEvaluator(FiniteElementSpace &h1fes)
-      : dim(h1fes.GetMesh()->Dimension()), H1FESpace(h1fes) { }
+   FastEvaluator(FiniteElementSpace &h1fes);
 
    void GetL2Values(const Vector &vecL2, Vector &vecQP) const;
    // The input vec is an H1 function with dim components, over a zone.
    // The output is J_ij = d(vec_i) / d(x_j) with ij = 1 .. dim.
    void GetVectorGrad(const DenseMatrix &vec, DenseTensor &J) const;
+
+   ~FastEvaluator();
 };
 extern const FastEvaluator *evaluator;
 
@@ -130,6 +297,9 @@ private:
    QuadratureData *quad_data;
    FiniteElementSpace &H1FESpace, &L2FESpace;
 
+   // Temporaries of the generic kernels below.
+   mutable WorkspaceArena work;
+
    // Force matrix action on quadrilateral elements in 2D.
    void MultQuad(const Vector &vecL2, Vector &vecH1) const;
    // Force matrix action on hexahedral elements in 3D.
@@ -140,15 +310,108 @@ private:
    // Transpose force matrix action on hexahedral elements in 3D.
    void MultTransposeHex(const Vector &vecH1, Vector &vecL2) const;
 
+   // Versions of the above with all 1D sizes known at compile time: H1D and
+   // L2D are the numbers of H1 and L2 dofs in 1D, Q1D the number of quadrature
+   // points in 1D. They use fixed-size local arrays and sum factorization. The
+   // zones [z_begin, z_end) are processed in blocks of W, where W is either the
+   // width of the zone-interleaved layout, or 1 for the standard layout. The
+   // value of stress component c (= vd*dim + gd) at point q of the w-th zone in
+   // block b is stress[b*bstride + c*cstride + q*W + w]. The stress values
+   // are of type T (double, or float in the mixed precision mode), and are
+   // promoted to double. The H1 results are added to vecH1, while the L2
+   // results overwrite the entries of the zones.
+   template<int H1D, int L2D, int Q1D, int W, typename T>
+   void MultQuadFixed(const T *stress, int bstride, int cstride,
+                      int z_begin, int z_end,
+                      const Vector &vecL2, Vector &vecH1) const;
+   template<int H1D, int L2D, int Q1D, int W, typename T>
+   void MultHexFixed(const T *stress, int bstride, int cstride,
+                     int z_begin, int z_end,
+                     const Vector &vecL2, Vector &vecH1) const;
+   template<int H1D, int L2D, int Q1D, int W, typename T>
+   void MultTransposeQuadFixed(const T *stress, int bstride, int cstride,
+                               int z_begin, int z_end,
+                               const Vector &vecH1, Vector &vecL2) const;
+   template<int H1D, int L2D, int Q1D, int W, typename T>
+   void MultTransposeHexFixed(const T *stress, int bstride, int cstride,
+                              int z_begin, int z_end,
+                              const Vector &vecH1, Vector &vecL2) const;
+
+   // Number of quadrature points in a zone.
+   int GetNQP() const;
+
+   // Returns the stored stressJinvT data and its strides, see above, for the
+   // double or float (mixed precision) version.
+   void GetStressData(const double *&stress, int &bstride, int &cstride) const;
+   void GetStressData(const float *&stress, int &bstride, int &cstride) const;
+
+   // Pointer to a fixed-size kernel for stress values of type T.
+   template<typename T> struct KernelPtr
+   {
+      typedef void (ForcePAOperator::*Type)(const T *, int, int, int, int,
+                                            const Vector &, Vector &) const;
+   };
+   typedef KernelPtr<double>::Type Kernel;
+
+   // Fixed-size kernel for the current dimension and the given layout width.
+   template<int H1D, int L2D, int Q1D, typename T>
+   typename KernelPtr<T>::Type MultKernel(int W) const;
+   template<int H1D, int L2D, int Q1D, typename T>
+   typename KernelPtr<T>::Type MultTransposeKernel(int W) const;
+
+   // Return the fixed-size kernel for the current dimension, orders and data
+   // layout, or NULL when the combination is not instantiated.
+   template<typename T> typename KernelPtr<T>::Type GetMultKernel() const;
+   template<typename T>
+   typename KernelPtr<T>::Type GetMultTransposeKernel() const;
+
+   // Apply the kernels to the stored stress data of type T, in all zones when
+   // zones is NULL, and otherwise in the ranges of MultZoneRanges.
+   template<typename T> bool MultStored(const Array<int> *zones,
+                                        const Vector &vecL2,
+                                        Vector &vecH1) const;
+   template<typename T> bool MultTransposeStored(const Array<int> *zones,
+                                                 const Vector &vecH1,
+                                                 Vector &vecL2) const;
+
 public:
    ForcePAOperator(QuadratureData *quad_data_,
                    FiniteElementSpace &h1fes, FiniteElementSpace &l2fes)
       : dim(h1fes.GetMesh()->Dimension()), nzones(h1fes.GetMesh()->GetNE()),
-        quad_data(quad_data_), H1FESpace(h1fes), L2FESpace(l2fes) { }
+        quad_data(quad_data_), H1FESpace(h1fes), L2FESpace(l2fes)
+   {
+      work.SetSize(KernelWorkspaceSize(*quad_data, dim, nzones,
+                                       h1fes.GetFE(0)->GetOrder()));
+   }
 
    virtual void Mult(const Vector &vecL2, Vector &vecH1) const;
    virtual void MultTranspose(const Vector &vecH1, Vector &vecL2) const;
 
+   // True when the current orders have fixed-size kernels. These are the only
+   // ones that support the zone-interleaved data layout.
+   bool HasFixedKernels() const;
+
+   // Force actions restricted to the zones [z_begin, z_end), used by the fused
+   // stress and force computation. The stress values of these zones are given
+   // in the layout of ZoneInterleavedData (blocks of one zone for the standard
+   // layout), starting with zone z_begin, which must begin a block. MultZones
+   // adds to vecH1; MultTransposeZones sets the entries of the zones in vecL2.
+   void MultZones(const double *stress, int z_begin, int z_end,
+                  const Vector &vecL2, Vector &vecH1) const;
+   void MultTransposeZones(const double *stress, int z_begin, int z_end,
+                           const Vector &vecH1, Vector &vecL2) const;
+
+   // Force actions with the stored stress, restricted to the zone ranges
+   // [zones[2i], zones[2i+1]), each of which starts a block of the layout.
+   // Mult sets vecH1 to the sum over these zones; MultTranspose sets their
+   // entries in vecL2. Without fixed-size kernels all zones are computed, so
+   // then vecL2 must vanish outside the ranges in Mult, and MultTranspose
+   // also sets the other entries of vecL2.
+   void MultZoneRanges(const Array<int> &zones,
+                       const Vector &vecL2, Vector &vecH1) const;
+   void MultTransposeZoneRanges(const Array<int> &zones,
+                                const Vector &vecH1, Vector &vecL2) const;
+
    ~ForcePAOperator() { }
 };
 
@@ -161,20 +424,41 @@ private:
    QuadratureData *quad_data;
    FiniteElementSpace &FESpace;
 
+   // Temporaries of the kernels below.
+   mutable WorkspaceArena work;
+
    // Mass matrix action on quadrilateral elements in 2D.
    void MultQuad(const Vector &x, Vector &y) const;
    // Mass matrix action on hexahedral elements in 3D.
    void MultHex(const Vector &x, Vector &y) const;
 
+   // Versions of the above for the zone-interleaved layout of width W. The
+   // values of rho0DetJ0w are given in the interleaved layout, as double or
+   // float (mixed precision).
+   template<int W, typename T>
+   void MultQuadZI(const T *rho0DetJ0w, const Vector &x, Vector &y) const;
+   template<int W, typename T>
+   void MultHexZI(const T *rho0DetJ0w, const Vector &x, Vector &y) const;
+   template<int W> void MultZI(const Vector &x, Vector &y) const;
+
 public:
    MassPAOperator(QuadratureData *quad_data_, FiniteElementSpace &fes)
       : Operator(fes.GetVSize()),
         dim(fes.GetMesh()->Dimension()), nzones(fes.GetMesh()->GetNE()),
         quad_data(quad_data_), FESpace(fes)
-   { }
+   {
+      // The zone-interleaved kernels use up to 4 arrays per zone, for blocks
+      // of up to 8 zones.
+      work.SetSize(KernelWorkspaceSize(*quad_data, dim, nzones,
+                                       fes.GetFE(0)->GetOrder(), 2));
+   }
 
    // Mass matrix action.
    virtual void Mult(const Vector &x, Vector &y) const;
+   // Same as Mult, but always with the standard layout kernels. Used for the
+   // kinetic energy, which then does not depend on the layout. In the mixed
+   // precision mode, these kernels read rho0DetJ0w_zf promoted to double.
+   void MultStandard(const Vector &x, Vector &y) const;
 
    void ComputeDiagonal2D(Vector &diag) const;
    void ComputeDiagonal3D(Vector &diag) const;
@@ -214,6 +498,42 @@ public:
    virtual void SetOperator(const Operator &op) { }
 };
 
+// Chebyshev polynomial preconditioner of a given degree for the (constrained)
+// MassPAOperator. It accelerates the Jacobi iteration with the diagonal of the
+// MassPAOperator and uses only operator actions, so it adds no global
+// reductions to the outer CG. The bounds of the spectrum of D^{-1} M are
+// estimated with power iterations the first time an operator is set; the
+// velocity mass matrix is constant in time, so they are never recomputed.
+class ChebyshevSolver : public Solver
+{
+private:
+   const int degree;
+   FiniteElementSpace &FESpace;
+   const Array<int> &ess_tdofs;
+   const Operator *oper;
+   Vector inv_diag;
+   double lambda_min, lambda_max;
+   mutable Vector res, dir, aux;
+
+   // Global inner product (over all tasks in the parallel version).
+   double Dot(const Vector &x, const Vector &y) const;
+   void EstimateEigenvalues();
+
+public:
+   ChebyshevSolver(FiniteElementSpace &fes, const Array<int> &ess, int deg)
+      : Solver(fes.GetVSize()), degree(deg), FESpace(fes), ess_tdofs(ess),
+        oper(NULL), inv_diag(), lambda_min(0.0), lambda_max(0.0) { }
+
+   // Same input as DiagonalSolver::SetDiagonal.
+   void SetDiagonal(Vector &d);
+
+   virtual void SetOperator(const Operator &op);
+   virtual void Mult(const Vector &x, Vector &y) const;
+
+   double GetMinEigenvalue() const { return lambda_min; }
+   double GetMaxEigenvalue() const { return lambda_max; }
+};
+
 // Performs partial assembly for the energy mass matrix on a single zone.
 // Used to perform local CG solves, thus avoiding unnecessary communication.
 class LocalMassPAOperator : public Operator
@@ -224,6 +544,9 @@ private:
 
    QuadratureData *quad_data;
 
+   // Temporaries of the kernels below.
+   mutable WorkspaceArena work;
+
    // Mass matrix action on a quadrilateral element in 2D.
    void MultQuad(const Vector &x, Vector &y) const;
    // Mass matrix action on a hexahedral element in 3D.
@@ -234,12 +557,100 @@ public:
       : Operator(fes.GetFE(0)->GetDof()),
         dim(fes.GetMesh()->Dimension()), zone_id(0),
         quad_data(quad_data_)
-   { }
+   {
+      work.SetSize(KernelWorkspaceSize(*quad_data, dim, fes.GetMesh()->GetNE(),
+                                       fes.GetFE(0)->GetOrder()));
+   }
    void SetZoneId(int zid) { zone_id = zid; }
 
    virtual void Mult(const Vector &x, Vector &y) const;
 };
 
+// Solves with the energy mass matrices of all zones, in batches of W zones
+// whose values are interleaved, as in ZoneInterleavedData. In direct mode, the
+// zone inverses are computed once and applied as batched small matrix-vector
+// products. Otherwise, no matrices are stored and CG runs on all zones of a
+// batch at once, using a batched version of LocalMassPAOperator.
+class BatchedEnergyMassSolver
+{
+private:
+   const int dim, nzones, ndofs, nqp, W;
+   const bool direct;
+
+   QuadratureData *quad_data;
+   FiniteElementSpace &L2FESpace;
+
+   // Direct mode: component i at "point" j of zone z is inv(M_z)(i, j). In
+   // the mixed precision mode, the inverses are stored in Minv_sp instead.
+   ZoneInterleavedData Minv;
+   ZoneInterleavedFloatData Minv_sp;
+
+   // Batch vectors of all threads, ThreadWorkSize() entries per thread.
+   mutable Vector thread_work;
+   int ThreadWorkSize() const;
+
+   // Batched mass action, for the interleaved data d of the W zones (rho0DetJ0w
+   // at all quadrature points). The work array has WorkSize() entries.
+   template<int W_> void MassMult(const double *d, const double *x, double *y,
+                                  double *work) const;
+   int WorkSize() const;
+
+   // Direct or CG solve in batch zb. The CG solve returns the sum of the
+   // iterations of its zones.
+   template<int W_, typename T>
+   void DirectSolve(const T *M_all, int zb, const double *b, double *x) const;
+   template<int W_> int CGSolve(const double *d, const double *b, double *x,
+                                double *work) const;
+
+   template<int W_> int MultBatches(const Vector &b, Vector &x) const;
+
+public:
+   BatchedEnergyMassSolver(QuadratureData *quad_data_, FiniteElementSpace &fes,
+                           int W_, bool direct_);
+
+   // Solves in all zones, returning the number of processed dofs, i.e., the
+   // sum of #dofs * #(CG iterations) over the zones (one iteration in direct
+   // mode).
+   int Mult(const Vector &b, Vector &x) const;
+};
+
+// Analytic cost of the partial assembly kernels per zone: the floating point
+// operations (a multiply-add counts as two) of the sum factorizations, and the
+// compulsory memory traffic in bytes, i.e., the dof values, dof indices and
+// quadrature data of the zone. The 1D basis matrices and the temporaries are
+// assumed to stay in cache. The sizes are the 1D numbers of dofs and points.
+struct KernelCost
+{
+   double flops, bytes;
+
+   KernelCost() : flops(0.0), bytes(0.0) { }
+   KernelCost(double f, double b) : flops(f), bytes(b) { }
+
+   KernelCost &operator+=(const KernelCost &c)
+   { flops += c.flops; bytes += c.bytes; return *this; }
+   KernelCost operator*(double s) const
+   { return KernelCost(s * flops, s * bytes); }
+};
+
+// ForcePAOperator::Mult (transpose = false) or MultTranspose. The stored
+// quadrature values take qbytes each (4 in the mixed precision mode).
+KernelCost ForcePACost(int dim, int h1dofs1D, int l2dofs1D, int nqp1D,
+                       bool transpose, int qbytes = 8);
+// MassPAOperator::Mult, for all dim components.
+KernelCost MassPACost(int dim, int dofs1D, int nqp1D, int qbytes = 8);
+// LocalMassPAOperator::Mult.
+KernelCost LocalMassPACost(int dim, int dofs1D, int nqp1D);
+// FastEvaluator::GetL2Values and FastEvaluator::GetVectorGrad.
+KernelCost L2ValuesCost(int dim, int l2dofs1D, int nqp1D);
+KernelCost VectorGradCost(int dim, int h1dofs1D, int nqp1D);
+// LagrangianHydroOperator::UpdateQuadratureData with partial assembly. The
+// pointwise work is approximate; the eigenvalue and singular value
+// computations are counted as 20 dim^2 operations each. With jac0 = false,
+// the initial Jacobians are recomputed from the initial positions instead of
+// reading the stored Jac0inv.
+KernelCost QuadratureUpdateCost(int dim, int h1dofs1D, int l2dofs1D,
+                                int nqp1D, int qbytes = 8, bool jac0 = true);
+
 } // namespace hydrodynamics
 
 } // namespace mfem
@@ -0,0 +1,378 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+//
+//                 Laghos partial assembly kernel benchmarks
+//
+// Times the partial assembly kernels of laghos_assembly.hpp in isolation, on
+// one process and one thread: ForcePAOperator::Mult and MultTranspose,
+// MassPAOperator::Mult, LocalMassPAOperator::Mult (all zones), and
+// FastEvaluator::GetL2Values and GetVectorGrad (all zones). The zones form a
+// Cartesian mesh of the unit square or cube, with synthetic quadrature data.
+// Each (Q_k, Q_k-1) order pair uses the integration rule of Laghos. The number
+// of zones is chosen such that the quadrature data has about the given number
+// of points, independently of the order.
+//
+// For each kernel, the average time of one application over the repetitions
+// (after the warm-up applications) is reported, together with the rates in
+// GFLOP/s, GB/s and megazones/s. The FLOP and byte counts are the analytic
+// ones of KernelCost, see laghos_assembly.hpp.
+//
+// Sample runs:
+//    laghos_bench
+//    laghos_bench -dim 3 -omin 2 -omax 4 -nq 4e6 -r 20
+//    laghos_bench -dim 2 -sw 4
+//    laghos_bench -dim 3 -sw 8 -mp
+
+#include "laghos_assembly.hpp"
+#include <iomanip>
+
+using namespace std;
+using namespace mfem;
+using namespace mfem::hydrodynamics;
+
+static Mesh *MakeCartesianMesh(int dim, int n)
+{
+   if (dim == 2) { return new Mesh(n, n, Element::QUADRILATERAL, 1); }
+   return new Mesh(n, n, n, Element::HEXAHEDRON, 1);
+}
+
+// The data and operators of one benchmark case: all kernels for one dimension
+// and one (Q_k, Q_k-1) order pair.
+class KernelBench
+{
+private:
+   const int dim, simd_width;
+   const bool mixed_precision;
+   Mesh *mesh;
+   H1_FECollection H1FEC;
+   L2_FECollection L2FEC;
+   FiniteElementSpace H1FESpace, L2FESpace;
+   const IntegrationRule &integ_rule;
+   const int nqp, nqp1D, h1dofs_cnt, l2dofs_cnt;
+   QuadratureData quad_data;
+
+   ForcePAOperator *ForcePA;
+   MassPAOperator *VMassPA;
+   LocalMassPAOperator *locEMassPA;
+
+   // Input and output vectors of the kernels.
+   Vector v, e, rhs_h1, rhs_l2, loc_e, qp_vals;
+   DenseMatrix vecvalMat;
+   DenseTensor grad_v;
+
+   void SetQuadratureData();
+
+public:
+   enum { FORCE, FORCE_T, MASS, LOCAL_MASS, L2_VALUES, VECTOR_GRAD,
+          NUM_KERNELS
+        };
+
+   KernelBench(int dim_, int order_v, int nzones1D, int simd_width_,
+               bool mixed_precision_);
+
+   int GetNZones() const { return mesh->GetNE(); }
+   // False when the zone-interleaved layout was requested, but the orders
+   // have no fixed-size kernels. Then the kernels must not be run.
+   bool IsSupported() const
+   { return simd_width == 0 || quad_data.simd_width > 0; }
+   static const char *Name(int k);
+   // Cost of one application of kernel k, i.e., for all zones.
+   KernelCost Cost(int k) const;
+   void Run(int k);
+
+   ~KernelBench();
+};
+
+KernelBench::KernelBench(int dim_, int order_v, int nzones1D,
+                         int simd_width_, bool mixed_precision_)
+   : dim(dim_),
+     simd_width((mixed_precision_ && simd_width_ == 0) ? 1 : simd_width_),
+     mixed_precision(mixed_precision_),
+     mesh(MakeCartesianMesh(dim_, nzones1D)),
+     H1FEC(order_v, dim), L2FEC(order_v - 1, dim, BasisType::Positive),
+     H1FESpace(mesh, &H1FEC, dim), L2FESpace(mesh, &L2FEC),
+     integ_rule(IntRules.Get(mesh->GetElementBaseGeometry(0),
+                             3*order_v + (order_v - 1) - 1)),
+     nqp(integ_rule.GetNPoints()),
+     nqp1D(int(floor(0.7 + pow(nqp, 1.0 / dim)))),
+     h1dofs_cnt(H1FESpace.GetFE(0)->GetDof()),
+     l2dofs_cnt(L2FESpace.GetFE(0)->GetDof()),
+     quad_data(dim, mesh->GetNE(), nqp),
+     v(H1FESpace.GetVSize()), e(L2FESpace.GetVSize()),
+     rhs_h1(H1FESpace.GetVSize()), rhs_l2(L2FESpace.GetVSize()),
+     loc_e(L2FESpace.GetVSize()), qp_vals(mesh->GetNE() * nqp),
+     vecvalMat(h1dofs_cnt, dim), grad_v(dim, dim, nqp)
+{
+   H1FESpace.BuildElementToDofTable();
+   L2FESpace.BuildElementToDofTable();
+
+   delete evaluator;
+   delete tensors1D;
+   tensors1D = new Tensors1D(order_v, order_v - 1, nqp1D);
+   evaluator = new FastEvaluator(H1FESpace);
+
+   SetQuadratureData();
+   ForcePA = new ForcePAOperator(&quad_data, H1FESpace, L2FESpace);
+   VMassPA = new MassPAOperator(&quad_data, H1FESpace);
+   locEMassPA = new LocalMassPAOperator(&quad_data, L2FESpace);
+   if (simd_width > 0 && ForcePA->HasFixedKernels())
+   {
+      const int nzones = mesh->GetNE();
+      DenseTensor stress(quad_data.stressJinvT);
+      quad_data.SetZoneInterleaved(simd_width);
+      if (mixed_precision) { quad_data.SetSinglePrecision(); }
+      for (int z = 0; z < nzones; z++)
+      {
+         for (int vd = 0; vd < dim; vd++)
+         {
+            for (int gd = 0; gd < dim; gd++)
+            {
+               for (int q = 0; q < nqp; q++)
+               {
+                  const double s = stress(z*nqp + q, gd, vd);
+                  if (mixed_precision)
+                  {
+                     quad_data.stressJinvT_zf(z, vd*dim + gd, q) = (float) s;
+                  }
+                  else { quad_data.stressJinvT_zi(z, vd*dim + gd, q) = s; }
+               }
+            }
+         }
+      }
+   }
+
+   // Smooth, nonzero input values.
+   for (int i = 0; i < v.Size(); i++) { v(i) = sin(0.1 * i); }
+   for (int i = 0; i < e.Size(); i++) { e(i) = 1.0 + 0.5 * cos(0.1 * i); }
+}
+
+void KernelBench::SetQuadratureData()
+{
+   // The values of rho0DetJ0w are those of a unit density. The stress values
+   // are synthetic, as only their memory layout matters for the kernels.
+   const int nzones = mesh->GetNE();
+   for (int z = 0; z < nzones; z++)
+   {
+      ElementTransformation *T = H1FESpace.GetElementTransformation(z);
+      for (int q = 0; q < nqp; q++)
+      {
+         const IntegrationPoint &ip = integ_rule.IntPoint(q);
+         T->SetIntPoint(&ip);
+         quad_data.rho0DetJ0w(z*nqp + q) = T->Weight() * ip.weight;
+         for (int vd = 0; vd < dim; vd++)
+         {
+            for (int gd = 0; gd < dim; gd++)
+            {
+               quad_data.stressJinvT(z*nqp + q, gd, vd) =
+                  (vd == gd ? 1.0 : 0.1) * (1.0 + 0.01 * ((z + q) % 7));
+            }
+         }
+      }
+   }
+}
+
+const char *KernelBench::Name(int k)
+{
+   switch (k)
+   {
+      case FORCE:       return "ForcePA Mult";
+      case FORCE_T:     return "ForcePA MultTranspose";
+      case MASS:        return "MassPA Mult";
+      case LOCAL_MASS:  return "LocalMassPA Mult";
+      case L2_VALUES:   return "GetL2Values";
+      case VECTOR_GRAD: return "GetVectorGrad";
+   }
+   MFEM_ABORT("Unknown kernel " << k);
+   return NULL;
+}
+
+KernelCost KernelBench::Cost(int k) const
+{
+   const int h1dofs1D = tensors1D->HQshape1D.Height(),
+             l2dofs1D = tensors1D->LQshape1D.Height();
+   const int qb = (quad_data.single_qdata) ? 4 : 8;
+   KernelCost c;
+   switch (k)
+   {
+      case FORCE:
+         c = ForcePACost(dim, h1dofs1D, l2dofs1D, nqp1D, false, qb); break;
+      case FORCE_T:
+         c = ForcePACost(dim, h1dofs1D, l2dofs1D, nqp1D, true, qb); break;
+      case MASS:        c = MassPACost(dim, h1dofs1D, nqp1D, qb); break;
+      case LOCAL_MASS:  c = LocalMassPACost(dim, l2dofs1D, nqp1D); break;
+      case L2_VALUES:   c = L2ValuesCost(dim, l2dofs1D, nqp1D); break;
+      case VECTOR_GRAD: c = VectorGradCost(dim, h1dofs1D, nqp1D); break;
+      default: MFEM_ABORT("Unknown kernel " << k);
+   }
+   const int nzones = mesh->GetNE();
+   return KernelCost(c.flops * nzones, c.bytes * nzones);
+}
+
+void KernelBench::Run(int k)
+{
+   const int nzones = mesh->GetNE();
+   switch (k)
+   {
+      case FORCE: ForcePA->Mult(e, rhs_h1); break;
+      case FORCE_T: ForcePA->MultTranspose(v, rhs_l2); break;
+      case MASS: VMassPA->Mult(v, rhs_h1); break;
+      case LOCAL_MASS:
+         for (int z = 0; z < nzones; z++)
+         {
+            Vector x(e.GetData() + z*l2dofs_cnt, l2dofs_cnt),
+                   y(loc_e.GetData() + z*l2dofs_cnt, l2dofs_cnt);
+            locEMassPA->SetZoneId(z);
+            locEMassPA->Mult(x, y);
+         }
+         break;
+      case L2_VALUES:
+         for (int z = 0; z < nzones; z++)
+         {
+            Vector x(e.GetData() + z*l2dofs_cnt, l2dofs_cnt),
+                   vals(qp_vals.GetData() + z*nqp, nqp);
+            evaluator->GetL2Values(x, vals);
+         }
+         break;
+      case VECTOR_GRAD:
+      {
+         const int h1_ndofs = H1FESpace.GetNDofs();
+         const Table &h1_e2d = H1FESpace.GetElementToDofTable();
+         for (int z = 0; z < nzones; z++)
+         {
+            const int *h1dofs = h1_e2d.GetRow(z);
+            for (int c = 0; c < dim; c++)
+            {
+               for (int j = 0; j < h1dofs_cnt; j++)
+               {
+                  vecvalMat(j, c) = v(h1dofs[j] + c*h1_ndofs);
+               }
+            }
+            evaluator->GetVectorGrad(vecvalMat, grad_v);
+         }
+         break;
+      }
+      default: MFEM_ABORT("Unknown kernel " << k);
+   }
+}
+
+KernelBench::~KernelBench()
+{
+   delete locEMassPA;
+   delete VMassPA;
+   delete ForcePA;
+   delete evaluator;
+   delete tensors1D;
+   evaluator = NULL;
+   tensors1D = NULL;
+   delete mesh;
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef MFEM_USE_MPI
+   MPI_Session mpi(argc, argv);
+   MFEM_VERIFY(mpi.WorldSize() == 1, "The benchmarks run on a single rank.");
+#endif
+
+   int dim = 0;
+   int order_min = 1, order_max = 8;
+   double quad_points = 1e6;
+   int warm_up = 2, reps = 10;
+   int simd_width = 0;
+   bool mixed_precision = false;
+
+   OptionsParser args(argc, argv);
+   args.AddOption(&dim, "-dim", "--dimension",
+                  "Dimension of the zones, 2 or 3 (0 runs both).");
+   args.AddOption(&order_min, "-omin", "--order-min",
+                  "Smallest kinematic order k of the (Q_k, Q_k-1) pairs.");
+   args.AddOption(&order_max, "-omax", "--order-max",
+                  "Largest kinematic order k of the (Q_k, Q_k-1) pairs.");
+   args.AddOption(&quad_points, "-nq", "--quad-points",
+                  "Approximate total number of quadrature points.");
+   args.AddOption(&warm_up, "-w", "--warm-up",
+                  "Untimed applications of each kernel before the timed ones.");
+   args.AddOption(&reps, "-r", "--repetitions",
+                  "Timed applications of each kernel.");
+   args.AddOption(&simd_width, "-sw", "--simd-width",
+                  "Zone-interleaved quadrature data layout of width 4 or 8\n\t"
+                  "(0 = standard layout), as in Laghos.");
+   args.AddOption(&mixed_precision, "-mp", "--mixed-precision", "-dp",
+                  "--double-precision",
+                  "Single precision quadrature data, as in Laghos.");
+   args.Parse();
+   if (!args.Good())
+   {
+      args.PrintUsage(cout);
+      return 1;
+   }
+   args.PrintOptions(cout);
+   MFEM_VERIFY(reps > 0, "At least one repetition is needed.");
+   MFEM_VERIFY(simd_width == 0 || simd_width == 4 || simd_width == 8,
+               "The SIMD width must be 0, 4 or 8.");
+
+   cout << endl << setw(3) << "dim" << setw(6) << "order" << setw(9)
+        << "zones" << "  " << setw(24) << left << "kernel" << right
+        << setw(12) << "time (s)" << setw(10) << "GFLOP/s"
+        << setw(10) << "GB/s" << setw(10) << "Mzones/s" << endl;
+
+   const int dim_min = (dim == 0) ? 2 : dim, dim_max = (dim == 0) ? 3 : dim;
+   for (int d = dim_min; d <= dim_max; d++)
+   {
+      for (int order_v = order_min; order_v <= order_max; order_v++)
+      {
+         // Zones with about quad_points points in total.
+         const Geometry::Type geom = (d == 2) ? Geometry::SQUARE :
+                                     Geometry::CUBE;
+         const int nqp = IntRules.Get(geom, 4*order_v - 2).GetNPoints();
+         const int nzones1D = max(1, int(floor(0.5 + pow(quad_points / nqp,
+                                                           1.0 / d))));
+         KernelBench bench(d, order_v, nzones1D, simd_width,
+                           mixed_precision);
+         ostringstream order;
+         order << "Q" << order_v << "Q" << order_v - 1;
+         if (!bench.IsSupported())
+         {
+            cout << setw(3) << d << setw(6) << order.str()
+                 << "  (no zone-interleaved kernels, skipped)" << endl;
+            continue;
+         }
+
+         StopWatch timer;
+         for (int k = 0; k < KernelBench::NUM_KERNELS; k++)
+         {
+            for (int i = 0; i < warm_up; i++) { bench.Run(k); }
+            timer.Clear();
+            timer.Start();
+            for (int i = 0; i < reps; i++) { bench.Run(k); }
+            timer.Stop();
+
+            const double time = timer.RealTime() / reps;
+            const KernelCost cost = bench.Cost(k);
+            cout << setw(3) << d << setw(6) << order.str()
+                 << setw(9) << bench.GetNZones() << "  "
+                 << setw(24) << left << KernelBench::Name(k) << right
+                 << scientific << setprecision(3) << setw(12) << time
+                 << fixed << setprecision(2)
+                 << setw(10) << 1e-9 * cost.flops / time
+                 << setw(10) << 1e-9 * cost.bytes / time
+                 << setw(10) << 1e-6 * bench.GetNZones() / time << endl;
+         }
+      }
+   }
+
+   return 0;
+}
@@ -0,0 +1,158 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#include "laghos_checkpoint.hpp"
+#include "laghos_solver.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+void WriteBinaryArray(ostream &os, const double *data, int size)
+{
+   WriteBinary(os, size);
+   os.write(reinterpret_cast<const char *>(data), size * sizeof(double));
+}
+
+void ReadBinaryArray(istream &is, double *data, int size)
+{
+   int stored_size;
+   ReadBinary(is, stored_size);
+   MFEM_VERIFY(stored_size == size, "Checkpoint array size mismatch: "
+               << stored_size << " != " << size);
+   is.read(reinterpret_cast<char *>(data), size * sizeof(double));
+   MFEM_VERIFY(is, "Error reading the checkpoint file.");
+}
+
+#ifdef MFEM_USE_MPI
+
+// File format identifier and version, at the start of every rank file.
+static const char checkpoint_magic[8] = { 'L','A','G','H','O','S','C','K' };
+static const int checkpoint_version = 1;
+
+static string RankFileName(const string &dir, int rank)
+{
+   ostringstream name;
+   name << dir << "/rank." << setfill('0') << setw(6) << rank;
+   return name.str();
+}
+
+// Creates the directory and its missing parents, like mkdir -p.
+static void MakeDirectory(const string &dir)
+{
+   for (size_t pos = 1; pos <= dir.size(); pos++)
+   {
+      if (pos < dir.size() && dir[pos] != '/') { continue; }
+      const string sub = dir.substr(0, pos);
+      if (mkdir(sub.c_str(), 0775) != 0 && errno != EEXIST)
+      {
+         MFEM_ABORT("Cannot create the directory " << sub << ": "
+                    << strerror(errno));
+      }
+   }
+}
+
+void SaveCheckpoint(const string &dir, MPI_Comm comm,
+                    const CheckpointState &cs, const Vector &S,
+                    const LagrangianHydroOperator &oper)
+{
+   int myid, num_procs;
+   MPI_Comm_rank(comm, &myid);
+   MPI_Comm_size(comm, &num_procs);
+
+   // A stale info file of an earlier run is removed before any rank writes,
+   // so that a partially overwritten checkpoint is never taken as complete.
+   if (myid == 0)
+   {
+      MakeDirectory(dir);
+      remove((dir + "/info").c_str());
+   }
+   MPI_Barrier(comm);
+
+   const string name = RankFileName(dir, myid);
+   ofstream os(name.c_str(), ios::binary);
+   MFEM_VERIFY(os, "Cannot open the checkpoint file " << name);
+   os.write(checkpoint_magic, sizeof(checkpoint_magic));
+   WriteBinary(os, checkpoint_version);
+   WriteBinary(os, num_procs);
+   WriteBinary(os, myid);
+   WriteBinary(os, cs);
+   WriteBinaryArray(os, S.GetData(), S.Size());
+   oper.SaveState(os);
+   profiler.Save(os);
+   os.close();
+   MFEM_VERIFY(os, "Error writing the checkpoint file " << name);
+
+   MPI_Barrier(comm);
+   if (myid == 0)
+   {
+      ofstream info((dir + "/info").c_str());
+      info << "Laghos checkpoint, version " << checkpoint_version << '\n'
+           << "ranks " << num_procs << '\n'
+           << "step " << cs.ti << '\n'
+           << "time " << setprecision(17) << cs.t << '\n';
+   }
+}
+
+void LoadCheckpoint(const string &dir, MPI_Comm comm,
+                    CheckpointState &cs, Vector &S,
+                    LagrangianHydroOperator &oper)
+{
+   int myid, num_procs;
+   MPI_Comm_rank(comm, &myid);
+   MPI_Comm_size(comm, &num_procs);
+
+   ifstream info((dir + "/info").c_str());
+   MFEM_VERIFY(info, "The checkpoint " << dir << " is missing or incomplete.");
+
+   const string name = RankFileName(dir, myid);
+   ifstream is(name.c_str(), ios::binary);
+   MFEM_VERIFY(is, "Cannot open the checkpoint file " << name);
+   char magic[sizeof(checkpoint_magic)];
+   is.read(magic, sizeof(magic));
+   MFEM_VERIFY(is && memcmp(magic, checkpoint_magic, sizeof(magic)) == 0,
+               name << " is not a Laghos checkpoint file.");
+   int version, file_procs, file_id;
+   ReadBinary(is, version);
+   ReadBinary(is, file_procs);
+   ReadBinary(is, file_id);
+   MFEM_VERIFY(version == checkpoint_version,
+               "Unsupported checkpoint version " << version);
+   MFEM_VERIFY(file_procs == num_procs && file_id == myid,
+               "The checkpoint was written by " << file_procs
+               << " ranks; restart with the same number of ranks.");
+   ReadBinary(is, cs);
+   ReadBinaryArray(is, S.GetData(), S.Size());
+   oper.LoadState(is, S);
+   profiler.Load(is);
+}
+
+#endif // MFEM_USE_MPI
+
+} // namespace hydrodynamics
+
+} // namespace mfem
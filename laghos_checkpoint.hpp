@@ -0,0 +1,85 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#ifndef MFEM_LAGHOS_CHECKPOINT
+#define MFEM_LAGHOS_CHECKPOINT
+
+#include "mfem.hpp"
+#include <iostream>
+#include <string>
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+// Binary I/O of the checkpoint files. Scalars and plain structs are stored as
+// their raw bytes, arrays as their size followed by their values. The readers
+// abort when the stream fails or when a stored array size does not match.
+template <typename T>
+inline void WriteBinary(std::ostream &os, const T &value)
+{ os.write(reinterpret_cast<const char *>(&value), sizeof(T)); }
+
+template <typename T>
+inline void ReadBinary(std::istream &is, T &value)
+{
+   is.read(reinterpret_cast<char *>(&value), sizeof(T));
+   MFEM_VERIFY(is, "Error reading the checkpoint file.");
+}
+
+void WriteBinaryArray(std::ostream &os, const double *data, int size);
+void ReadBinaryArray(std::istream &is, double *data, int size);
+
+#ifdef MFEM_USE_MPI
+
+class LagrangianHydroOperator;
+
+// State of the time loop that is stored in the checkpoints, together with the
+// solution vector and the state of the operator. ti is the last completed time
+// step, and dt the time step of the next one.
+struct CheckpointState
+{
+   double t, dt, energy_init;
+   int ti, steps, rejected_steps;
+
+   CheckpointState()
+      : t(0.0), dt(0.0), energy_init(0.0), ti(0), steps(0), rejected_steps(0)
+   { }
+};
+
+// Collective. Writes one binary file per rank, dir/rank.<rank>, creating the
+// directory if needed. When all ranks are done, rank 0 writes the text file
+// dir/info, which marks the checkpoint as complete; an existing info file is
+// removed before the rank files are written.
+void SaveCheckpoint(const std::string &dir, MPI_Comm comm,
+                    const CheckpointState &cs, const Vector &S,
+                    const LagrangianHydroOperator &oper);
+
+// Collective. Reads a checkpoint written by SaveCheckpoint with the same number
+// of ranks and the same discretization. The solution S and the operator must
+// be set up as at the start of the run; their state is then overwritten.
+void LoadCheckpoint(const std::string &dir, MPI_Comm comm,
+                    CheckpointState &cs, Vector &S,
+                    LagrangianHydroOperator &oper);
+
+#endif // MFEM_USE_MPI
+
+} // namespace hydrodynamics
+
+} // namespace mfem
+
+#endif // MFEM_LAGHOS_CHECKPOINT
@@ -0,0 +1,142 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#include "laghos_diagnostics.hpp"
+#include <iomanip>
+
+#ifdef MFEM_USE_MPI
+
+using namespace std;
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+Diagnostics::Diagnostics(MPI_Comm comm_)
+   : comm(comm_), request(MPI_REQUEST_NULL), step(0), reduced_step(-1),
+     time(0.0), reduced_time(0.0), log(NULL)
+{
+   MPI_Op_create(Reduce, 1, &op);
+   for (int q = 0; q < NUM_QUANTITIES; q++) { local[q] = global[q] = 0.0; }
+}
+
+void Diagnostics::Reduce(void *in, void *inout, int *len, MPI_Datatype *type)
+{
+   const double *a = static_cast<const double *>(in);
+   double *b = static_cast<double *>(inout);
+   for (int i = 0; i < *len; i++)
+   {
+      if (i % NUM_QUANTITIES < NUM_SUMS) { b[i] += a[i]; }
+      else { b[i] = max(a[i], b[i]); }
+   }
+}
+
+void Diagnostics::Start(int step_, double time_)
+{
+   Finish();
+   step = step_;
+   time = time_;
+   // The send buffer must not change until the reduction completes, while the
+   // values of the next state may be set at any time.
+   for (int q = 0; q < NUM_QUANTITIES; q++) { send[q] = local[q]; }
+   MPI_Iallreduce(send, recv, NUM_QUANTITIES, MPI_DOUBLE, op, comm,
+                  &request);
+}
+
+bool Diagnostics::Test()
+{
+   if (!Pending()) { return true; }
+   int done;
+   MPI_Test(&request, &done, MPI_STATUS_IGNORE);
+   if (done)
+   {
+      for (int q = 0; q < NUM_QUANTITIES; q++) { global[q] = recv[q]; }
+      reduced_step = step;
+      reduced_time = time;
+      if (log) { PrintValues(*log); }
+   }
+   return done != 0;
+}
+
+void Diagnostics::Finish()
+{
+   if (!Pending()) { return; }
+   MPI_Wait(&request, MPI_STATUS_IGNORE);
+   for (int q = 0; q < NUM_QUANTITIES; q++) { global[q] = recv[q]; }
+   reduced_step = step;
+   reduced_time = time;
+   if (log) { PrintValues(*log); }
+}
+
+const char *Diagnostics::Name(Quantity q)
+{
+   switch (q)
+   {
+      case INTERNAL_ENERGY:     return "internal_energy";
+      case KINETIC_ENERGY:      return "kinetic_energy";
+      case E_NORM2:             return "e_norm2";
+      case MASS:                return "mass";
+      case VELOCITY_ERROR_L1:   return "v_error_l1";
+      case VELOCITY_ERROR_L2SQ: return "v_error_l2sq";
+      case MIN_DENSITY:         return "rho_min";
+      case MAX_DENSITY:         return "rho_max";
+      case MIN_PRESSURE:        return "p_min";
+      case MAX_PRESSURE:        return "p_max";
+      case MIN_DETJ:            return "detJ_min";
+      case MAX_VELOCITY:        return "v_max";
+      case VELOCITY_ERROR_MAX:  return "v_error_max";
+      default: break;
+   }
+   MFEM_ABORT("Unknown quantity " << q);
+   return NULL;
+}
+
+void Diagnostics::PrintHeader(ostream &out)
+{
+   out << "# step time";
+   for (int q = 0; q < NUM_QUANTITIES; q++)
+   {
+      out << ' ' << Name((Quantity) q);
+   }
+   out << '\n';
+}
+
+void Diagnostics::PrintValues(ostream &out) const
+{
+   const ios::fmtflags flags = out.flags();
+   out << reduced_step << ' ' << scientific << setprecision(10)
+       << reduced_time;
+   for (int q = 0; q < NUM_QUANTITIES; q++)
+   {
+      out << ' ' << Get((Quantity) q);
+   }
+   out << '\n';
+   out.flags(flags);
+}
+
+Diagnostics::~Diagnostics()
+{
+   Finish();
+   MPI_Op_free(&op);
+}
+
+} // namespace hydrodynamics
+
+} // namespace mfem
+
+#endif // MFEM_USE_MPI
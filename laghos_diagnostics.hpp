@@ -0,0 +1,109 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#ifndef MFEM_LAGHOS_DIAGNOSTICS
+#define MFEM_LAGHOS_DIAGNOSTICS
+
+#include "mfem.hpp"
+#include <iostream>
+
+#ifdef MFEM_USE_MPI
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+// Global monitoring quantities of a state. Each rank sets its local values,
+// and all of them are reduced together, with a single MPI_Iallreduce that can
+// complete while the next time step is computed.
+class Diagnostics
+{
+public:
+   enum Quantity
+   {
+      // Sums over the ranks.
+      INTERNAL_ENERGY, KINETIC_ENERGY, E_NORM2, MASS,
+      VELOCITY_ERROR_L1, VELOCITY_ERROR_L2SQ,
+      NUM_SUMS,
+      // Maxima over the ranks. Minima are reduced as maxima of -value.
+      MIN_DENSITY = NUM_SUMS, MAX_DENSITY, MIN_PRESSURE, MAX_PRESSURE,
+      MIN_DETJ, MAX_VELOCITY, VELOCITY_ERROR_MAX,
+      NUM_QUANTITIES
+   };
+
+private:
+   MPI_Comm comm;
+   MPI_Op op;
+   MPI_Request request;
+   // The values of this rank, the copy that is being reduced, the receive
+   // buffer of the reduction, and the result of the last finished one, which
+   // is copied from recv by Test or Finish.
+   double local[NUM_QUANTITIES], send[NUM_QUANTITIES], recv[NUM_QUANTITIES],
+          global[NUM_QUANTITIES];
+   int step, reduced_step;
+   double time, reduced_time;
+   std::ostream *log;
+
+   static bool IsMin(int q)
+   { return q == MIN_DENSITY || q == MIN_PRESSURE || q == MIN_DETJ; }
+   // The MPI_Op of the reduction: sums for the first NUM_SUMS entries and
+   // maxima for the others.
+   static void Reduce(void *in, void *inout, int *len, MPI_Datatype *type);
+
+public:
+   Diagnostics(MPI_Comm comm_);
+
+   // When not NULL, the values of every finished reduction are printed there
+   // with PrintValues. Usually set only on rank 0.
+   void SetLog(std::ostream *out) { log = out; }
+
+   // Sets the value of this rank. Quantities that are not set are 0.
+   void Set(Quantity q, double value)
+   { local[q] = IsMin(q) ? -value : value; }
+
+   // Starts the reduction of the values set since the last Start, for the
+   // state of the given step and time. A reduction in progress is finished
+   // first.
+   void Start(int step_, double time_);
+   // Lets MPI progress the reduction in progress; true when it is complete.
+   bool Test();
+   // Waits for the reduction in progress, if any. Get then returns its result.
+   void Finish();
+   bool Pending() const { return request != MPI_REQUEST_NULL; }
+
+   // Global value of the last finished reduction.
+   double Get(Quantity q) const { return IsMin(q) ? -global[q] : global[q]; }
+   int GetStep() const { return reduced_step; }
+   double GetTime() const { return reduced_time; }
+
+   static const char *Name(Quantity q);
+   // Column names, and the step, time and values of the last finished
+   // reduction, as lines of a whitespace-separated table.
+   static void PrintHeader(std::ostream &out);
+   void PrintValues(std::ostream &out) const;
+
+   ~Diagnostics();
+};
+
+} // namespace hydrodynamics
+
+} // namespace mfem
+
+#endif // MFEM_USE_MPI
+
+#endif // MFEM_LAGHOS_DIAGNOSTICS
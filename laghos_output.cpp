@@ -0,0 +1,219 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#include "laghos_output.hpp"
+#include "laghos_profiler.hpp"
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#ifdef MFEM_USE_MPI
+
+using namespace std;
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+AsyncOutput::AsyncOutput(int num_slots, ParMesh &pmesh,
+                         ParFiniteElementSpace &h1, ParFiniteElementSpace &l2,
+                         const string &basename_, bool print,
+                         SnapshotWriter *snap)
+   : H1FESpace(h1), L2FESpace(l2), basename(basename_), gfprint(print),
+     snapshots(snap), mesh_copy(NULL), comm(pmesh.GetComm()),
+     slots(num_slots), first(0), count(0), stop(false), submitted(0),
+     written(0), indexed(0), index_cycle(num_slots + 1),
+     index_time(num_slots + 1), write_time(0.0), wait_time(0.0)
+{
+   MFEM_VERIFY(num_slots > 0, "At least one staging slot is needed.");
+   MPI_Comm_rank(comm, &myid);
+   if (gfprint) { mesh_copy = new ParMesh(pmesh, true); }
+
+   // All staging memory is allocated here, so Submit does not allocate.
+   for (int i = 0; i < num_slots; i++)
+   {
+      slots[i] = new Job;
+      slots[i]->x.SetSize(h1.GetVSize());
+      slots[i]->v.SetSize(h1.GetVSize());
+      slots[i]->e.SetSize(l2.GetVSize());
+      slots[i]->rho.SetSize(l2.GetVSize());
+   }
+
+   pthread_mutex_init(&mutex, NULL);
+   pthread_cond_init(&job_ready, NULL);
+   pthread_cond_init(&slot_free, NULL);
+   const int err = pthread_create(&thread, NULL, ThreadMain, this);
+   MFEM_VERIFY(err == 0, "Cannot start the output thread.");
+}
+
+void *AsyncOutput::ThreadMain(void *self)
+{
+   static_cast<AsyncOutput *>(self)->Run();
+   return NULL;
+}
+
+void AsyncOutput::Run()
+{
+   pthread_mutex_lock(&mutex);
+   while (true)
+   {
+      while (count == 0 && !stop) { pthread_cond_wait(&job_ready, &mutex); }
+      if (count == 0) { break; }
+      const Job &job = *slots[first];
+      pthread_mutex_unlock(&mutex);
+
+      write_clock.Clear();
+      write_clock.Start();
+      Write(job);
+      write_clock.Stop();
+      write_time += write_clock.RealTime();
+
+      pthread_mutex_lock(&mutex);
+      first = (first + 1) % slots.Size();
+      count--;
+      written++;
+      pthread_cond_signal(&slot_free);
+   }
+   pthread_mutex_unlock(&mutex);
+}
+
+void AsyncOutput::Write(const Job &job)
+{
+   if (snapshots)
+   {
+      snapshots->SaveLocal(job.cycle, job.x, job.v, job.e, job.rho);
+   }
+   if (!gfprint) { return; }
+
+   // Same files as the synchronous -print output.
+   *mesh_copy->GetNodes() = job.x;
+   GridFunction rho_gf(&L2FESpace, job.rho.GetData()),
+                v_gf(&H1FESpace, job.v.GetData()),
+                e_gf(&L2FESpace, job.e.GetData());
+   const char *names[4] = { "mesh", "rho", "v", "e" };
+   for (int i = 0; i < 4; i++)
+   {
+      ostringstream name;
+      name << basename << "_" << job.cycle << "_" << names[i] << "."
+           << setfill('0') << setw(6) << myid;
+      ofstream ofs(name.str().c_str());
+      ofs.precision(8);
+      switch (i)
+      {
+         case 0: mesh_copy->Print(ofs); break;
+         case 1: rho_gf.Save(ofs); break;
+         case 2: v_gf.Save(ofs); break;
+         case 3: e_gf.Save(ofs); break;
+      }
+   }
+}
+
+void AsyncOutput::UpdateIndex()
+{
+   pthread_mutex_lock(&mutex);
+   const int my_written = written;
+   pthread_mutex_unlock(&mutex);
+   int all_written;
+   MPI_Allreduce(&my_written, &all_written, 1, MPI_INT, MPI_MIN, comm);
+   for ( ; indexed < all_written; indexed++)
+   {
+      const int j = indexed % index_cycle.Size();
+      snapshots->AddToIndex(index_cycle[j], index_time(j));
+   }
+}
+
+void AsyncOutput::Submit(int cycle, double time, const Vector &x,
+                         const Vector &v, const Vector &e, const Vector &rho)
+{
+   if (snapshots)
+   {
+      // Every rank has at most all slots in flight, so at most that many jobs
+      // are not in the index after the update.
+      UpdateIndex();
+      MFEM_VERIFY(submitted - indexed < index_cycle.Size(),
+                  "Too many snapshots wait for the index.");
+      index_cycle[submitted % index_cycle.Size()] = cycle;
+      index_time(submitted % index_time.Size()) = time;
+   }
+   submitted++;
+
+   pthread_mutex_lock(&mutex);
+   if (count == slots.Size())
+   {
+      // The writer fell behind; wait for it to free a slot.
+      StopWatch wait_clock;
+      wait_clock.Start();
+      profiler.Begin("Output wait");
+      while (count == slots.Size()) { pthread_cond_wait(&slot_free, &mutex); }
+      profiler.End();
+      wait_clock.Stop();
+      wait_time += wait_clock.RealTime();
+   }
+   Job &job = *slots[(first + count) % slots.Size()];
+   pthread_mutex_unlock(&mutex);
+
+   // The slot is not visible to the writer until count is incremented.
+   job.cycle = cycle;
+   job.time = time;
+   job.x = x;
+   job.v = v;
+   job.e = e;
+   job.rho = rho;
+
+   pthread_mutex_lock(&mutex);
+   count++;
+   pthread_cond_signal(&job_ready);
+   pthread_mutex_unlock(&mutex);
+}
+
+void AsyncOutput::Finish()
+{
+   if (stop) { return; }
+   StopWatch wait_clock;
+   wait_clock.Start();
+   profiler.Begin("Output wait");
+   pthread_mutex_lock(&mutex);
+   stop = true;
+   pthread_cond_signal(&job_ready);
+   pthread_mutex_unlock(&mutex);
+   pthread_join(thread, NULL);
+   if (snapshots) { UpdateIndex(); }
+   profiler.End();
+   wait_clock.Stop();
+   wait_time += wait_clock.RealTime();
+
+   profiler.Record("Output write (async)", write_time);
+   profiler.Record("Output hidden (async)",
+                   std::max(write_time - wait_time, 0.0));
+}
+
+AsyncOutput::~AsyncOutput()
+{
+   Finish();
+   pthread_cond_destroy(&slot_free);
+   pthread_cond_destroy(&job_ready);
+   pthread_mutex_destroy(&mutex);
+   for (int i = 0; i < slots.Size(); i++) { delete slots[i]; }
+   delete mesh_copy;
+}
+
+} // namespace hydrodynamics
+
+} // namespace mfem
+
+#endif // MFEM_USE_MPI
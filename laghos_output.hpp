@@ -0,0 +1,118 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#ifndef MFEM_LAGHOS_OUTPUT
+#define MFEM_LAGHOS_OUTPUT
+
+#include "mfem.hpp"
+#include "laghos_snapshot.hpp"
+#include <pthread.h>
+#include <string>
+
+#ifdef MFEM_USE_MPI
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+// Writes the -print files and the binary snapshots on a background thread,
+// while the time loop continues. Submit copies the state into one of a fixed
+// number of staging slots; when all of them wait to be written, it blocks until
+// the writer frees one (back-pressure). The writer thread makes no MPI calls,
+// so the snapshots are written with SnapshotWriter::SaveLocal. VisIt output,
+// which is collective, stays on the main thread. The index entry of a snapshot
+// is added on the main thread, at a Submit or Finish after all ranks have
+// written their blocks of it, so that the index lists only complete snapshots.
+class AsyncOutput
+{
+private:
+   struct Job
+   {
+      int cycle;
+      double time;
+      Vector x, v, e, rho;
+   };
+
+   ParFiniteElementSpace &H1FESpace, &L2FESpace;
+   const std::string basename;
+   const bool gfprint;
+   SnapshotWriter *snapshots;
+   // Copy of the mesh, whose nodes are set to those of the job before it is
+   // printed. Only the writer thread uses it.
+   ParMesh *mesh_copy;
+   MPI_Comm comm;
+   int myid;
+
+   // Ring of staging slots: the jobs first, first+1, ... (count of them) wait
+   // to be written.
+   Array<Job *> slots;
+   int first, count;
+   bool stop;
+   // Number of jobs submitted, written by the writer thread (shared, guarded
+   // by the mutex) and added to the snapshot index. The cycles and times of
+   // the jobs that are not in the index yet, by job number modulo their size.
+   int submitted, written, indexed;
+   Array<int> index_cycle;
+   Vector index_time;
+   pthread_t thread;
+   pthread_mutex_t mutex;
+   pthread_cond_t job_ready, slot_free;
+
+   // Writer thread only: the total time of the writes.
+   StopWatch write_clock;
+   double write_time;
+   // Main thread only: time spent waiting for free slots.
+   double wait_time;
+
+   static void *ThreadMain(void *self);
+   void Run();
+   void Write(const Job &job);
+   // Collective. Adds the snapshots that all ranks have written to the index.
+   void UpdateIndex();
+
+public:
+   // The snapshot writer, if not NULL, is used but not owned.
+   AsyncOutput(int num_slots, ParMesh &pmesh, ParFiniteElementSpace &h1,
+               ParFiniteElementSpace &l2, const std::string &basename_,
+               bool print, SnapshotWriter *snap);
+
+   // Collective when snapshots are written. Queues the output of the given
+   // state. x, v, e and rho are the grid functions of the H1 and L2 spaces
+   // above.
+   void Submit(int cycle, double time, const Vector &x, const Vector &v,
+               const Vector &e, const Vector &rho);
+
+   // Collective when snapshots are written. Waits until all queued jobs are
+   // written, completes the snapshot index, and adds the regions "Output
+   // write (async)" and "Output hidden (async)" to the profiler: the time of
+   // the writes, and the part of it that did not block the time loop.
+   void Finish();
+
+   double WriteTime() const { return write_time; }
+   double WaitTime() const { return wait_time; }
+
+   ~AsyncOutput();
+};
+
+} // namespace hydrodynamics
+
+} // namespace mfem
+
+#endif // MFEM_USE_MPI
+
+#endif // MFEM_LAGHOS_OUTPUT
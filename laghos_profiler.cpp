@@ -0,0 +1,552 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#include "laghos_profiler.hpp"
+#include "laghos_assembly.hpp"
+#include "laghos_checkpoint.hpp"
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+RegionProfiler profiler;
+
+RegionProfiler::RegionProfiler() : regions(1), current(0), paused(false)
+{
+   regions[0].name = "Total";
+   regions[0].parent = -1;
+   regions[0].calls = 1;
+   regions[0].time = regions[0].start = 0.0;
+   clock.Clear();
+   clock.Start();
+}
+
+int RegionProfiler::FindChild(int parent, const char *name)
+{
+   const vector<int> &children = regions[parent].children;
+   for (size_t i = 0; i < children.size(); i++)
+   {
+      const char *cname = regions[children[i]].name;
+      if (cname == name || strcmp(cname, name) == 0) { return children[i]; }
+   }
+
+   Region r;
+   r.name = name;
+   r.parent = parent;
+   r.calls = 0;
+   r.time = r.start = 0.0;
+   regions.push_back(r);
+   const int id = regions.size() - 1;
+   regions[parent].children.push_back(id);
+   return id;
+}
+
+void RegionProfiler::Begin(const char *name)
+{
+   if (paused) { return; }
+#ifdef _OPENMP
+   if (omp_in_parallel()) { return; }
+#endif
+   current = FindChild(current, name);
+   regions[current].calls++;
+   regions[current].start = clock.RealTime();
+}
+
+void RegionProfiler::End()
+{
+   if (paused) { return; }
+#ifdef _OPENMP
+   if (omp_in_parallel()) { return; }
+#endif
+   MFEM_VERIFY(current > 0, "No region to end.");
+   Region &r = regions[current];
+   r.time += clock.RealTime() - r.start;
+   current = r.parent;
+}
+
+void RegionProfiler::Record(const char *name, double time)
+{
+   if (paused) { return; }
+#ifdef _OPENMP
+   if (omp_in_parallel()) { return; }
+#endif
+   Region &r = regions[FindChild(current, name)];
+   r.calls++;
+   r.time += time;
+}
+
+double RegionProfiler::GetTotalTime(const char *name) const
+{
+   double time = 0.0;
+   for (size_t r = 1; r < regions.size(); r++)
+   {
+      if (strcmp(regions[r].name, name) == 0) { time += regions[r].time; }
+   }
+   return time;
+}
+
+int RegionProfiler::GetTotalCalls(const char *name) const
+{
+   int calls = 0;
+   for (size_t r = 1; r < regions.size(); r++)
+   {
+      if (strcmp(regions[r].name, name) == 0) { calls += regions[r].calls; }
+   }
+   return calls;
+}
+
+void RegionProfiler::Save(ostream &os) const
+{
+   const double now = clock.RealTime();
+   vector<double> time(regions.size());
+   for (size_t r = 0; r < regions.size(); r++) { time[r] = regions[r].time; }
+   for (int r = current; r > 0; r = regions[r].parent)
+   {
+      time[r] += now - regions[r].start;
+   }
+
+   // The parents are created before their children, so they come first.
+   WriteBinary(os, (int) regions.size());
+   for (size_t r = 1; r < regions.size(); r++)
+   {
+      const int length = strlen(regions[r].name);
+      WriteBinary(os, regions[r].parent);
+      WriteBinary(os, length);
+      os.write(regions[r].name, length);
+      WriteBinary(os, regions[r].calls);
+      WriteBinary(os, time[r]);
+   }
+}
+
+void RegionProfiler::Load(istream &is)
+{
+   int n;
+   ReadBinary(is, n);
+   // Index of each saved region in this profiler.
+   vector<int> id(n);
+   id[0] = 0;
+   for (int r = 1; r < n; r++)
+   {
+      int parent, length, calls;
+      double time;
+      ReadBinary(is, parent);
+      ReadBinary(is, length);
+      MFEM_VERIFY(parent >= 0 && parent < r && length >= 0,
+                  "Error reading the checkpoint file.");
+      string name(length, ' ');
+      if (length > 0) { is.read(&name[0], length); }
+      ReadBinary(is, calls);
+      ReadBinary(is, time);
+
+      // FindChild keeps the name pointer of a new region.
+      loaded_names.push_back(name);
+      const int old_size = regions.size();
+      id[r] = FindChild(id[parent], loaded_names.back().c_str());
+      if ((int) regions.size() == old_size) { loaded_names.pop_back(); }
+      regions[id[r]].calls += calls;
+      regions[id[r]].time += time;
+   }
+}
+
+string RegionProfiler::Path(int r) const
+{
+   string path = regions[r].name;
+   for (int p = regions[r].parent; p > 0; p = regions[p].parent)
+   {
+      path = string(regions[p].name) + "/" + path;
+   }
+   return path;
+}
+
+void RegionProfiler::PrintTree(ostream &out, int r, int depth,
+                               const vector<Stats> &stats) const
+{
+   if (r > 0)
+   {
+      const Stats &st = stats[r - 1];
+      const string name = string(2 * (depth - 1), ' ') + regions[r].name;
+      out << setw(36) << left << name << right
+          << setw(9) << st.calls
+          << setw(12) << st.tmin << setw(12) << st.tavg << setw(12) << st.tmax
+          << setw(9) << ((st.tavg > 0.0) ? st.tmax / st.tavg : 1.0) << '\n';
+   }
+   const vector<int> &children = regions[r].children;
+   for (size_t c = 0; c < children.size(); c++)
+   {
+      PrintTree(out, children[c], depth + 1, stats);
+   }
+}
+
+void RegionProfiler::PrintTable(ostream &out, const char *title,
+                                const vector<Stats> &stats) const
+{
+   out << title;
+   out << setw(36) << left << "region" << right << setw(9) << "calls"
+       << setw(12) << "min" << setw(12) << "avg" << setw(12) << "max"
+       << setw(9) << "max/avg" << '\n';
+   const ios::fmtflags flags = out.flags();
+   out << fixed << setprecision(4);
+   PrintTree(out, 0, 0, stats);
+   out.flags(flags);
+   out << flush;
+}
+
+#ifdef MFEM_USE_MPI
+void RegionProfiler::Gather(MPI_Comm comm, vector<Stats> &stats) const
+{
+   MFEM_VERIFY(current == 0, "Regions are still open.");
+   int myid, nranks;
+   MPI_Comm_rank(comm, &myid);
+   MPI_Comm_size(comm, &nranks);
+
+   // The paths of rank 0, separated by newlines.
+   string paths;
+   if (myid == 0)
+   {
+      for (size_t r = 1; r < regions.size(); r++) { paths += Path(r) + '\n'; }
+   }
+   int length = paths.size();
+   MPI_Bcast(&length, 1, MPI_INT, 0, comm);
+   paths.resize(length);
+   MPI_Bcast(&paths[0], length, MPI_CHAR, 0, comm);
+
+   // Local times and calls, in the order of the paths of rank 0.
+   map<string, int> local;
+   for (size_t r = 1; r < regions.size(); r++) { local[Path(r)] = r; }
+   vector<string> names;
+   vector<double> time, tmin, tmax, tsum;
+   vector<int> calls, cmax;
+   size_t begin = 0, end;
+   while ((end = paths.find('\n', begin)) != string::npos)
+   {
+      names.push_back(paths.substr(begin, end - begin));
+      map<string, int>::const_iterator it = local.find(names.back());
+      time.push_back((it != local.end()) ? regions[it->second].time : 0.0);
+      calls.push_back((it != local.end()) ? regions[it->second].calls : 0);
+      begin = end + 1;
+   }
+   // One extra entry, so that the data pointers are valid also for n = 0.
+   const int n = time.size();
+   tmin.resize(n + 1); tmax.resize(n + 1); tsum.resize(n + 1);
+   cmax.resize(n + 1);
+   time.push_back(0.0); calls.push_back(0);
+   MPI_Reduce(&time[0], &tmin[0], n, MPI_DOUBLE, MPI_MIN, 0, comm);
+   MPI_Reduce(&time[0], &tmax[0], n, MPI_DOUBLE, MPI_MAX, 0, comm);
+   MPI_Reduce(&time[0], &tsum[0], n, MPI_DOUBLE, MPI_SUM, 0, comm);
+   MPI_Reduce(&calls[0], &cmax[0], n, MPI_INT, MPI_MAX, 0, comm);
+
+   stats.clear();
+   if (myid != 0) { return; }
+   stats.resize(n);
+   for (int i = 0; i < n; i++)
+   {
+      stats[i].path  = names[i];
+      stats[i].calls = cmax[i];
+      stats[i].tmin  = tmin[i];
+      stats[i].tavg  = tsum[i] / nranks;
+      stats[i].tmax  = tmax[i];
+   }
+}
+
+void RegionProfiler::Print(MPI_Comm comm, ostream &out) const
+{
+   vector<Stats> stats;
+   Gather(comm, stats);
+   int myid, nranks;
+   MPI_Comm_rank(comm, &myid);
+   MPI_Comm_size(comm, &nranks);
+   if (myid != 0) { return; }
+
+   ostringstream title;
+   title << "\nRegion profile (inclusive seconds, over " << nranks
+         << " ranks):\n";
+   PrintTable(out, title.str().c_str(), stats);
+}
+#endif
+
+void RegionProfiler::Gather(vector<Stats> &stats) const
+{
+   MFEM_VERIFY(current == 0, "Regions are still open.");
+   const int n = regions.size() - 1;
+   stats.resize(n);
+   for (int r = 1; r <= n; r++)
+   {
+      Stats &st = stats[r - 1];
+      st.path  = Path(r);
+      st.calls = regions[r].calls;
+      st.tmin  = st.tavg = st.tmax = regions[r].time;
+   }
+}
+
+void RegionProfiler::Print(ostream &out) const
+{
+   vector<Stats> stats;
+   Gather(stats);
+   PrintTable(out, "\nRegion profile (inclusive seconds):\n", stats);
+}
+
+double StreamTriadBandwidth(int size, int trials)
+{
+   // The arrays are initialized by the threads that use them (first touch).
+   Vector a(size), b(size), c(size);
+   double *ad = a.GetData(), *bd = b.GetData(), *cd = c.GetData();
+   #pragma omp parallel for num_threads(GetNumThreads()) schedule(static)
+   for (int i = 0; i < size; i++)
+   {
+      ad[i] = 0.0; bd[i] = 1.0; cd[i] = 2.0;
+   }
+
+   const double s = 3.0;
+   double best = numeric_limits<double>::infinity();
+   StopWatch timer;
+   for (int t = 0; t < trials; t++)
+   {
+      timer.Clear();
+      timer.Start();
+      #pragma omp parallel for num_threads(GetNumThreads()) schedule(static)
+      for (int i = 0; i < size; i++) { ad[i] = bd[i] + s * cd[i]; }
+      timer.Stop();
+      best = min(best, timer.RealTime());
+   }
+   // Two arrays are read and one is written.
+   return 3.0 * sizeof(double) * size / best;
+}
+
+long GetLastLevelCacheSize()
+{
+   long size = 0;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+   size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+#ifdef _SC_LEVEL2_CACHE_SIZE
+   if (size <= 0) { size = sysconf(_SC_LEVEL2_CACHE_SIZE); }
+#endif
+   return max(size, 0L);
+}
+
+long MemoryReport::GetTotal() const
+{
+   long total = 0;
+   for (size_t i = 0; i < bytes.size(); i++) { total += bytes[i]; }
+   return total;
+}
+
+void MemoryReport::PrintTable(ostream &out, const string &title,
+                              const vector<long> &vmin,
+                              const vector<long> &vmax) const
+{
+   const double MB = 1024.0 * 1024.0;
+   const size_t n = names.size();
+   out << title;
+   out << "   " << setw(36) << left << "Structure" << right
+       << setw(12) << "min (MB)" << setw(12) << "max (MB)" << '\n';
+   out << fixed << setprecision(2);
+   for (size_t i = 0; i <= n + 1; i++)
+   {
+      if (i == n) { out << "   " << string(60, '-') << '\n'; }
+      const char *name = (i < n) ? names[i].c_str() :
+                         (i == n) ? "Total" : "Peak RSS (VmHWM)";
+      out << "   " << setw(36) << left << name << right;
+      if (vmin[i] < 0) { out << setw(12) << "n/a" << setw(12) << "n/a"; }
+      else { out << setw(12) << vmin[i] / MB << setw(12) << vmax[i] / MB; }
+      out << '\n';
+   }
+   out.unsetf(ios::floatfield);
+   out << setprecision(6) << flush;
+}
+
+#ifdef MFEM_USE_MPI
+void MemoryReport::Print(MPI_Comm comm, ostream &out, const char *title) const
+{
+   int myid, nranks;
+   MPI_Comm_rank(comm, &myid);
+   MPI_Comm_size(comm, &nranks);
+
+   // The entries, then the total and the peak RSS.
+   vector<long> local(bytes), vmin(bytes.size() + 2), vmax(bytes.size() + 2);
+   local.push_back(GetTotal());
+   local.push_back(GetPeakResidentSetSize());
+   const int n = local.size();
+   MPI_Reduce(&local[0], &vmin[0], n, MPI_LONG, MPI_MIN, 0, comm);
+   MPI_Reduce(&local[0], &vmax[0], n, MPI_LONG, MPI_MAX, 0, comm);
+   if (myid != 0) { return; }
+
+   ostringstream os;
+   os << '\n' << title << " (per rank, over " << nranks << " ranks):\n";
+   PrintTable(out, os.str(), vmin, vmax);
+}
+#endif
+
+void MemoryReport::Print(ostream &out, const char *title) const
+{
+   vector<long> local(bytes);
+   local.push_back(GetTotal());
+   local.push_back(GetPeakResidentSetSize());
+   PrintTable(out, '\n' + string(title) + ":\n", local, local);
+}
+
+long MemoryUsage(const Vector &v)
+{
+   return v.Size() * (long) sizeof(double);
+}
+
+long MemoryUsage(const DenseTensor &t)
+{
+   return (long) t.SizeI() * t.SizeJ() * t.SizeK() * sizeof(double);
+}
+
+long MemoryUsage(const SparseMatrix &m)
+{
+   const long nnz = m.NumNonZeroElems();
+   if (!m.Finalized())
+   {
+      // One list node per entry: the value, the column and the link.
+      return nnz * (long) (sizeof(double) + sizeof(int) + sizeof(void *)) +
+             m.Height() * (long) sizeof(void *);
+   }
+   return nnz * (long) (sizeof(double) + sizeof(int)) +
+          (m.Height() + 1) * (long) sizeof(int);
+}
+
+long MemoryUsage(const Table &t)
+{
+   return (t.Size() + 1 + (long) t.Size_of_connections()) * sizeof(int);
+}
+
+long MemoryUsage(FiniteElementSpace &fes)
+{
+   long b = MemoryUsage(fes.GetElementToDofTable());
+   const SparseMatrix *R = fes.GetRestrictionMatrix();
+   if (R) { b += MemoryUsage(*R); }
+   return b;
+}
+
+long GetPeakResidentSetSize()
+{
+   ifstream status("/proc/self/status");
+   string line;
+   while (getline(status, line))
+   {
+      if (line.compare(0, 6, "VmHWM:") != 0) { continue; }
+      // The value is in kB.
+      istringstream is(line.substr(6));
+      long kb;
+      if (is >> kb) { return 1024 * kb; }
+   }
+   return -1;
+}
+
+void BenchReport::AddEntry(const string &key, const string &value, bool str)
+{
+   keys.push_back(key);
+   values.push_back(value);
+   is_string.push_back(str);
+}
+
+void BenchReport::Add(const string &key, double value)
+{
+   ostringstream os;
+   if (IsFinite(value)) { os << setprecision(10) << value; }
+   AddEntry(key, os.str(), false);
+}
+
+void BenchReport::Add(const string &key, long value)
+{
+   ostringstream os;
+   os << value;
+   AddEntry(key, os.str(), false);
+}
+
+void BenchReport::Add(const vector<RegionProfiler::Stats> &stats)
+{
+   for (size_t i = 0; i < stats.size(); i++)
+   {
+      const string prefix = "region." + stats[i].path;
+      Add(prefix + ".calls", stats[i].calls);
+      Add(prefix + ".min", stats[i].tmin);
+      Add(prefix + ".avg", stats[i].tavg);
+      Add(prefix + ".max", stats[i].tmax);
+   }
+}
+
+// Quotes the string s, doubling the quote characters (CSV) or escaping them
+// and the backslashes (JSON).
+static string Quote(const string &s, bool csv)
+{
+   string q = "\"";
+   for (size_t i = 0; i < s.size(); i++)
+   {
+      if (s[i] == '"') { q += csv ? "\"\"" : "\\\""; }
+      else if (s[i] == '\\' && !csv) { q += "\\\\"; }
+      else { q += s[i]; }
+   }
+   return q + '"';
+}
+
+void BenchReport::Write(const char *filename) const
+{
+   const string name(filename);
+   const bool csv = name.size() >= 4 &&
+                    name.compare(name.size() - 4, 4, ".csv") == 0;
+   ofstream out(filename);
+   MFEM_VERIFY(out, "Cannot open the benchmark report " << name);
+
+   const int n = keys.size();
+   if (csv)
+   {
+      for (int i = 0; i < n; i++)
+      { out << (i ? "," : "") << Quote(keys[i], true); }
+      out << '\n';
+      for (int i = 0; i < n; i++)
+      {
+         out << (i ? "," : "")
+             << (is_string[i] ? Quote(values[i], true) : values[i]);
+      }
+      out << '\n';
+   }
+   else
+   {
+      out << "{\n";
+      for (int i = 0; i < n; i++)
+      {
+         const string value = is_string[i] ? Quote(values[i], false) :
+                              values[i].empty() ? "null" : values[i];
+         out << "  " << Quote(keys[i], false) << ": " << value
+             << ((i < n - 1) ? ",\n" : "\n");
+      }
+      out << "}\n";
+   }
+   MFEM_VERIFY(out, "Error writing the benchmark report " << name);
+}
+
+} // namespace hydrodynamics
+
+} // namespace mfem
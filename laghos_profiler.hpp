@@ -0,0 +1,220 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#ifndef MFEM_LAGHOS_PROFILER
+#define MFEM_LAGHOS_PROFILER
+
+#include "mfem.hpp"
+#include <iostream>
+#include <list>
+#include <string>
+#include <vector>
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+// Nested timing regions. Each region is identified by its name and the chain
+// of enclosing regions, so the same name may appear in several places of the
+// tree; GetTotalTime adds up all of them. The names must be string literals (or
+// otherwise outlive the profiler). Calls made inside OpenMP parallel regions
+// are ignored, i.e., only the master thread of the zone loops is profiled.
+class RegionProfiler
+{
+private:
+   struct Region
+   {
+      const char *name;
+      int parent, calls;
+      double time, start;
+      std::vector<int> children;
+   };
+
+   // Region 0 is the root, which encloses the whole run.
+   std::vector<Region> regions;
+   int current;
+   mutable StopWatch clock;
+   // Names of the regions that were created by Load.
+   std::list<std::string> loaded_names;
+   bool paused;
+
+   int FindChild(int parent, const char *name);
+   // Full name of the region, with the enclosing regions separated by '/'.
+   std::string Path(int r) const;
+
+public:
+   // Statistics of one region over the ranks.
+   struct Stats
+   {
+      std::string path;
+      int calls;
+      double tmin, tavg, tmax;
+   };
+
+   RegionProfiler();
+
+   // Starts the named region, as a child of the current one.
+   void Begin(const char *name);
+   // Ends the current region.
+   void End();
+   // Adds a call of the named region, as a child of the current one, with the
+   // given time. Used for work that is timed elsewhere, e.g., on other threads.
+   void Record(const char *name, double time);
+
+   // Begin, End and Record are ignored between Pause and Resume, e.g., for
+   // work that repeats a part of a checkpointed run, which is already included
+   // in the loaded times.
+   void Pause() { paused = true; }
+   void Resume() { paused = false; }
+
+   // Total time (seconds) spent in all regions with the given name, on this
+   // rank.
+   double GetTotalTime(const char *name) const;
+   // Number of times the regions with the given name were entered.
+   int GetTotalCalls(const char *name) const;
+
+   // Binary I/O of the regions, for the checkpoints. The open regions are
+   // saved with their time so far. Load adds the saved calls and times to the
+   // matching regions, which are created if needed, so that the profile of a
+   // restarted run also covers the run that wrote the checkpoint.
+   void Save(std::ostream &os) const;
+   void Load(std::istream &is);
+
+   // Collects the inclusive times of all regions, except the root: the min,
+   // average and max over the ranks, and the number of calls (max over the
+   // ranks). The regions are the ones of rank 0, in the order of creation;
+   // regions that appear only on other ranks are not included. The result is
+   // set only on rank 0. The serial version uses the times of this process.
+   // Must be called outside of all regions but the root.
+#ifdef MFEM_USE_MPI
+   void Gather(MPI_Comm comm, std::vector<Stats> &stats) const;
+#endif
+   void Gather(std::vector<Stats> &stats) const;
+
+   // Prints the result of Gather as a tree, with the imbalance ratio max/avg.
+#ifdef MFEM_USE_MPI
+   void Print(MPI_Comm comm, std::ostream &out) const;
+#endif
+   void Print(std::ostream &out) const;
+
+private:
+   // Prints region r and its subtree. The data of region r is stats[r-1].
+   void PrintTree(std::ostream &out, int r, int depth,
+                  const std::vector<Stats> &stats) const;
+   void PrintTable(std::ostream &out, const char *title,
+                   const std::vector<Stats> &stats) const;
+};
+
+// The profiler of the run.
+extern RegionProfiler profiler;
+
+// Memory bandwidth of this process in bytes per second, measured with the
+// STREAM triad a = b + s c on arrays of the given size, which should be well
+// beyond the cache sizes. Returns the best of the given number of trials. The
+// loops use the threads of the zone loops, see GetNumThreads.
+double StreamTriadBandwidth(int size, int trials);
+
+// Size in bytes of the last level data cache of this node, or 0 when it is not
+// known.
+long GetLastLevelCacheSize();
+
+// Profiles the enclosing scope as the named region.
+class ProfileRegion
+{
+public:
+   ProfileRegion(const char *name) { profiler.Begin(name); }
+   ~ProfileRegion() { profiler.End(); }
+};
+
+// Sizes (bytes) of the named data structures of this rank, e.g., of the
+// operator and of the state, reported with their min and max over the ranks.
+// All ranks must add the same names, in the same order.
+class MemoryReport
+{
+private:
+   std::vector<std::string> names;
+   std::vector<long> bytes;
+
+   // Prints the entries, their total and the peak RSS. The values are the min
+   // and max over the ranks, in the order of the entries.
+   void PrintTable(std::ostream &out, const std::string &title,
+                   const std::vector<long> &vmin,
+                   const std::vector<long> &vmax) const;
+
+public:
+   void Add(const std::string &name, long b)
+   { names.push_back(name); bytes.push_back(b); }
+   void Clear() { names.clear(); bytes.clear(); }
+
+   // Sum of the entries of this rank.
+   long GetTotal() const;
+
+   // Prints the entries in MB, with the peak resident set size of the
+   // processes, see GetPeakResidentSetSize. The MPI version is collective and
+   // prints on rank 0.
+#ifdef MFEM_USE_MPI
+   void Print(MPI_Comm comm, std::ostream &out, const char *title) const;
+#endif
+   void Print(std::ostream &out, const char *title) const;
+};
+
+// Sizes (bytes) of the data arrays of MFEM objects. A SparseMatrix that is not
+// finalized is counted with its row lists. For a FiniteElementSpace, these are
+// the element-to-dof table and the restriction matrix, if any.
+long MemoryUsage(const Vector &v);
+long MemoryUsage(const DenseTensor &t);
+long MemoryUsage(const SparseMatrix &m);
+long MemoryUsage(const Table &t);
+long MemoryUsage(FiniteElementSpace &fes);
+
+// Peak resident set size (bytes) of this process, from the VmHWM entry of
+// /proc/self/status; -1 where that is not available.
+long GetPeakResidentSetSize();
+
+// Flat record of named values of a run, written as a JSON object or, when the
+// file name ends with ".csv", as a CSV header line followed by a value line.
+// The entries are written in the order they were added. Values that are not
+// finite are written as null (JSON) or as empty fields (CSV).
+class BenchReport
+{
+private:
+   std::vector<std::string> keys, values;
+   std::vector<bool> is_string;
+
+   void AddEntry(const std::string &key, const std::string &value, bool str);
+
+public:
+   void Add(const std::string &key, const std::string &value)
+   { AddEntry(key, value, true); }
+   void Add(const std::string &key, const char *value)
+   { AddEntry(key, value, true); }
+   void Add(const std::string &key, double value);
+   void Add(const std::string &key, long value);
+   void Add(const std::string &key, int value) { Add(key, (long) value); }
+
+   // Adds the entries region.<path>.{calls,min,avg,max}.
+   void Add(const std::vector<RegionProfiler::Stats> &stats);
+
+   void Write(const char *filename) const;
+};
+
+} // namespace hydrodynamics
+
+} // namespace mfem
+
+#endif // MFEM_LAGHOS_PROFILER
@@ -0,0 +1,224 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#include "laghos_snapshot.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef MFEM_USE_MPI
+
+using namespace std;
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+SnapshotWriter::SnapshotWriter(const string &basename_,
+                               ParFiniteElementSpace &h1,
+                               ParFiniteElementSpace &l2,
+                               bool single_precision,
+                               int restart_cycle)
+   : basename(basename_), comm(h1.GetComm()),
+     dim(h1.GetMesh()->Dimension()), single(single_precision),
+     h1_vsize(h1.GetVSize()), l2_vsize(l2.GetVSize()), offset(0)
+{
+   int num_procs;
+   MPI_Comm_rank(comm, &myid);
+   MPI_Comm_size(comm, &num_procs);
+
+   const int nzones = h1.GetNE(),
+             h1dofs_cnt = (nzones > 0) ? h1.GetFE(0)->GetDof() : 0,
+             l2dofs_cnt = (nzones > 0) ? l2.GetFE(0)->GetDof() : 0;
+   vector<int> topology(4 + nzones * h1dofs_cnt);
+   topology[0] = nzones;
+   topology[1] = h1dofs_cnt;
+   topology[2] = l2dofs_cnt;
+   topology[3] = h1.GetNDofs();
+   Array<int> dofs;
+   for (int z = 0; z < nzones; z++)
+   {
+      h1.GetElementDofs(z, dofs);
+      for (int i = 0; i < h1dofs_cnt; i++)
+      {
+         topology[4 + z*h1dofs_cnt + i] = dofs[i];
+      }
+   }
+
+   // Offsets of the rank blocks in the topology and snapshot files.
+   const int value_bytes = single ? sizeof(float) : sizeof(double);
+   buffer.resize((2 * h1_vsize + 2 * l2_vsize) * value_bytes);
+   long long sizes[2] = { (long long) (topology.size() * sizeof(int)),
+                          (long long) buffer.size()
+                        };
+   long long offsets[2] = { 0, 0 };
+   MPI_Exscan(sizes, offsets, 2, MPI_LONG_LONG, MPI_SUM, comm);
+   if (myid == 0) { offsets[0] = offsets[1] = 0; }
+   offset = offsets[1];
+
+   WriteFile(basename + "_topology.bin", offsets[0],
+             reinterpret_cast<const char *>(&topology[0]),
+             (int) sizes[0]);
+
+   long long info[5] = { offsets[0], offsets[1], nzones, h1_vsize, l2_vsize };
+   vector<long long> all_info(myid == 0 ? 5 * num_procs : 0);
+   MPI_Gather(info, 5, MPI_LONG_LONG, myid == 0 ? &all_info[0] : NULL, 5,
+              MPI_LONG_LONG, 0, comm);
+   if (myid == 0)
+   {
+      ostringstream header;
+      header << "laghos_snapshots 1\n"
+             << "ranks " << num_procs << " dim " << dim
+             << " value_bytes " << value_bytes << '\n';
+      for (int r = 0; r < num_procs; r++)
+      {
+         header << "rank " << r;
+         for (int i = 0; i < 5; i++) { header << ' ' << all_info[5*r + i]; }
+         header << '\n';
+      }
+
+      // On restart, keep the snapshots written before the checkpoint.
+      const string index_name = basename + "_snapshots.idx";
+      string entries;
+      if (restart_cycle >= 0)
+      {
+         ifstream old_index(index_name.c_str());
+         string line, old_header;
+         while (getline(old_index, line))
+         {
+            if (line.compare(0, 9, "snapshot ") != 0)
+            {
+               old_header += line + '\n';
+               continue;
+            }
+            if (atoi(line.c_str() + 9) < restart_cycle)
+            {
+               entries += line + '\n';
+            }
+         }
+         if (old_header != header.str())
+         {
+            if (old_index.is_open())
+            {
+               cout << "The snapshot index " << index_name << " does not "
+                    << "match this run; its entries are dropped." << endl;
+            }
+            entries.clear();
+         }
+      }
+
+      ofstream index(index_name.c_str());
+      index << header.str() << entries;
+      MFEM_VERIFY(index, "Error writing the snapshot index.");
+   }
+}
+
+template <typename T>
+void SnapshotWriter::Pack(const Vector *const fields[4])
+{
+   T *out = reinterpret_cast<T *>(&buffer[0]);
+   for (int f = 0; f < 4; f++)
+   {
+      const Vector &u = *fields[f];
+      for (int i = 0; i < u.Size(); i++) { *(out++) = (T) u(i); }
+   }
+}
+
+void SnapshotWriter::WriteFile(const string &name, MPI_Offset off,
+                               const char *data, int size)
+{
+   MPI_File fh;
+   int err = MPI_File_open(comm, const_cast<char *>(name.c_str()),
+                           MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                           MPI_INFO_NULL, &fh);
+   MFEM_VERIFY(err == MPI_SUCCESS, "Cannot open " << name);
+   // Drop the contents of an older file with the same name.
+   MPI_File_set_size(fh, 0);
+   err = MPI_File_write_at_all(fh, off, const_cast<char *>(data), size,
+                               MPI_BYTE, MPI_STATUS_IGNORE);
+   MFEM_VERIFY(err == MPI_SUCCESS, "Error writing " << name);
+   MPI_File_close(&fh);
+}
+
+string SnapshotWriter::Pack(int cycle, const Vector &x, const Vector &v,
+                            const Vector &e, const Vector &rho)
+{
+   MFEM_VERIFY(x.Size() == h1_vsize && v.Size() == h1_vsize &&
+               e.Size() == l2_vsize && rho.Size() == l2_vsize,
+               "Snapshot field size mismatch.");
+   const Vector *const fields[4] = { &x, &v, &e, &rho };
+   if (single) { Pack<float>(fields); }
+   else        { Pack<double>(fields); }
+
+   return FileName(cycle);
+}
+
+string SnapshotWriter::FileName(int cycle) const
+{
+   ostringstream name;
+   name << basename << "_snapshot_" << setfill('0') << setw(6) << cycle
+        << ".bin";
+   return name.str();
+}
+
+void SnapshotWriter::AddToIndex(int cycle, double time) const
+{
+   if (myid != 0) { return; }
+   ofstream index((basename + "_snapshots.idx").c_str(), ios::app);
+   index << "snapshot " << cycle << ' ' << setprecision(17) << time << ' '
+         << FileName(cycle) << '\n';
+}
+
+void SnapshotWriter::Save(int cycle, double time, const Vector &x,
+                          const Vector &v, const Vector &e, const Vector &rho)
+{
+   const string name = Pack(cycle, x, v, e, rho);
+   WriteFile(name, offset, buffer.empty() ? NULL : &buffer[0],
+             (int) buffer.size());
+   AddToIndex(cycle, time);
+}
+
+void SnapshotWriter::SaveLocal(int cycle, const Vector &x, const Vector &v,
+                               const Vector &e, const Vector &rho)
+{
+   const string name = Pack(cycle, x, v, e, rho);
+   // The blocks have the same offsets in all snapshots, so an older file with
+   // the same name is simply overwritten.
+   const int fd = open(name.c_str(), O_WRONLY | O_CREAT, 0644);
+   MFEM_VERIFY(fd >= 0, "Cannot open " << name << ": " << strerror(errno));
+   size_t done = 0;
+   while (done < buffer.size())
+   {
+      const ssize_t n = pwrite(fd, &buffer[done], buffer.size() - done,
+                               (off_t) (offset + done));
+      MFEM_VERIFY(n > 0, "Error writing " << name << ": " << strerror(errno));
+      done += n;
+   }
+   close(fd);
+}
+
+} // namespace hydrodynamics
+
+} // namespace mfem
+
+#endif // MFEM_USE_MPI
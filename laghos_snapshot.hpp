@@ -0,0 +1,108 @@
+// Copyright (c) 2017, Lawrence Livermore National Security, LLC. Produced at
+// the Lawrence Livermore National Laboratory. LLNL-CODE-734707. All Rights
+// reserved. See files LICENSE and NOTICE for details.
+//
+// This file is part of CEED, a collection of benchmarks, miniapps, software
+// libraries and APIs for efficient high-order finite element and spectral
+// element discretizations for exascale applications. For more information and
+// source code availability see http://github.com/ceed.
+//
+// The CEED research is supported by the Exascale Computing Project 17-SC-20-SC,
+// a collaborative effort of two U.S. Department of Energy organizations (Office
+// of Science and the National Nuclear Security Administration) responsible for
+// the planning and preparation of a capable exascale ecosystem, including
+// software, applications, hardware, advanced system engineering and early
+// testbed platforms, in support of the nation's exascale computing imperative.
+
+#ifndef MFEM_LAGHOS_SNAPSHOT
+#define MFEM_LAGHOS_SNAPSHOT
+
+#include "mfem.hpp"
+#include <string>
+#include <vector>
+
+#ifdef MFEM_USE_MPI
+
+namespace mfem
+{
+
+namespace hydrodynamics
+{
+
+// Aggregated binary output of the solution. The mesh topology does not change
+// in the Lagrangian motion, so it is written once, to <basename>_topology.bin.
+// Each snapshot then writes only the node coordinates and the rho, v and e
+// values, to <basename>_snapshot_<cycle>.bin. All ranks write their blocks to
+// the same file with collective MPI-IO, one after the other in rank order.
+//
+// The text index <basename>_snapshots.idx lists the byte offsets of the rank
+// blocks, which are the same in all snapshots, and one line per snapshot:
+//
+//    laghos_snapshots 1
+//    ranks <num_procs> dim <dim> value_bytes <4 or 8>
+//    rank <r> <topology offset> <snapshot offset> <zones> <H1 dofs> <L2 dofs>
+//    ...
+//    snapshot <cycle> <time> <file name>
+//
+// Topology block of a rank (int32): zones, H1 dofs per zone, L2 dofs per zone,
+// scalar H1 dofs, then the scalar H1 dofs of each zone in the rank numbering.
+// The L2 dofs of zone z are z * (L2 dofs per zone) + i.
+//
+// Snapshot block of a rank (float32 or float64): the H1 coordinates and the
+// velocity, each ordered by nodes (all x components, then all y ...), and the
+// L2 values of e and rho.
+class SnapshotWriter
+{
+private:
+   const std::string basename;
+   MPI_Comm comm;
+   int myid, dim;
+   const bool single;
+   const int h1_vsize, l2_vsize;
+   // Offset of the block of this rank in the snapshot files.
+   MPI_Offset offset;
+   // The values of one block, converted to the output precision.
+   std::vector<char> buffer;
+
+   // Packs the fields into the buffer and returns the name of the snapshot.
+   std::string Pack(int cycle, const Vector &x, const Vector &v,
+                    const Vector &e, const Vector &rho);
+   template <typename T> void Pack(const Vector *const fields[4]);
+   std::string FileName(int cycle) const;
+   // Collective write of size bytes of data to the file at offset off. The
+   // file is created or truncated.
+   void WriteFile(const std::string &name, MPI_Offset off,
+                  const char *data, int size);
+
+public:
+   // Collective. Writes the topology and the header of the index file. When
+   // restart_cycle >= 0, the entries of an existing index for the earlier
+   // cycles are kept, provided that its header is the same; the later ones
+   // are written again by the restarted run.
+   SnapshotWriter(const std::string &basename_, ParFiniteElementSpace &h1,
+                  ParFiniteElementSpace &l2, bool single_precision,
+                  int restart_cycle = -1);
+
+   // Collective. The grid functions are those of the H1 and L2 spaces above.
+   void Save(int cycle, double time, const Vector &x, const Vector &v,
+             const Vector &e, const Vector &rho);
+
+   // Same as Save, but each rank writes its block with POSIX I/O and without
+   // MPI calls, so that it can be called from a thread other than the main
+   // one. The snapshot is not added to the index; the caller does that with
+   // AddToIndex, once all ranks have written their blocks.
+   void SaveLocal(int cycle, const Vector &x, const Vector &v,
+                  const Vector &e, const Vector &rho);
+
+   // Rank 0 appends the entry of the snapshot to the index; the other ranks do
+   // nothing. An entry in the index marks a complete snapshot.
+   void AddToIndex(int cycle, double time) const;
+};
+
+} // namespace hydrodynamics
+
+} // namespace mfem
+
+#endif // MFEM_USE_MPI
+
+#endif // MFEM_LAGHOS_SNAPSHOT
@@ -15,6 +15,8 @@
 // testbed platforms, in support of the nation's exascale computing imperative.
 
 #include "laghos_solver.hpp"
+#include "laghos_checkpoint.hpp"
+#include <iomanip>
 
 #ifdef MFEM_USE_MPI
 
@@ -75,6 +77,256 @@ void VisualizeField(socketstream &sock, const char *vishost, int visport,
    while (connection_failed);
 }
 
+void PipelinedCGSolver::UpdateVectors()
+{
+   r.SetSize(width); u.SetSize(width); w.SetSize(width);
+   m.SetSize(width); n.SetSize(width); z.SetSize(width);
+   q.SetSize(width); s.SetSize(width); p.SetSize(width);
+}
+
+void PipelinedCGSolver::Mult(const Vector &b, Vector &x) const
+{
+   // r = b - A x, u = B r, w = A u.
+   if (iterative_mode)
+   {
+      oper->Mult(x, r);
+      subtract(b, r, r);
+   }
+   else
+   {
+      r = b;
+      x = 0.0;
+   }
+   if (prec) { prec->Mult(r, u); }
+   else      { u = r; }
+   oper->Mult(u, w);
+   z = 0.0; q = 0.0; s = 0.0; p = 0.0;
+
+   const int size = x.Size();
+   double *X = x.GetData(), *R = r.GetData(), *U = u.GetData();
+   double *W = w.GetData(), *M = m.GetData(), *N = n.GetData();
+   double *Z = z.GetData(), *Q = q.GetData(), *S = s.GetData();
+   double *P = p.GetData();
+
+   // Local parts of gamma = (u, r) and delta = (w, u).
+   double loc[2] = { r * u, w * u }, glob[2];
+   double gamma_old = 1.0, alpha = 1.0, r0 = 0.0;
+   MPI_Request request;
+   converged = 0;
+   for (int i = 0; true; i++)
+   {
+      MPI_Iallreduce(loc, glob, 2, MPI_DOUBLE, MPI_SUM, comm, &request);
+
+      // Overlapped with the reduction: m = B w, n = A m.
+      if (prec) { prec->Mult(w, m); }
+      else      { m = w; }
+      oper->Mult(m, n);
+
+      MPI_Wait(&request, MPI_STATUS_IGNORE);
+      const double gamma = glob[0], delta = glob[1];
+      if (print_level == 1)
+      {
+         cout << "   Iteration : " << i << "  (B r, r) = " << gamma << endl;
+      }
+      if (gamma < 0.0)
+      {
+         if (print_level >= 0)
+         {
+            cout << "PCG: The preconditioner is not positive definite. "
+                 << "(B r, r) = " << gamma << endl;
+         }
+         final_iter = i;
+         final_norm = gamma;
+         return;
+      }
+      if (i == 0) { r0 = std::max(gamma*rel_tol*rel_tol, abs_tol*abs_tol); }
+      final_iter = i;
+      final_norm = sqrt(gamma);
+      if (gamma <= r0) { converged = 1; break; }
+      if (i == max_iter) { break; }
+
+      const double beta = (i > 0) ? gamma / gamma_old : 0.0;
+      alpha = (i > 0) ? gamma / (delta - beta * gamma / alpha) : gamma / delta;
+      gamma_old = gamma;
+
+      // All vector updates and the next local inner products in one sweep.
+      loc[0] = loc[1] = 0.0;
+      for (int j = 0; j < size; j++)
+      {
+         Z[j] = N[j] + beta * Z[j];
+         Q[j] = M[j] + beta * Q[j];
+         S[j] = W[j] + beta * S[j];
+         P[j] = U[j] + beta * P[j];
+         X[j] += alpha * P[j];
+         R[j] -= alpha * S[j];
+         U[j] -= alpha * Q[j];
+         W[j] -= alpha * Z[j];
+         loc[0] += R[j] * U[j];
+         loc[1] += W[j] * U[j];
+      }
+   }
+
+   if (print_level == 1)
+   {
+      cout << "Number of pipelined PCG iterations: " << final_iter << endl;
+   }
+   if (print_level >= 0 && !converged)
+   {
+      cout << "Pipelined PCG: No convergence!" << endl;
+   }
+}
+
+double RecycledSubspace::InitialGuess(const Vector &b, const Vector &c,
+                                      Vector &x)
+{
+   const int n = b.Size();
+
+   // One reduction: g_j = x_j^T b, (c, b), and x_j^T A x_k for the pending k.
+   const int cnt = size + 1 + ((pending >= 0) ? size : 0);
+   for (int j = 0; j < size; j++)
+   {
+      const Vector xj(xs.GetData() + j*n, n);
+      loc(j) = xj * b;
+      if (pending >= 0) { loc(size + 1 + j) = xj * Ax; }
+   }
+   loc(size) = c * b;
+   MPI_Allreduce(loc.GetData(), g.GetData(), cnt, MPI_DOUBLE, MPI_SUM, comm);
+   const double cb = g(size);
+   if (pending >= 0)
+   {
+      for (int j = 0; j < size; j++)
+      {
+         G(pending, j) = G(j, pending) = g(size + 1 + j);
+      }
+      pending = -1;
+   }
+   if (size == 0) { return cb; }
+
+   // Cholesky factorization G = L L^T. Nearly linearly dependent solutions
+   // (small pivots) are skipped, i.e., their columns of L stay zero.
+   L = 0.0;
+   for (int j = 0; j < size; j++)
+   {
+      double d = G(j, j);
+      for (int l = 0; l < j; l++) { d -= L(j, l) * L(j, l); }
+      if (d <= 1e-10 * G(j, j)) { continue; }
+      L(j, j) = sqrt(d);
+      for (int i = j + 1; i < size; i++)
+      {
+         double v = G(i, j);
+         for (int l = 0; l < j; l++) { v -= L(i, l) * L(j, l); }
+         L(i, j) = v / L(j, j);
+      }
+   }
+
+   // Solve L L^T c = g, overwriting g with c.
+   for (int j = 0; j < size; j++)
+   {
+      if (L(j, j) == 0.0) { g(j) = 0.0; continue; }
+      for (int l = 0; l < j; l++) { g(j) -= L(j, l) * g(l); }
+      g(j) /= L(j, j);
+   }
+   for (int j = size - 1; j >= 0; j--)
+   {
+      if (L(j, j) == 0.0) { continue; }
+      for (int l = j + 1; l < size; l++) { g(j) -= L(l, j) * g(l); }
+      g(j) /= L(j, j);
+   }
+
+   x = 0.0;
+   for (int j = 0; j < size; j++)
+   {
+      const double *xj = xs.GetData() + j*n;
+      for (int i = 0; i < n; i++) { x(i) += g(j) * xj[i]; }
+   }
+   return cb;
+}
+
+void RecycledSubspace::Add(const Vector &x, const Vector &b, const Vector &r)
+{
+   MFEM_VERIFY(pending < 0, "The previous solution was not projected yet.");
+   const int n = x.Size();
+   if (xs.Size() != max_size * n)
+   {
+      xs.SetSize(max_size * n);
+      Ax.SetSize(n);
+      size = oldest = 0;
+   }
+
+   int k;
+   if (size < max_size) { k = size++; }
+   else { k = oldest; oldest = (oldest + 1) % max_size; }
+
+   Vector xk(xs.GetData() + k*n, n);
+   xk = x;
+   subtract(b, r, Ax);
+   pending = k;
+}
+
+void RecycledSubspace::Save(std::ostream &os) const
+{
+   WriteBinary(os, max_size);
+   WriteBinary(os, size);
+   WriteBinary(os, oldest);
+   WriteBinary(os, pending);
+   WriteBinary(os, Ax.Size());
+   WriteBinaryArray(os, xs.GetData(), xs.Size());
+   WriteBinaryArray(os, Ax.GetData(), Ax.Size());
+   WriteBinaryArray(os, G.Data(), max_size * max_size);
+}
+
+void RecycledSubspace::Load(std::istream &is)
+{
+   int stored_max_size, n;
+   ReadBinary(is, stored_max_size);
+   MFEM_VERIFY(stored_max_size == max_size, "The checkpoint was written with "
+               "a different number of recycled velocity solutions.");
+   ReadBinary(is, size);
+   ReadBinary(is, oldest);
+   ReadBinary(is, pending);
+   // The solution length, which is 0 before the first Add.
+   ReadBinary(is, n);
+   xs.SetSize(max_size * n);
+   Ax.SetSize(n);
+   ReadBinaryArray(is, xs.GetData(), xs.Size());
+   ReadBinaryArray(is, Ax.GetData(), Ax.Size());
+   ReadBinaryArray(is, G.Data(), max_size * max_size);
+}
+
+ZoneLoopWorkspace::ZoneLoopWorkspace(int dim, int nqp, int nzones_batch,
+                                     int h1dofs_cnt, int l2dofs_cnt,
+                                     bool fused, bool interleaved)
+   : gamma_b(nqp * nzones_batch), rho_b(nqp * nzones_batch),
+     e_b(nqp * nzones_batch), p_b(nqp * nzones_batch),
+     cs_b(nqp * nzones_batch), Jpr_b(new DenseTensor[nzones_batch]),
+     e_vals(nqp), rho0DetJ0w_z(nqp), e_loc(l2dofs_cnt),
+     vector_vals(h1dofs_cnt * dim),
+     Jpi(dim), sgrad_v(dim), Jinv(dim), stress(dim), stressJiT(dim),
+     vecvalMat(vector_vals.GetData(), h1dofs_cnt, dim),
+     grad_v_ref(dim, dim, nqp), J0_ref(dim, dim, nqp), Jac0inv(dim),
+     L2dofs(l2dofs_cnt), H1dofs(h1dofs_cnt * dim),
+     loc_rhs(l2dofs_cnt), loc_de(l2dofs_cnt)
+{
+   for (int z = 0; z < nzones_batch; z++) { Jpr_b[z].SetSize(dim, dim, nqp); }
+   if (fused)
+   {
+      stress_b.SetSize(nqp * nzones_batch * dim * dim);
+      stress_b = 0.0;
+   }
+   if (interleaved)
+   {
+      const int W = nzones_batch, dd = dim * dim;
+      Jpr_w.SetSize(dd * nqp * W);
+      grad_v_w.SetSize(dd * nqp * W);
+      J0_w.SetSize(dd * nqp * W);
+      Jinv_w.SetSize(dd * W);
+      detJ_w.SetSize(W);
+      sgrad_v_w.SetSize(dd * W);
+      Jac0inv_w.SetSize(dd * W);
+      visc_w.SetSize(W);
+   }
+}
+
 LagrangianHydroOperator::LagrangianHydroOperator(int size,
                                                  ParFiniteElementSpace &h1_fes,
                                                  ParFiniteElementSpace &l2_fes,
@@ -83,7 +335,14 @@ LagrangianHydroOperator::LagrangianHydroOperator(int size,
                                                  int source_type_, double cfl_,
                                                  Coefficient *material_,
                                                  bool visc, bool pa,
-                                                 double cgt, int cgiter)
+                                                 double cgt, int cgiter,
+                                                 bool pcg, int cg_recycle,
+                                                 int cheb_deg, bool amg,
+                                                 int simd_width, bool fused,
+                                                 int energy_solver,
+                                                 bool mixed_precision,
+                                                 bool recompute_jac0inv_,
+                                                 bool dense_mass_)
    : TimeDependentOperator(size),
      H1FESpace(h1_fes), L2FESpace(l2_fes),
      ess_tdofs(essential_tdofs),
@@ -92,39 +351,117 @@ LagrangianHydroOperator::LagrangianHydroOperator(int size,
      l2dofs_cnt(l2_fes.GetFE(0)->GetDof()),
      h1dofs_cnt(h1_fes.GetFE(0)->GetDof()),
      source_type(source_type_), cfl(cfl_),
-     use_viscosity(visc), p_assembly(pa), cg_rel_tol(cgt), cg_max_iter(cgiter),
-     material_pcf(material_),
+     use_viscosity(visc), p_assembly(pa), fused_force(fused),
+     cg_rel_tol(cgt), cg_max_iter(cgiter), pipelined_cg(pcg), velocity_cg(NULL),
+     velocity_cg_r(NULL),
+     dv_history(h1_fes.GetParMesh()->GetComm(), cg_recycle),
+     material_pcf(material_), zone_gamma(nzones),
+     dense_mass(!pa || dense_mass_),
      Mv(&h1_fes), Mv_spmat_copy(),
-     Me(l2dofs_cnt, l2dofs_cnt, nzones), Me_inv(l2dofs_cnt, l2dofs_cnt, nzones),
+     Mv_A(NULL), Mv_Ae(NULL), Mv_prec(NULL), Me(), Me_inv(),
      integ_rule(IntRules.Get(h1_fes.GetMesh()->GetElementBaseGeometry(0),
                              3*h1_fes.GetOrder(0) + l2_fes.GetOrder(0) - 1)),
      quad_data(dim, nzones, integ_rule.GetNPoints()),
      quad_data_is_current(false), forcemat_is_assembled(false),
+     recompute_jac0inv(recompute_jac0inv_), x0(),
+     dt_est_local(0.0), dt_est_global(0.0), dt_est_request(MPI_REQUEST_NULL),
+     step_aborted(false), detJ_local(0.0), detJ_global(0.0), ok_detJ(0.0),
+     ok_time(0.0), bad_detJ(0.0), bad_time(0.0),
+     detJ_request(MPI_REQUEST_NULL),
      Force(&l2_fes, &h1_fes), ForcePA(&quad_data, h1_fes, l2_fes),
      VMassPA(&quad_data, H1FESpace), VMassPA_prec(H1FESpace),
-     locEMassPA(&quad_data, l2_fes),
-     locCG(), timer()
+     cheb_degree(cheb_deg), VMassPA_cheb(H1FESpace, ess_tdofs, cheb_deg),
+     nthreads(GetNumThreads()), locEMassPA(nthreads), locCG(nthreads),
+     EMassPA_batched(NULL), VMassPA_c(NULL), zone_work(nthreads),
+     e_source_coeff(NULL), mr_point(-1),
+     timer(), stream_bw(0.0)
 {
+   // Mixed precision without -sw: the single precision data is stored in the
+   // zone-interleaved layout with blocks of one zone, i.e., in the standard
+   // zone order.
+   if (mixed_precision && simd_width == 0) { simd_width = 1; }
+
+   // The kernels and the threaded zone loops use the element-to-dof tables,
+   // so they are built here, before any of these are used.
+   H1FESpace.BuildElementToDofTable();
+   L2FESpace.BuildElementToDofTable();
+
    GridFunctionCoefficient rho_coeff(&rho0);
 
-   // Standard local assembly and inversion for energy mass matrices.
-   MassIntegrator mi(rho_coeff, &integ_rule);
-   for (int i = 0; i < nzones; i++)
+   if (dense_mass)
    {
-      DenseMatrixInverse inv(&Me(i));
-      mi.AssembleElementMatrix(*l2_fes.GetFE(i),
-                               *l2_fes.GetElementTransformation(i), Me(i));
-      inv.Factor();
-      inv.GetInverseMatrix(Me_inv(i));
+      // Standard local assembly and inversion for energy mass matrices.
+      Me.SetSize(l2dofs_cnt, l2dofs_cnt, nzones);
+      Me_inv.SetSize(l2dofs_cnt, l2dofs_cnt, nzones);
+      MassIntegrator mi(rho_coeff, &integ_rule);
+      for (int i = 0; i < nzones; i++)
+      {
+         DenseMatrixInverse inv(&Me(i));
+         mi.AssembleElementMatrix(*l2_fes.GetFE(i),
+                                  *l2_fes.GetElementTransformation(i), Me(i));
+         inv.Factor();
+         inv.GetInverseMatrix(Me_inv(i));
+      }
+
+      // Standard assembly for the velocity mass matrix.
+      VectorMassIntegrator *vmi = new VectorMassIntegrator(rho_coeff,
+                                                           &integ_rule);
+      Mv.AddDomainIntegrator(vmi);
+      Mv.Assemble();
+      // ParallelAssemble needs the finalized matrix.
+      Mv.Finalize();
+      Mv_spmat_copy = Mv.SpMat();
    }
 
-   // Standard assembly for the velocity mass matrix.
-   VectorMassIntegrator *vmi = new VectorMassIntegrator(rho_coeff, &integ_rule);
-   Mv.AddDomainIntegrator(vmi);
-   Mv.Assemble();
-   Mv_spmat_copy = Mv.SpMat();
+   // The velocity solver. Its operator and preconditioner are set here for
+   // full assembly, and below, after the PA setup, for partial assembly.
+   MPI_Comm comm = H1FESpace.GetParMesh()->GetComm();
+   if (pipelined_cg)
+   {
+      PipelinedCGSolver *pcg = new PipelinedCGSolver(comm);
+      velocity_cg_r = &pcg->GetResidual();
+      velocity_cg = pcg;
+   }
+   else
+   {
+      ResidualCGSolver *cg = new ResidualCGSolver(comm);
+      velocity_cg_r = &cg->GetResidual();
+      velocity_cg = cg;
+   }
+   velocity_cg->SetRelTol(cg_rel_tol); velocity_cg->SetAbsTol(0.0);
+   velocity_cg->SetMaxIter(cg_max_iter);
+   velocity_cg->SetPrintLevel(0);
+   velocity_cg->iterative_mode = (cg_recycle > 0);
+   if (!p_assembly)
+   {
+      Mv_A = Mv.ParallelAssemble();
+      Mv_Ae = Mv_A->EliminateRowsCols(ess_tdofs);
+      if (amg)
+      {
+         HypreBoomerAMG *amg_prec = new HypreBoomerAMG;
+         amg_prec->SetPrintLevel(0);
+         // The velocity components are ordered by nodes, see H1FESpace. The
+         // MFEM versions before 3.4 support only the systems options for
+         // components ordered by vdim, so there AMG treats the matrix as a
+         // scalar problem.
+#if defined(MFEM_VERSION) && MFEM_VERSION >= 30400
+         amg_prec->SetSystemsOptions(dim, true);
+#endif
+         Mv_prec = amg_prec;
+      }
+      else
+      {
+         HypreSmoother *jacobi = new HypreSmoother;
+         jacobi->SetType(HypreSmoother::Jacobi, 1);
+         Mv_prec = jacobi;
+      }
+      velocity_cg->SetPreconditioner(*Mv_prec);
+      velocity_cg->SetOperator(*Mv_A);
+   }
 
    // Values of rho0DetJ0 and Jac0inv at all quadrature points.
+   MFEM_VERIFY(p_assembly || !recompute_jac0inv, "Recomputing Jac0inv needs "
+               "partial assembly.");
    const int nqp = integ_rule.GetNPoints();
    Vector rho_vals(nqp);
    for (int i = 0; i < nzones; i++)
@@ -136,8 +473,11 @@ LagrangianHydroOperator::LagrangianHydroOperator(int size,
          const IntegrationPoint &ip = integ_rule.IntPoint(q);
          T->SetIntPoint(&ip);
 
-         DenseMatrixInverse Jinv(T->Jacobian());
-         Jinv.GetInverseMatrix(quad_data.Jac0inv(i*nqp + q));
+         if (!recompute_jac0inv)
+         {
+            DenseMatrixInverse Jinv(T->Jacobian());
+            Jinv.GetInverseMatrix(quad_data.Jac0inv(i*nqp + q));
+         }
 
          const double rho0DetJ0 = T->Weight() * rho_vals(q);
          quad_data.rho0DetJ0w(i*nqp + q) = rho0DetJ0 *
@@ -145,6 +485,16 @@ LagrangianHydroOperator::LagrangianHydroOperator(int size,
       }
    }
 
+   // Ideal gas, unless a material is given.
+   const IntegrationPoint &center =
+      Geometries.GetCenter(h1_fes.GetMesh()->GetElementBaseGeometry(0));
+   for (int i = 0; i < nzones; i++)
+   {
+      ElementTransformation *T = h1_fes.GetElementTransformation(i);
+      T->SetIntPoint(&center);
+      zone_gamma(i) = material_pcf ? material_pcf->Eval(*T, center) : 5./3.;
+   }
+
    // Initial local mesh size (assumes all mesh elements are of the same type).
    double loc_area = 0.0, glob_area;
    int loc_z_cnt = nzones, glob_z_cnt;
@@ -176,10 +526,44 @@ LagrangianHydroOperator::LagrangianHydroOperator(int size,
                                 int(floor(0.7 + pow(nqp, 1.0 / dim))));
       evaluator = new FastEvaluator(H1FESpace);
 
+      if (recompute_jac0inv)
+      {
+         // The initial positions replace the stored inverse Jacobians.
+         x0 = *H1FESpace.GetMesh()->GetNodes();
+         quad_data.Jac0inv.SetSize(0, 0, 0);
+      }
+
+      if (simd_width > 0)
+      {
+         MFEM_VERIFY(ForcePA.HasFixedKernels(), "The zone-interleaved layout "
+                     "is not supported for these orders.");
+         quad_data.SetZoneInterleaved(simd_width);
+         if (mixed_precision) { quad_data.SetSinglePrecision(); }
+      }
+      MFEM_VERIFY(!mixed_precision || simd_width > 0, "Mixed precision needs "
+                  "the zone-interleaved layout.");
+
+      if (fused_force)
+      {
+         MFEM_VERIFY(ForcePA.HasFixedKernels(), "The fused force computation "
+                     "is not supported for these orders.");
+         // The stress values live only in thread-local batch buffers.
+         quad_data.stressJinvT.SetSize(0, 0, 0);
+         if (simd_width > 0)
+         {
+            quad_data.stressJinvT_zi.SetSize(simd_width, 0, dim * dim, nqp);
+            quad_data.stressJinvT_zf.SetSize(simd_width, 0, dim * dim, nqp);
+         }
+         fused_rhs_v.SetSize(H1FESpace.GetVSize());
+         fused_rhs_e.SetSize(L2FESpace.GetVSize());
+         fused_rhs_thr.SetSize(nthreads * H1FESpace.GetVSize());
+      }
+
       // Setup the preconditioner of the velocity mass operator.
       Vector d;
       (dim == 2) ? VMassPA.ComputeDiagonal2D(d) : VMassPA.ComputeDiagonal3D(d);
       VMassPA_prec.SetDiagonal(d);
+      if (cheb_degree > 0) { VMassPA_cheb.SetDiagonal(d); }
    }
    else
    {
@@ -191,12 +575,92 @@ LagrangianHydroOperator::LagrangianHydroOperator(int size,
       Force.Finalize(0);
    }
 
-   locCG.SetOperator(locEMassPA);
-   locCG.iterative_mode = false;
-   locCG.SetRelTol(1e-8);
-   locCG.SetAbsTol(1e-8 * numeric_limits<double>::epsilon());
-   locCG.SetMaxIter(200);
-   locCG.SetPrintLevel(0);
+   for (int t = 0; t < nthreads; t++)
+   {
+      locEMassPA[t] = new LocalMassPAOperator(&quad_data, l2_fes);
+      locCG[t] = new CGSolver;
+      locCG[t]->SetOperator(*locEMassPA[t]);
+      locCG[t]->iterative_mode = false;
+      locCG[t]->SetRelTol(1e-8);
+      locCG[t]->SetAbsTol(1e-8 * numeric_limits<double>::epsilon());
+      locCG[t]->SetMaxIter(200);
+      locCG[t]->SetPrintLevel(0);
+   }
+   if (p_assembly && energy_solver > 0)
+   {
+      // Batches of 4 zones, unless the quadrature data is interleaved with
+      // -sw.
+      EMassPA_batched =
+         new BatchedEnergyMassSolver(&quad_data, l2_fes,
+                                     (simd_width >= 4) ? simd_width : 4,
+                                     energy_solver == 1);
+   }
+
+   if (p_assembly)
+   {
+      // Same as VMassPA.FormLinearSystem, but done once.
+      const Operator *P = H1FESpace.GetProlongationMatrix();
+      VMassPA_c = new ConstrainedOperator(new RAPOperator(*P, VMassPA, *P),
+                                          ess_tdofs, true);
+      Solver *prec = &VMassPA_prec;
+      if (cheb_degree > 0) { prec = &VMassPA_cheb; }
+      velocity_cg->SetPreconditioner(*prec);
+      velocity_cg->SetOperator(*VMassPA_c);
+
+      // Analytic kernel costs for the roofline report. The fused computation
+      // applies the force operator within UpdateQuadratureData.
+      const int h1d = tensors1D->HQshape1D.Height(),
+                l2d = tensors1D->LQshape1D.Height(),
+                q1d = tensors1D->HQshape1D.Width();
+      const int qb = mixed_precision ? 4 : 8;
+      force_cost  = ForcePACost(dim, h1d, l2d, q1d, false, qb) * nzones;
+      forceT_cost = ForcePACost(dim, h1d, l2d, q1d, true, qb) * nzones;
+      mass_cost   = MassPACost(dim, h1d, q1d, qb) * nzones;
+      quad_cost   = QuadratureUpdateCost(dim, h1d, l2d, q1d, qb,
+                                         !recompute_jac0inv) * nzones;
+      if (fused_force) { quad_cost += force_cost; quad_cost += forceT_cost; }
+      if (energy_solver == 1)
+      {
+         // Product with the stored inverse, with the rhs and result traffic.
+         emass_cost = KernelCost(2.0 * l2dofs_cnt * l2dofs_cnt,
+                                 qb * l2dofs_cnt * l2dofs_cnt +
+                                 8.0 * 2 * l2dofs_cnt + 4.0 * l2dofs_cnt);
+      }
+      else
+      {
+         // The mass action and the CG vector updates and inner products.
+         emass_cost = LocalMassPACost(dim, l2d, q1d);
+         emass_cost.flops += 10.0 * l2dofs_cnt;
+      }
+   }
+
+   if (source_type == 1) // 2D Taylor-Green.
+   {
+      e_source_coeff = new TaylorCoefficient;
+      e_source.SetSize(L2FESpace.GetVSize());
+   }
+
+   const int tdofs = H1FESpace.GetTrueVSize();
+   one_l2.SetSize(L2FESpace.GetVSize());
+   one_l2 = 1.0;
+   rhs_h1.SetSize(H1FESpace.GetVSize());
+   Mv_v.SetSize(H1FESpace.GetVSize());
+   rhs_l2.SetSize(L2FESpace.GetVSize());
+   B_tdof.SetSize(tdofs); X_tdof.SetSize(tdofs); Bb_tdof.SetSize(tdofs);
+   const int nzones_batch = (simd_width > 0) ? simd_width : 3;
+   for (int t = 0; t < nthreads; t++)
+   {
+      zone_work[t] = new ZoneLoopWorkspace(dim, nqp, nzones_batch, h1dofs_cnt,
+                                           l2dofs_cnt, fused_force,
+                                           simd_width > 0);
+   }
+   // The batches of UpdateQuadratureData, see there.
+   const int qd_batch = (quad_data.simd_width > 0) ? quad_data.simd_width : 3;
+   const int nbatches = (nzones + qd_batch - 1) / qd_batch;
+   batch_dt_est.SetSize(nbatches);
+   batch_dt_est = numeric_limits<double>::infinity();
+   batch_level.SetSize(nbatches);
+   batch_level = 0;
 }
 
 void LagrangianHydroOperator::Mult(const Vector &S, Vector &dS_dt) const
@@ -227,10 +691,7 @@ void LagrangianHydroOperator::Mult(const Vector &S, Vector &dS_dt) const
 void LagrangianHydroOperator::SolveVelocity(const Vector &S,
                                             Vector &dS_dt) const
 {
-   UpdateQuadratureData(S);
-   AssembleForceMatrix();
-
-   const int VsizeL2 = L2FESpace.GetVSize();
+   ProfileRegion region("SolveVelocity");
    const int VsizeH1 = H1FESpace.GetVSize();
 
    // The monolithic BlockVector stores the unknown fields as follows:
@@ -238,62 +699,129 @@ void LagrangianHydroOperator::SolveVelocity(const Vector &S,
    ParGridFunction dv;
    dv.MakeRef(&H1FESpace, dS_dt, VsizeH1);
    dv = 0.0;
+   if (step_aborted) { return; }
+
+   UpdateQuadratureData(S);
+   // The tangling check of the stage is completed before the linear solve.
+   detJ_local = quad_data.detJ_min;
+   MPI_Iallreduce(&detJ_local, &detJ_global, 1, MPI_DOUBLE, MPI_MIN,
+                  H1FESpace.GetComm(), &detJ_request);
+   AssembleForceMatrix();
 
-   Vector one(VsizeL2), rhs(VsizeH1), B, X; one = 1.0;
+   // Only the right-hand sides are updated, see the constructor for Mv_A and
+   // VMassPA_c.
+   const Operator &P = *H1FESpace.GetProlongationMatrix();
+   Vector &rhs = rhs_h1, &B = B_tdof, &X = X_tdof;
    if (p_assembly)
    {
-      timer.sw_force.Start();
-      ForcePA.Mult(one, rhs);
-      timer.sw_force.Stop();
+      if (fused_force) { rhs = fused_rhs_v; }
+      else
+      {
+         profiler.Begin("Force");
+         ForcePA.Mult(one_l2, rhs);
+         profiler.End();
+         timer.force += force_cost;
+      }
       rhs.Neg();
 
-      Operator *cVMassPA;
-      VMassPA.FormLinearSystem(ess_tdofs, dv, rhs, cVMassPA, X, B);
-      CGSolver cg(H1FESpace.GetParMesh()->GetComm());
-      cg.SetPreconditioner(VMassPA_prec);
-      cg.SetOperator(*cVMassPA);
-      cg.SetRelTol(cg_rel_tol); cg.SetAbsTol(0.0);
-      cg.SetMaxIter(cg_max_iter);
-      cg.SetPrintLevel(0);
-      timer.sw_cgH1.Start();
-      cg.Mult(B, X);
-      timer.sw_cgH1.Stop();
-      timer.H1cg_iter += cg.GetNumIterations();
-      VMassPA.RecoverFEMSolution(X, rhs, dv);
-      delete cVMassPA;
+      // As dv = 0, the elimination only zeroes the essential dofs of B.
+      profiler.Begin("FormLinearSystem");
+      P.MultTranspose(rhs, B);
+      X = 0.0;
+      B.SetSubVector(ess_tdofs, 0.0);
+      profiler.End();
+      if (StageTangled()) { return; }
+      Solver *prec = &VMassPA_prec;
+      if (cheb_degree > 0) { prec = &VMassPA_cheb; }
+      SolveVelocityCG(*VMassPA_c, *prec, B, X);
+      profiler.Begin("RecoverFEMSolution");
+      P.Mult(X, dv);
+      profiler.End();
    }
    else
    {
-      timer.sw_force.Start();
-      Force.Mult(one, rhs);
-      timer.sw_force.Stop();
+      profiler.Begin("Force");
+      Force.Mult(one_l2, rhs);
+      profiler.End();
       rhs.Neg();
 
-      HypreParMatrix A;
-      Mv.FormLinearSystem(ess_tdofs, dv, rhs, A, X, B);
-      CGSolver cg(H1FESpace.GetParMesh()->GetComm());
-      HypreSmoother prec;
-      prec.SetType(HypreSmoother::Jacobi, 1);
-      cg.SetPreconditioner(prec);
-      cg.SetOperator(A);
-      cg.SetRelTol(cg_rel_tol); cg.SetAbsTol(0.0);
-      cg.SetMaxIter(cg_max_iter);
-      cg.SetPrintLevel(0);
-      timer.sw_cgH1.Start();
-      cg.Mult(B, X);
-      timer.sw_cgH1.Stop();
-      timer.H1cg_iter += cg.GetNumIterations();
+      profiler.Begin("FormLinearSystem");
+      P.MultTranspose(rhs, B);
+      H1FESpace.GetRestrictionMatrix()->Mult(dv, X);
+      EliminateBC(*Mv_A, *Mv_Ae, ess_tdofs, X, B);
+      profiler.End();
+      if (StageTangled()) { return; }
+      SolveVelocityCG(*Mv_A, *Mv_prec, B, X);
+      profiler.Begin("RecoverFEMSolution");
       Mv.RecoverFEMSolution(X, rhs, dv);
+      profiler.End();
+   }
+}
+
+bool LagrangianHydroOperator::StageTangled() const
+{
+   profiler.Begin("Tangling check");
+   MPI_Wait(&detJ_request, MPI_STATUS_IGNORE);
+   profiler.End();
+   if (detJ_global > 0.0)
+   {
+      ok_detJ = detJ_global;
+      ok_time = GetTime();
+      return false;
    }
+   step_aborted = true;
+   bad_detJ = detJ_global;
+   bad_time = GetTime();
+   return true;
+}
+
+double LagrangianHydroOperator::RetryTimeStep(double t0, double dt,
+                                              double dt_est,
+                                              bool adaptive) const
+{
+   double dt_new;
+   if (step_aborted && bad_time > ok_time && ok_time >= t0)
+   {
+      // detJ is linear in time between the two stages; it vanishes at t_bad.
+      const double t_bad = ok_time + (bad_time - ok_time) *
+                           ok_detJ / (ok_detJ - bad_detJ);
+      dt_new = 0.5 * (t_bad - t0);
+   }
+   else if (!step_aborted && adaptive && dt_est > 0.0)
+   {
+      dt_new = 0.9 * dt_est;
+   }
+   else { return 0.85 * dt; }
+   return min(0.85 * dt, max(0.1 * dt, dt_new));
+}
+
+void LagrangianHydroOperator::SolveVelocityCG(const Operator &A, Solver &prec,
+                                              const Vector &B, Vector &X) const
+{
+   IterativeSolver &cg = *velocity_cg;
+   profiler.Begin("CG (H1)");
+   if (dv_history.MaxSize() > 0)
+   {
+      // Keep the zero initial guess stopping criterion, (B r, r) <= tol^2 (B
+      // b, b), as the relative one would be much stricter after the warm start.
+      // The norm is reduced together with the projection.
+      Vector &Bb = Bb_tdof;
+      prec.Mult(B, Bb);
+      const double b_norm = sqrt(dv_history.InitialGuess(B, Bb, X));
+      cg.SetRelTol(0.0);
+      cg.SetAbsTol(cg_rel_tol * b_norm);
+      timer.H1cg_reductions++;
+   }
+   cg.Mult(B, X);
+   if (dv_history.MaxSize() > 0) { dv_history.Add(X, B, *velocity_cg_r); }
+   profiler.End();
+   timer.H1cg_iter += cg.GetNumIterations();
 }
 
 void LagrangianHydroOperator::SolveEnergy(const Vector &S, const Vector &v,
                                           Vector &dS_dt) const
 {
-   UpdateQuadratureData(S);
-   AssembleForceMatrix();
-
-   const int VsizeL2 = L2FESpace.GetVSize();
+   ProfileRegion region("SolveEnergy");
    const int VsizeH1 = H1FESpace.GetVSize();
 
    // The monolithic BlockVector stores the unknown fields as follows:
@@ -301,60 +829,281 @@ void LagrangianHydroOperator::SolveEnergy(const Vector &S, const Vector &v,
    ParGridFunction de;
    de.MakeRef(&L2FESpace, dS_dt, VsizeH1*2);
    de = 0.0;
+   if (step_aborted) { return; }
+
+   UpdateQuadratureData(S);
+   AssembleForceMatrix();
 
    // Solve for energy, assemble the energy source if such exists.
-   LinearForm *e_source = NULL;
-   if (source_type == 1) // 2D Taylor-Green.
+   if (e_source_coeff)
    {
-      e_source = new LinearForm(&L2FESpace);
-      TaylorCoefficient coeff;
-      DomainLFIntegrator *d = new DomainLFIntegrator(coeff, &integ_rule);
-      e_source->AddDomainIntegrator(d);
-      e_source->Assemble();
+      profiler.Begin("Energy source");
+      AssembleEnergySource();
+      profiler.End();
    }
-   Array<int> l2dofs;
-   Vector e_rhs(VsizeL2), loc_rhs(l2dofs_cnt), loc_de(l2dofs_cnt);
+   Vector &e_rhs = rhs_l2;
+   int L2dof_iter = 0;
    if (p_assembly)
    {
-      timer.sw_force.Start();
-      ForcePA.MultTranspose(v, e_rhs);
-      timer.sw_force.Stop();
+      if (fused_force)
+      {
+         // The fused pass used the velocity stored in S.
+         MFEM_VERIFY(v.GetData() == S.GetData() + VsizeH1,
+                     "The fused force computation needs the velocity of S.");
+         e_rhs = fused_rhs_e;
+      }
+      else
+      {
+         profiler.Begin("Force");
+         ForcePA.MultTranspose(v, e_rhs);
+         profiler.End();
+         timer.force += forceT_cost;
+      }
 
-      if (e_source) { e_rhs += *e_source; }
-      for (int z = 0; z < nzones; z++)
+      if (e_source_coeff) { e_rhs += e_source; }
+      profiler.Begin("CG (L2)");
+      if (EMassPA_batched) { L2dof_iter = EMassPA_batched->Mult(e_rhs, de); }
+      else
       {
-         L2FESpace.GetElementDofs(z, l2dofs);
-         e_rhs.GetSubVector(l2dofs, loc_rhs);
-         locEMassPA.SetZoneId(z);
-         timer.sw_cgL2.Start();
-         locCG.Mult(loc_rhs, loc_de);
-         timer.sw_cgL2.Stop();
-         timer.L2dof_iter += locCG.GetNumIterations() * l2dofs_cnt;
-         de.SetSubVector(l2dofs, loc_de);
+         #pragma omp parallel num_threads(GetNumThreads()) \
+                              reduction(+:L2dof_iter)
+         {
+            const int tid = GetThreadId();
+            Array<int> &l2dofs = zone_work[tid]->L2dofs;
+            Vector &loc_rhs = zone_work[tid]->loc_rhs,
+                   &loc_de  = zone_work[tid]->loc_de;
+            #pragma omp for schedule(static)
+            for (int z = 0; z < nzones; z++)
+            {
+               L2FESpace.GetElementDofs(z, l2dofs);
+               e_rhs.GetSubVector(l2dofs, loc_rhs);
+               locEMassPA[tid]->SetZoneId(z);
+               locCG[tid]->Mult(loc_rhs, loc_de);
+               L2dof_iter += locCG[tid]->GetNumIterations() * l2dofs_cnt;
+               de.SetSubVector(l2dofs, loc_de);
+            }
+         }
       }
+      profiler.End();
+      timer.energy += emass_cost * (L2dof_iter / l2dofs_cnt);
    }
    else
    {
-      timer.sw_force.Start();
+      profiler.Begin("Force");
       Force.MultTranspose(v, e_rhs);
-      timer.sw_force.Stop();
-      if (e_source) { e_rhs += *e_source; }
-      for (int z = 0; z < nzones; z++)
+      profiler.End();
+      if (e_source_coeff) { e_rhs += e_source; }
+      profiler.Begin("CG (L2)");
+      #pragma omp parallel num_threads(GetNumThreads()) reduction(+:L2dof_iter)
+      {
+         ZoneLoopWorkspace &ws = *zone_work[GetThreadId()];
+         Array<int> &l2dofs = ws.L2dofs;
+         Vector &loc_rhs = ws.loc_rhs, &loc_de = ws.loc_de;
+         #pragma omp for schedule(static)
+         for (int z = 0; z < nzones; z++)
+         {
+            L2FESpace.GetElementDofs(z, l2dofs);
+            e_rhs.GetSubVector(l2dofs, loc_rhs);
+            // DenseTensor::operator() reuses an internal matrix, so the zone
+            // inverses are accessed through thread-local views.
+            DenseMatrix Me_inv_z(Me_inv.GetData(z), l2dofs_cnt, l2dofs_cnt);
+            Me_inv_z.Mult(loc_rhs, loc_de);
+            L2dof_iter += l2dofs_cnt;
+            de.SetSubVector(l2dofs, loc_de);
+         }
+      }
+      profiler.End();
+   }
+   timer.L2dof_iter += L2dof_iter;
+}
+
+bool LagrangianHydroOperator::MultirateKick(int m, int levels, double h,
+                                            Vector &S) const
+{
+   ProfileRegion region("MultirateKick");
+   const int VsizeH1 = H1FESpace.GetVSize(), VsizeL2 = L2FESpace.GetVSize();
+   const int n = 1 << (levels - 1), nbatches = batch_level.Size(),
+             nzones_batch = (quad_data.simd_width > 0) ?
+                            quad_data.simd_width : 3;
+   Vector v(S.GetData() + VsizeH1, VsizeH1),
+          e(S.GetData() + 2*VsizeH1, VsizeL2);
+   mr_weight.SetSize(VsizeL2); mr_e_rate.SetSize(VsizeL2);
+   mr_de.SetSize(VsizeL2);
+   mr_dv.SetSize(levels * VsizeH1);
+   mr_dv_set.SetSize(levels);
+   if (step_aborted) { return false; }
+
+   if (m == 0)
+   {
+      // The levels, from the estimates of the update at the start.
+      UpdateQuadratureData(S);
+      for (int b = 0; b < nbatches; b++)
+      {
+         int k = 0;
+         while (k < levels - 1 && (2 << k) * h <= batch_dt_est(b)) { k++; }
+         batch_level[b] = k;
+      }
+      mr_dv_set = false;
+   }
+
+   // The class of the point: the largest active level.
+   int j = levels - 1;
+   if (m > 0 && m < n)
+   {
+      j = 0;
+      while (m % (2 << j) == 0) { j++; }
+   }
+
+   // The zone ranges of the active batches, merged when contiguous, and the
+   // kick weights of their zones.
+   const double end_factor = (m == 0 || m == n) ? 0.5 : 1.0;
+   Array<int> &l2dofs = zone_work[0]->L2dofs;
+   mr_zones.SetSize(0);
+   mr_weight = 0.0;
+   int nactive = 0;
+   for (int b = 0; b < nbatches; b++)
+   {
+      if (!MultirateActive(b, m)) { continue; }
+      const int z_begin = b * nzones_batch,
+                z_end = min(z_begin + nzones_batch, nzones);
+      if (mr_zones.Size() > 0 && mr_zones.Last() == z_begin)
+      {
+         mr_zones.Last() = z_end;
+      }
+      else { mr_zones.Append(z_begin); mr_zones.Append(z_end); }
+      const double c = end_factor * (1 << batch_level[b]) * h;
+      for (int z = z_begin; z < z_end; z++)
       {
          L2FESpace.GetElementDofs(z, l2dofs);
-         e_rhs.GetSubVector(l2dofs, loc_rhs);
-         timer.sw_cgL2.Start();
-         Me_inv(z).Mult(loc_rhs, loc_de);
-         timer.sw_cgL2.Stop();
-         timer.L2dof_iter += l2dofs_cnt;
-         de.SetSubVector(l2dofs, loc_de);
+         mr_weight.SetSubVector(l2dofs, c);
       }
+      nactive += z_end - z_begin;
    }
-   delete e_source;
+   const double active = (double) nactive / nzones;
+   Vector dv(mr_dv.GetData() + j * VsizeH1, VsizeH1);
+
+   if (m > 0)
+   {
+      // The predicted state at m: half of a step of each active zone is
+      // mr_weight / (2 end_factor).
+      mr_state = S;
+      Vector v_p(mr_state.GetData() + VsizeH1, VsizeH1),
+             e_p(mr_state.GetData() + 2*VsizeH1, VsizeL2);
+      for (int i = 0; i < VsizeL2; i++)
+      {
+         e_p(i) += 0.5 / end_factor * mr_weight(i) * mr_e_rate(i);
+      }
+      if (use_viscosity)
+      {
+         // The first point of a class predicts its kick with the stored
+         // stress, which is that of the last update of each active batch.
+         if (!mr_dv_set[j] && !MultirateVelocityKick(dv, active, false))
+         {
+            return false;
+         }
+         v_p.Add((m == n) ? 1.0 : 0.5, dv);
+      }
+      mr_point = m;
+      quad_data_is_current = false;
+      UpdateQuadratureData(mr_state);
+      mr_point = -1;
+   }
+
+   // Velocity kick, with the tangling check of the active batches.
+   detJ_local = quad_data.detJ_min;
+   MPI_Iallreduce(&detJ_local, &detJ_global, 1, MPI_DOUBLE, MPI_MIN,
+                  H1FESpace.GetComm(), &detJ_request);
+   profiler.Begin("SolveVelocity");
+   const bool ok = MultirateVelocityKick(dv, active, true);
+   profiler.End();
+   if (!ok) { return false; }
+   mr_dv_set[j] = true;
+
+   // Energy kick of the active zones, with the average velocity. The batched
+   // energy solvers solve all zones.
+   profiler.Begin("SolveEnergy");
+   Vector &v_avg = rhs_h1, &e_rhs = rhs_l2;
+   add(v, 0.5, dv, v_avg);
+   if (e_source_coeff)
+   {
+      profiler.Begin("Energy source");
+      AssembleEnergySource();
+      profiler.End();
+   }
+   profiler.Begin("Force");
+   ForcePA.MultTransposeZoneRanges(mr_zones, v_avg, e_rhs);
+   profiler.End();
+   timer.force += forceT_cost * active;
+   if (e_source_coeff) { e_rhs += e_source; }
+   int L2dof_iter = 0;
+   profiler.Begin("CG (L2)");
+   if (EMassPA_batched) { L2dof_iter = EMassPA_batched->Mult(e_rhs, mr_de); }
+   else
+   {
+      #pragma omp parallel num_threads(GetNumThreads()) reduction(+:L2dof_iter)
+      {
+         const int tid = GetThreadId();
+         Array<int> &dofs = zone_work[tid]->L2dofs;
+         Vector &loc_rhs = zone_work[tid]->loc_rhs,
+                &loc_de  = zone_work[tid]->loc_de;
+         #pragma omp for schedule(static)
+         for (int z = 0; z < nzones; z++)
+         {
+            if (!MultirateActive(z / nzones_batch, m)) { continue; }
+            L2FESpace.GetElementDofs(z, dofs);
+            e_rhs.GetSubVector(dofs, loc_rhs);
+            locEMassPA[tid]->SetZoneId(z);
+            locCG[tid]->Mult(loc_rhs, loc_de);
+            L2dof_iter += locCG[tid]->GetNumIterations() * l2dofs_cnt;
+            mr_de.SetSubVector(dofs, loc_de);
+         }
+      }
+   }
+   profiler.End();
+   timer.energy += emass_cost * (L2dof_iter / l2dofs_cnt);
+   timer.L2dof_iter += L2dof_iter;
+   for (int i = 0; i < VsizeL2; i++)
+   {
+      if (mr_weight(i) == 0.0) { continue; }
+      mr_e_rate(i) = mr_de(i);
+      e(i) += mr_weight(i) * mr_de(i);
+   }
+   profiler.End();
+
+   v += dv;
+   return true;
+}
+
+bool LagrangianHydroOperator::MultirateVelocityKick(Vector &dv, double active,
+                                                    bool check_tangling) const
+{
+   // The impulse of the active zones, see SolveVelocity.
+   const Operator &P = *H1FESpace.GetProlongationMatrix();
+   Vector &rhs = rhs_h1, &B = B_tdof, &X = X_tdof;
+   profiler.Begin("Force");
+   ForcePA.MultZoneRanges(mr_zones, mr_weight, rhs);
+   profiler.End();
+   timer.force += force_cost * active;
+   rhs.Neg();
+
+   profiler.Begin("FormLinearSystem");
+   P.MultTranspose(rhs, B);
+   X = 0.0;
+   B.SetSubVector(ess_tdofs, 0.0);
+   profiler.End();
+   if (check_tangling && StageTangled()) { return false; }
+   Solver *prec = &VMassPA_prec;
+   if (cheb_degree > 0) { prec = &VMassPA_cheb; }
+   SolveVelocityCG(*VMassPA_c, *prec, B, X);
+   profiler.Begin("RecoverFEMSolution");
+   P.Mult(X, dv);
+   profiler.End();
+   return true;
 }
 
 void LagrangianHydroOperator::UpdateMesh(const Vector &S) const
 {
+   ProfileRegion region("UpdateMesh");
    Vector* sptr = (Vector*) &S;
    x_gf.MakeRef(&H1FESpace, *sptr, 0);
    H1FESpace.GetParMesh()->NewNodes(x_gf, false);
@@ -362,59 +1111,153 @@ void LagrangianHydroOperator::UpdateMesh(const Vector &S) const
 
 double LagrangianHydroOperator::GetTimeStepEstimate(const Vector &S) const
 {
+   StartTimeStepEstimate(S);
+   return FinishTimeStepEstimate();
+}
+
+void LagrangianHydroOperator::StartTimeStepEstimate(const Vector &S) const
+{
+   MFEM_VERIFY(dt_est_request == MPI_REQUEST_NULL,
+               "The previous time step estimate is not finished.");
    UpdateMesh(S);
    UpdateQuadratureData(S);
 
-   double glob_dt_est;
-   MPI_Allreduce(&quad_data.dt_est, &glob_dt_est, 1, MPI_DOUBLE, MPI_MIN,
-                 H1FESpace.GetParMesh()->GetComm());
-   return glob_dt_est;
+   // quad_data.dt_est is reset before the next step, so the reduction works
+   // on a copy.
+   dt_est_local = quad_data.dt_est;
+   MPI_Iallreduce(&dt_est_local, &dt_est_global, 1, MPI_DOUBLE, MPI_MIN,
+                  H1FESpace.GetParMesh()->GetComm(), &dt_est_request);
+}
+
+double LagrangianHydroOperator::FinishTimeStepEstimate() const
+{
+   profiler.Begin("dt reduction");
+   MPI_Wait(&dt_est_request, MPI_STATUS_IGNORE);
+   profiler.End();
+   return dt_est_global;
+}
+
+void LagrangianHydroOperator::SaveState(std::ostream &os) const
+{
+   // Only one of Jac0inv and x0 is stored, see recompute_jac0inv. Jac0inv and
+   // rho0DetJ0w are written in the standard layout, independent of -sw and the
+   // precision.
+   DenseTensor J;
+   Vector r;
+   quad_data.GetJac0inv(J);
+   quad_data.GetRho0DetJ0w(r);
+   WriteBinaryArray(os, J.Data(), J.SizeI() * J.SizeJ() * J.SizeK());
+   WriteBinaryArray(os, x0.GetData(), x0.Size());
+   WriteBinaryArray(os, r.GetData(), r.Size());
+   WriteBinary(os, quad_data.h0);
+   dv_history.Save(os);
+   WriteBinary(os, timer);
+}
+
+void LagrangianHydroOperator::LoadState(std::istream &is, const Vector &S)
+{
+   // The current values only set the sizes.
+   DenseTensor J;
+   Vector r;
+   quad_data.GetJac0inv(J);
+   quad_data.GetRho0DetJ0w(r);
+   ReadBinaryArray(is, J.Data(), J.SizeI() * J.SizeJ() * J.SizeK());
+   ReadBinaryArray(is, x0.GetData(), x0.Size());
+   ReadBinaryArray(is, r.GetData(), r.Size());
+   quad_data.SetJac0inv(J);
+   quad_data.SetRho0DetJ0w(r);
+   ReadBinary(is, quad_data.h0);
+   dv_history.Load(is);
+   TimingData saved_timer;
+   ReadBinary(is, saved_timer);
+
+   // This repeats the update of the time step estimate at the end of the
+   // checkpointed step, which is included in the saved counters and profiler
+   // times, so it is neither counted nor profiled.
+   profiler.Pause();
+   quad_data_is_current = false;
+   UpdateMesh(S);
+   UpdateQuadratureData(S);
+   profiler.Resume();
+   timer = saved_timer;
 }
 
 void LagrangianHydroOperator::ResetTimeStepEstimate() const
 {
    quad_data.dt_est = numeric_limits<double>::infinity();
+   step_aborted = false;
 }
 
 void LagrangianHydroOperator::ComputeDensity(ParGridFunction &rho) const
 {
    rho.SetSpace(&L2FESpace);
 
-   DenseMatrix Mrho(l2dofs_cnt);
-   Vector rhs(l2dofs_cnt), rho_z(l2dofs_cnt);
-   Array<int> dofs(l2dofs_cnt);
-   DenseMatrixInverse inv(&Mrho);
-   MassIntegrator mi(&integ_rule);
-   DensityIntegrator di(quad_data);
-   di.SetIntRule(&integ_rule);
-   for (int i = 0; i < nzones; i++)
+   #pragma omp parallel num_threads(GetNumThreads())
    {
-      di.AssembleRHSElementVect(*L2FESpace.GetFE(i),
-                                *L2FESpace.GetElementTransformation(i), rhs);
-      mi.AssembleElementMatrix(*L2FESpace.GetFE(i),
-                               *L2FESpace.GetElementTransformation(i), Mrho);
-      inv.Factor();
-      inv.Mult(rhs, rho_z);
-      L2FESpace.GetElementDofs(i, dofs);
-      rho.SetSubVector(dofs, rho_z);
+      // The integrators and the transformation keep internal state, so every
+      // thread uses its own copies.
+      DenseMatrix Mrho(l2dofs_cnt);
+      Vector rhs(l2dofs_cnt), rho_z(l2dofs_cnt);
+      Array<int> dofs(l2dofs_cnt);
+      DenseMatrixInverse inv(&Mrho);
+      MassIntegrator mi(&integ_rule);
+      DensityIntegrator di(quad_data);
+      di.SetIntRule(&integ_rule);
+      IsoparametricTransformation T;
+      #pragma omp for schedule(static)
+      for (int i = 0; i < nzones; i++)
+      {
+         L2FESpace.GetMesh()->GetElementTransformation(i, &T);
+         di.AssembleRHSElementVect(*L2FESpace.GetFE(i), T, rhs);
+         mi.AssembleElementMatrix(*L2FESpace.GetFE(i), T, Mrho);
+         inv.Factor();
+         inv.Mult(rhs, rho_z);
+         L2FESpace.GetElementDofs(i, dofs);
+         rho.SetSubVector(dofs, rho_z);
+      }
    }
 }
 
-double LagrangianHydroOperator::InternalEnergy(const ParGridFunction &e) const
+double LagrangianHydroOperator::LocalInternalEnergy(const Vector &e) const
 {
-   Vector one(l2dofs_cnt), loc_e(l2dofs_cnt);
-   one = 1.0;
-   Array<int> l2dofs;
-
    double loc_ie = 0.0;
-   for (int z = 0; z < nzones; z++)
+   #pragma omp parallel num_threads(GetNumThreads()) reduction(+:loc_ie)
    {
-      L2FESpace.GetElementDofs(z, l2dofs);
-      e.GetSubVector(l2dofs, loc_e);
-      loc_ie += Me(z).InnerProduct(loc_e, one);
+      const int tid = GetThreadId();
+      Vector one(l2dofs_cnt), loc_e(l2dofs_cnt), loc_Me(l2dofs_cnt);
+      one = 1.0;
+      Array<int> l2dofs;
+      #pragma omp for schedule(static)
+      for (int z = 0; z < nzones; z++)
+      {
+         L2FESpace.GetElementDofs(z, l2dofs);
+         e.GetSubVector(l2dofs, loc_e);
+         if (dense_mass)
+         {
+            DenseMatrix Me_z(Me.GetData(z), l2dofs_cnt, l2dofs_cnt);
+            loc_ie += Me_z.InnerProduct(loc_e, one);
+         }
+         else
+         {
+            locEMassPA[tid]->SetZoneId(z);
+            locEMassPA[tid]->Mult(loc_e, loc_Me);
+            loc_ie += loc_Me.Sum();
+         }
+      }
    }
+   return loc_ie;
+}
+
+double LagrangianHydroOperator::LocalKineticEnergy(const Vector &v) const
+{
+   if (dense_mass) { return 0.5 * Mv_spmat_copy.InnerProduct(v, v); }
+   VMassPA.MultStandard(v, Mv_v);
+   return 0.5 * (Mv_v * v);
+}
 
-   double glob_ie;
+double LagrangianHydroOperator::InternalEnergy(const ParGridFunction &e) const
+{
+   double loc_ie = LocalInternalEnergy(e), glob_ie;
    MPI_Allreduce(&loc_ie, &glob_ie, 1, MPI_DOUBLE, MPI_SUM,
                  H1FESpace.GetParMesh()->GetComm());
    return glob_ie;
@@ -422,21 +1265,136 @@ double LagrangianHydroOperator::InternalEnergy(const ParGridFunction &e) const
 
 double LagrangianHydroOperator::KineticEnergy(const ParGridFunction &v) const
 {
-   double loc_ke = 0.5 * Mv_spmat_copy.InnerProduct(v, v);
-
-   double glob_ke;
+   double loc_ke = LocalKineticEnergy(v), glob_ke;
    MPI_Allreduce(&loc_ke, &glob_ke, 1, MPI_DOUBLE, MPI_SUM,
                  H1FESpace.GetParMesh()->GetComm());
    return glob_ke;
 }
 
-void LagrangianHydroOperator::PrintTimingData(bool IamRoot, int steps) const
+void LagrangianHydroOperator::AddMemoryUsage(MemoryReport &mem) const
+{
+   quad_data.AddMemoryUsage(mem);
+   mem.Add("Initial node positions x0", MemoryUsage(x0));
+   mem.Add("Me, Me_inv", MemoryUsage(Me) + MemoryUsage(Me_inv));
+   mem.Add("Mv", dense_mass ? MemoryUsage(Mv.SpMat()) : 0);
+   mem.Add("Mv_spmat_copy", MemoryUsage(Mv_spmat_copy));
+   // The partial assembly force operator has no matrix.
+   mem.Add("Force matrix", p_assembly ? 0 : MemoryUsage(Force.SpMat()));
+   mem.Add("Multirate work vectors",
+           MemoryUsage(batch_dt_est) + MemoryUsage(mr_weight) +
+           MemoryUsage(mr_e_rate) + MemoryUsage(mr_state) +
+           MemoryUsage(mr_dv) + MemoryUsage(mr_de));
+}
+
+void LagrangianHydroOperator::SetDiagnostics(const Vector &S,
+                                             Diagnostics &diag) const
+{
+   const int VsizeH1 = H1FESpace.GetVSize(), ndofs = H1FESpace.GetNDofs();
+   const Vector v(S.GetData() + VsizeH1, VsizeH1),
+         e(S.GetData() + 2*VsizeH1, L2FESpace.GetVSize());
+
+   // The extrema are those of the last quadrature data update.
+   UpdateQuadratureData(S);
+   diag.Set(Diagnostics::MIN_DENSITY, quad_data.rho_min);
+   diag.Set(Diagnostics::MAX_DENSITY, quad_data.rho_max);
+   diag.Set(Diagnostics::MIN_PRESSURE, quad_data.p_min);
+   diag.Set(Diagnostics::MAX_PRESSURE, quad_data.p_max);
+   diag.Set(Diagnostics::MIN_DETJ, quad_data.detJ_min);
+
+   diag.Set(Diagnostics::INTERNAL_ENERGY, LocalInternalEnergy(e));
+   diag.Set(Diagnostics::KINETIC_ENERGY, LocalKineticEnergy(v));
+   diag.Set(Diagnostics::E_NORM2, e * e);
+   diag.Set(Diagnostics::MASS, quad_data.SumRho0DetJ0w());
+
+   // The velocity is ordered by nodes.
+   double v_max = 0.0;
+   for (int i = 0; i < ndofs; i++)
+   {
+      double v2 = 0.0;
+      for (int d = 0; d < dim; d++) { v2 += v(d*ndofs + i) * v(d*ndofs + i); }
+      v_max = max(v_max, v2);
+   }
+   diag.Set(Diagnostics::MAX_VELOCITY, sqrt(v_max));
+}
+
+void LagrangianHydroOperator::MixedPrecisionCheck(const Vector &S,
+                                                  double &force_diff,
+                                                  double &mass_rounding) const
+{
+   MPI_Comm comm = H1FESpace.GetParMesh()->GetComm();
+   MPI_Allreduce(&quad_data.rho0DetJ0w_rounding, &mass_rounding, 1,
+                 MPI_DOUBLE, MPI_MAX, comm);
+   force_diff = 0.0;
+   if (!quad_data.single_qdata || fused_force) { return; }
+
+   // The double precision stress is stored temporarily in stressJinvT_zi, and
+   // the data is then recomputed in single precision, as it was.
+   profiler.Pause();
+   const TimingData saved_timer = timer;
+   const int VsizeH1 = H1FESpace.GetVSize(), W = quad_data.simd_width,
+             nqp = quad_data.nqp;
+   const Vector v(S.GetData() + VsizeH1, VsizeH1);
+   Vector rhs_v[2], rhs_e[2];
+   UpdateMesh(S);
+   for (int k = 0; k < 2; k++)
+   {
+      if (k == 1)
+      {
+         quad_data.single_qdata = false;
+         quad_data.stressJinvT_zi.SetSize(W, nzones, dim * dim, nqp);
+      }
+      quad_data_is_current = false;
+      UpdateQuadratureData(S);
+      rhs_v[k].SetSize(VsizeH1);
+      rhs_e[k].SetSize(L2FESpace.GetVSize());
+      ForcePA.Mult(one_l2, rhs_v[k]);
+      ForcePA.MultTranspose(v, rhs_e[k]);
+   }
+   quad_data.stressJinvT_zi.SetSize(W, 0, dim * dim, nqp);
+   quad_data.single_qdata = true;
+   quad_data_is_current = false;
+   UpdateQuadratureData(S);
+   profiler.Resume();
+   timer = saved_timer;
+
+   // Max norms of the differences and of the double results.
+   double loc[4] = { 0.0, 0.0, 0.0, 0.0 }, glob[4];
+   for (int i = 0; i < VsizeH1; i++)
+   {
+      loc[0] = max(loc[0], fabs(rhs_v[0](i) - rhs_v[1](i)));
+      loc[1] = max(loc[1], fabs(rhs_v[1](i)));
+   }
+   for (int i = 0; i < rhs_e[1].Size(); i++)
+   {
+      loc[2] = max(loc[2], fabs(rhs_e[0](i) - rhs_e[1](i)));
+      loc[3] = max(loc[3], fabs(rhs_e[1](i)));
+   }
+   MPI_Allreduce(loc, glob, 4, MPI_DOUBLE, MPI_MAX, comm);
+   if (glob[1] > 0.0) { force_diff = glob[0] / glob[1]; }
+   if (glob[3] > 0.0) { force_diff = max(force_diff, glob[2] / glob[3]); }
+}
+
+const char *RooflineRegionName(int k)
+{
+   switch (k)
+   {
+      case RL_FORCE:  return "Force";
+      case RL_MASS:   return "MassPA";
+      case RL_QUAD:   return "UpdateQuadData";
+      case RL_ENERGY: return "CG (L2)";
+   }
+   MFEM_ABORT("Unknown kernel " << k);
+   return NULL;
+}
+
+void LagrangianHydroOperator::ComputeTimingSummary(int steps,
+                                                   TimingSummary &ts) const
 {
    double my_rt[5], rt_max[5];
-   my_rt[0] = timer.sw_cgH1.RealTime();
-   my_rt[1] = timer.sw_cgL2.RealTime();
-   my_rt[2] = timer.sw_force.RealTime();
-   my_rt[3] = timer.sw_qdata.RealTime();
+   my_rt[0] = profiler.GetTotalTime("CG (H1)");
+   my_rt[1] = profiler.GetTotalTime("CG (L2)");
+   my_rt[2] = profiler.GetTotalTime("Force");
+   my_rt[3] = profiler.GetTotalTime("UpdateQuadData");
    my_rt[4] = my_rt[0] + my_rt[2] + my_rt[3];
    MPI_Reduce(my_rt, rt_max, 5, MPI_DOUBLE, MPI_MAX, 0, H1FESpace.GetComm());
 
@@ -446,38 +1404,143 @@ void LagrangianHydroOperator::PrintTimingData(bool IamRoot, int steps) const
    MPI_Reduce(mydata, alldata, 2, HYPRE_MPI_INT, MPI_SUM, 0,
               H1FESpace.GetComm());
 
+   const HYPRE_Int H1gsize = H1FESpace.GlobalTrueVSize(),
+                   L2gsize = L2FESpace.GlobalTrueVSize();
+   ts.H1gsize     = H1gsize;
+   ts.L2gsize     = L2gsize;
+   ts.steps       = steps;
+   ts.H1cg_iter   = timer.H1cg_iter;
+   ts.H1cg_reductions = timer.H1cg_reductions;
+   ts.fused_force = fused_force;
+   ts.H1cg_time   = rt_max[0];
+   ts.H1cg_rate   = 1e-6 * H1gsize * timer.H1cg_iter / rt_max[0];
+   ts.L2cg_time   = rt_max[1];
+   ts.L2cg_rate   = 1e-6 * alldata[0] / rt_max[1];
+   // The Force operator is applied twice per time step, on the H1 and the L2
+   // vectors, respectively.
+   ts.force_time  = rt_max[2];
+   ts.force_rate  = 1e-6 * steps * (H1gsize + L2gsize) / rt_max[2];
+   ts.quad_time   = rt_max[3];
+   ts.quad_rate   = 1e-6 * alldata[1] * integ_rule.GetNPoints() / rt_max[3];
+   ts.total_time  = rt_max[4];
+   ts.total_rate  = 1e-6 * steps * (H1gsize + L2gsize) / rt_max[4];
+
+   // The kernel costs are summed over the ranks, and the rates use the max
+   // time over the ranks. The MassPA region counts the mass actions.
+   KernelCost my_cost[RL_NUM_KERNELS];
+   my_cost[RL_FORCE]  = timer.force;
+   my_cost[RL_MASS]   = mass_cost * profiler.GetTotalCalls("MassPA");
+   my_cost[RL_QUAD]   = timer.quad;
+   my_cost[RL_ENERGY] = timer.energy;
+   double my_cd[3*RL_NUM_KERNELS], cd[3*RL_NUM_KERNELS];
+   for (int k = 0; k < RL_NUM_KERNELS; k++)
+   {
+      my_cd[k] = my_cost[k].flops;
+      my_cd[RL_NUM_KERNELS + k] = my_cost[k].bytes;
+   }
+   MPI_Reduce(my_cd, cd, 2*RL_NUM_KERNELS, MPI_DOUBLE, MPI_SUM, 0,
+              H1FESpace.GetComm());
+   for (int k = 0; k < RL_NUM_KERNELS; k++)
+   {
+      my_cd[k] = profiler.GetTotalTime(RooflineRegionName(k));
+   }
+   MPI_Reduce(my_cd, cd + 2*RL_NUM_KERNELS, RL_NUM_KERNELS, MPI_DOUBLE,
+              MPI_MAX, 0, H1FESpace.GetComm());
+   for (int k = 0; k < RL_NUM_KERNELS; k++)
+   {
+      const double time = cd[2*RL_NUM_KERNELS + k];
+      ts.gflops[k] = (time > 0.0) ? 1e-9 * cd[k] / time : 0.0;
+      ts.gbytes[k] = (time > 0.0) ? 1e-9 * cd[RL_NUM_KERNELS + k] / time : 0.0;
+   }
+   ts.stream_bw = 1e-9 * stream_bw;
+}
+
+void LagrangianHydroOperator::PrintTimingData(bool IamRoot, int steps) const
+{
+   TimingSummary ts;
+   ComputeTimingSummary(steps, ts);
+
    if (IamRoot)
    {
-      const HYPRE_Int H1gsize = H1FESpace.GlobalTrueVSize(),
-                      L2gsize = L2FESpace.GlobalTrueVSize();
       using namespace std;
       cout << endl;
-      cout << "CG (H1) total time: " << rt_max[0] << endl;
+      cout << "CG (H1) total time: " << ts.H1cg_time << endl;
       cout << "CG (H1) rate (megadofs x cg_iterations / second): "
-           << 1e-6 * H1gsize * timer.H1cg_iter / rt_max[0] << endl;
+           << ts.H1cg_rate << endl;
+      if (ts.H1cg_reductions > 0)
+      {
+         cout << "CG (H1) iterations: " << ts.H1cg_iter
+              << ", warm start reductions: " << ts.H1cg_reductions << endl;
+      }
       cout << endl;
-      cout << "CG (L2) total time: " << rt_max[1] << endl;
+      cout << "CG (L2) total time: " << ts.L2cg_time << endl;
       cout << "CG (L2) rate (megadofs x cg_iterations / second): "
-           << 1e-6 * alldata[0] / rt_max[1] << endl;
+           << ts.L2cg_rate << endl;
       cout << endl;
-      // The Force operator is applied twice per time step, on the H1 and the L2
-      // vectors, respectively.
-      cout << "Forces total time: " << rt_max[2] << endl;
-      cout << "Forces rate (megadofs x timesteps / second): "
-           << 1e-6 * steps * (H1gsize + L2gsize) / rt_max[2] << endl;
+      if (fused_force)
+      {
+         cout << "Forces are computed within UpdateQuadData." << endl;
+      }
+      else
+      {
+         cout << "Forces total time: " << ts.force_time << endl;
+         cout << "Forces rate (megadofs x timesteps / second): "
+              << ts.force_rate << endl;
+      }
       cout << endl;
-      cout << "UpdateQuadData total time: " << rt_max[3] << endl;
+      cout << "UpdateQuadData total time: " << ts.quad_time << endl;
       cout << "UpdateQuadData rate (megaquads x timesteps / second): "
-           << 1e-6 * alldata[1] * integ_rule.GetNPoints() / rt_max[3] << endl;
+           << ts.quad_rate << endl;
       cout << endl;
-      cout << "Major kernels total time (seconds): " << rt_max[4] << endl;
+      cout << "Major kernels total time (seconds): " << ts.total_time << endl;
       cout << "Major kernels total rate (megadofs x time steps / second): "
-           << 1e-6 * steps * (H1gsize + L2gsize) / rt_max[4] << endl;
+           << ts.total_rate << endl;
+
+      if (p_assembly)
+      {
+         cout << endl << "Roofline (analytic counts, all ranks";
+         if (ts.stream_bw > 0.0)
+         {
+            cout << ", STREAM triad " << ts.stream_bw << " GB/s";
+         }
+         cout << "):" << endl;
+         cout << setw(16) << left << "kernel" << right << setw(10) << "GFLOP/s"
+              << setw(10) << "GB/s" << setw(11) << "flop/byte"
+              << setw(10) << "% STREAM" << endl;
+         const ios::fmtflags flags = cout.flags();
+         cout << fixed << setprecision(2);
+         for (int k = 0; k < RL_NUM_KERNELS; k++)
+         {
+            if (ts.gbytes[k] == 0.0) { continue; }
+            cout << setw(16) << left << RooflineRegionName(k) << right
+                 << setw(10) << ts.gflops[k] << setw(10) << ts.gbytes[k]
+                 << setw(11) << ts.gflops[k] / ts.gbytes[k];
+            if (ts.stream_bw > 0.0)
+            {
+               cout << setw(10) << 100.0 * ts.gbytes[k] / ts.stream_bw;
+            }
+            cout << endl;
+         }
+         cout.flags(flags);
+      }
    }
 }
 
 LagrangianHydroOperator::~LagrangianHydroOperator()
 {
+   for (int t = 0; t < nthreads; t++)
+   {
+      delete locCG[t];
+      delete locEMassPA[t];
+   }
+   for (int t = 0; t < nthreads; t++) { delete zone_work[t]; }
+   delete e_source_coeff;
+   delete EMassPA_batched;
+   delete VMassPA_c;
+   delete velocity_cg;
+   delete Mv_prec;
+   delete Mv_Ae;
+   delete Mv_A;
    delete tensors1D;
 }
 
@@ -490,10 +1553,64 @@ inline double smooth_step_01(double x, double eps)
    return (3.0 - 2.0 * y) * y * y;
 }
 
+// Inverses and determinants of the dim x dim matrices of the first n zones of
+// a block of W zones. The entry (i,j) of zone w is stored at (i*dim + j)*W + w,
+// as in the zone-interleaved layout. The determinants are skipped if det is
+// NULL.
+inline void CalcBlockInverse(int dim, int W, int n, const double *A,
+                             double *Ainv, double *det)
+{
+   if (dim == 1)
+   {
+      for (int w = 0; w < n; w++)
+      {
+         Ainv[w] = 1.0 / A[w];
+         if (det) { det[w] = A[w]; }
+      }
+   }
+   else if (dim == 2)
+   {
+      const double *a00 = A, *a01 = A + W, *a10 = A + 2*W, *a11 = A + 3*W;
+      for (int w = 0; w < n; w++)
+      {
+         const double d = a00[w] * a11[w] - a01[w] * a10[w], id = 1.0 / d;
+         Ainv[w]       =  a11[w] * id;
+         Ainv[W + w]   = -a01[w] * id;
+         Ainv[2*W + w] = -a10[w] * id;
+         Ainv[3*W + w] =  a00[w] * id;
+         if (det) { det[w] = d; }
+      }
+   }
+   else
+   {
+      const double *a00 = A,       *a01 = A + W,   *a02 = A + 2*W,
+                    *a10 = A + 3*W, *a11 = A + 4*W, *a12 = A + 5*W,
+                    *a20 = A + 6*W, *a21 = A + 7*W, *a22 = A + 8*W;
+      for (int w = 0; w < n; w++)
+      {
+         const double c00 = a11[w] * a22[w] - a12[w] * a21[w],
+                      c01 = a12[w] * a20[w] - a10[w] * a22[w],
+                      c02 = a10[w] * a21[w] - a11[w] * a20[w],
+                      d = a00[w] * c00 + a01[w] * c01 + a02[w] * c02,
+                      id = 1.0 / d;
+         Ainv[w]       = c00 * id;
+         Ainv[W + w]   = (a02[w] * a21[w] - a01[w] * a22[w]) * id;
+         Ainv[2*W + w] = (a01[w] * a12[w] - a02[w] * a11[w]) * id;
+         Ainv[3*W + w] = c01 * id;
+         Ainv[4*W + w] = (a00[w] * a22[w] - a02[w] * a20[w]) * id;
+         Ainv[5*W + w] = (a02[w] * a10[w] - a00[w] * a12[w]) * id;
+         Ainv[6*W + w] = c02 * id;
+         Ainv[7*W + w] = (a01[w] * a20[w] - a00[w] * a21[w]) * id;
+         Ainv[8*W + w] = (a00[w] * a11[w] - a01[w] * a10[w]) * id;
+         if (det) { det[w] = d; }
+      }
+   }
+}
+
 void LagrangianHydroOperator::UpdateQuadratureData(const Vector &S) const
 {
    if (quad_data_is_current) { return; }
-   timer.sw_qdata.Start();
+   profiler.Begin("UpdateQuadData");
 
    const int nqp = integ_rule.GetNPoints();
 
@@ -502,192 +1619,544 @@ void LagrangianHydroOperator::UpdateQuadratureData(const Vector &S) const
    x.MakeRef(&H1FESpace, *sptr, 0);
    v.MakeRef(&H1FESpace, *sptr, H1FESpace.GetVSize());
    e.MakeRef(&L2FESpace, *sptr, 2*H1FESpace.GetVSize());
-   Vector e_vals, e_loc(l2dofs_cnt), vector_vals(h1dofs_cnt * dim);
-   DenseMatrix Jpi(dim), sgrad_v(dim), Jinv(dim), stress(dim), stressJiT(dim),
-               vecvalMat(vector_vals.GetData(), h1dofs_cnt, dim);
-   DenseTensor grad_v_ref(dim, dim, nqp);
-   Array<int> L2dofs, H1dofs;
 
    // Batched computations are needed, because hydrodynamic codes usually
    // involve expensive computations of material properties. Although this
    // miniapp uses simple EOS equations, we still want to represent the batched
-   // cycle structure.
-   int nzones_batch = 3;
-   const int nbatches =  nzones / nzones_batch + 1; // +1 for the remainder.
-   int nqp_batch = nqp * nzones_batch;
-   double *gamma_b = new double[nqp_batch],
-   *rho_b = new double[nqp_batch],
-   *e_b   = new double[nqp_batch],
-   *p_b   = new double[nqp_batch],
-   *cs_b  = new double[nqp_batch];
-   // Jacobians of reference->physical transformations for all quadrature points
-   // in the batch.
-   DenseTensor *Jpr_b = new DenseTensor[nzones_batch];
-   for (int b = 0; b < nbatches; b++)
+   // cycle structure. With the zone-interleaved layout, a batch is one block.
+   const int simd_width = quad_data.simd_width;
+   const int nzones_batch = (simd_width > 0) ? simd_width : 3;
+   const int nbatches = (nzones + nzones_batch - 1) / nzones_batch;
+
+   // In fused mode the stress of a batch is stored in the layout of
+   // ZoneInterleavedData, with blocks of sw zones, and applied to the force
+   // right-hand sides right after the batch is done.
+   const int VsizeH1 = H1FESpace.GetVSize(), sw = max(simd_width, 1);
+   if (fused_force) { fused_rhs_thr = 0.0; }
+
+   // The estimates are also kept per batch, for the multirate levels. At a
+   // multirate synchronization point, only the active batches are updated.
+   double dt_est = quad_data.dt_est;
+   double rho_min = numeric_limits<double>::infinity(), rho_max = -rho_min,
+          p_min = rho_min, p_max = -rho_min, detJ_min = rho_min;
+   int nzones_updated = 0;
+   #pragma omp parallel num_threads(GetNumThreads()) \
+                        reduction(min:dt_est, rho_min, p_min, detJ_min) \
+                        reduction(max:rho_max, p_max) \
+                        reduction(+:nzones_updated)
    {
-      int z_id = b * nzones_batch; // Global index over zones.
-      // The last batch might not be full.
-      if (z_id == nzones) { break; }
-      else if (z_id + nzones_batch > nzones)
+      // Thread-local scratch data, see ZoneLoopWorkspace.
+      ZoneLoopWorkspace &ws = *zone_work[GetThreadId()];
+      Vector &stress_b = ws.stress_b, rhs_v_t;
+      if (fused_force)
       {
-         nzones_batch = nzones - z_id;
-         nqp_batch    = nqp * nzones_batch;
+         rhs_v_t.SetDataAndSize(fused_rhs_thr.GetData() +
+                                GetThreadId() * VsizeH1, VsizeH1);
       }
-
-      double min_detJ = numeric_limits<double>::infinity();
-      for (int z = 0; z < nzones_batch; z++)
+      Vector &e_vals = ws.e_vals, &e_loc = ws.e_loc;
+      Vector &vector_vals = ws.vector_vals;
+      DenseMatrix &Jpi = ws.Jpi, &sgrad_v = ws.sgrad_v, &Jinv = ws.Jinv,
+                  &stress = ws.stress, &stressJiT = ws.stressJiT,
+                  &vecvalMat = ws.vecvalMat;
+      DenseTensor &grad_v_ref = ws.grad_v_ref, &J0_ref = ws.J0_ref;
+      Array<int> &L2dofs = ws.L2dofs, &H1dofs = ws.H1dofs;
+      IsoparametricTransformation &T = ws.T;
+      double *gamma_b = ws.gamma_b.GetData(), *rho_b = ws.rho_b.GetData(),
+             *e_b = ws.e_b.GetData(), *p_b = ws.p_b.GetData(),
+             *cs_b = ws.cs_b.GetData();
+      // Jacobians of reference->physical transformations for all quadrature
+      // points in the batch.
+      DenseTensor *Jpr_b = ws.Jpr_b;
+
+      #pragma omp for schedule(static)
+      for (int b = 0; b < nbatches; b++)
       {
-         ElementTransformation *T = H1FESpace.GetElementTransformation(z_id);
-         Jpr_b[z].SetSize(dim, dim, nqp);
-
-         if (p_assembly)
+         if (mr_point > 0 && !MultirateActive(b, mr_point)) { continue; }
+         const int z_begin = b * nzones_batch; // Global index over zones.
+         // The last batch might not be full.
+         const int nz_b = min(nzones_batch, nzones - z_begin);
+         double dt_b = numeric_limits<double>::infinity();
+
+         double min_detJ = numeric_limits<double>::infinity();
+         for (int z = 0; z < nz_b; z++)
          {
-            // Energy values at quadrature point.
-            L2FESpace.GetElementDofs(z_id, L2dofs);
-            e.GetSubVector(L2dofs, e_loc);
-            evaluator->GetL2Values(e_loc, e_vals);
-
-            // All reference->physical Jacobians at the quadrature points.
-            H1FESpace.GetElementVDofs(z_id, H1dofs);
-            x.GetSubVector(H1dofs, vector_vals);
-            evaluator->GetVectorGrad(vecvalMat, Jpr_b[z]);
-         }
-         else { e.GetValues(z_id, integ_rule, e_vals); }
-         for (int q = 0; q < nqp; q++)
-         {
-            const IntegrationPoint &ip = integ_rule.IntPoint(q);
-            T->SetIntPoint(&ip);
-            if (!p_assembly) { Jpr_b[z](q) = T->Jacobian(); }
-            const double detJ = Jpr_b[z](q).Det();
-            min_detJ = min(min_detJ, detJ);
-
-            const int idx = z * nqp + q;
-            if (material_pcf == NULL) { gamma_b[idx] = 5./3.; } // Ideal gas.
-            else { gamma_b[idx] = material_pcf->Eval(*T, ip); }
-            rho_b[idx] = quad_data.rho0DetJ0w(z_id*nqp + q) / detJ / ip.weight;
-            e_b[idx]   = max(0.0, e_vals(q));
+            const int z_id = z_begin + z;
+            H1FESpace.GetMesh()->GetElementTransformation(z_id, &T);
+
+            if (p_assembly)
+            {
+               // Energy values at quadrature point.
+               L2FESpace.GetElementDofs(z_id, L2dofs);
+               e.GetSubVector(L2dofs, e_loc);
+               evaluator->GetL2Values(e_loc, e_vals);
+
+               // All reference->physical Jacobians at the quadrature points.
+               H1FESpace.GetElementVDofs(z_id, H1dofs);
+               x.GetSubVector(H1dofs, vector_vals);
+               evaluator->GetVectorGrad(vecvalMat, Jpr_b[z]);
+            }
+            else { e.GetValues(z_id, integ_rule, e_vals); }
+            const double *rho0DetJ0w_z =
+               quad_data.GetRho0DetJ0w(z_id, ws.rho0DetJ0w_z.GetData());
+            for (int q = 0; q < nqp; q++)
+            {
+               const IntegrationPoint &ip = integ_rule.IntPoint(q);
+               T.SetIntPoint(&ip);
+               if (!p_assembly) { Jpr_b[z](q) = T.Jacobian(); }
+               const double detJ = Jpr_b[z](q).Det();
+               min_detJ = min(min_detJ, detJ);
+
+               const int idx = z * nqp + q;
+               gamma_b[idx] = zone_gamma(z_id);
+               rho_b[idx] = rho0DetJ0w_z[q] / detJ / ip.weight;
+               e_b[idx]   = max(0.0, e_vals(q));
+            }
          }
-         ++z_id;
-      }
 
-      // Batched computation of material properties.
-      ComputeMaterialProperties(nqp_batch, gamma_b, rho_b, e_b, p_b, cs_b);
+         // Batched computation of material properties.
+         ComputeMaterialProperties(nqp * nz_b, gamma_b, rho_b, e_b, p_b, cs_b);
 
-      z_id -= nzones_batch;
-      for (int z = 0; z < nzones_batch; z++)
-      {
-         ElementTransformation *T = H1FESpace.GetElementTransformation(z_id);
-         if (p_assembly)
+         if (simd_width > 0)
          {
-            // All reference->physical Jacobians at the quadrature points.
-            H1FESpace.GetElementVDofs(z_id, H1dofs);
-            v.GetSubVector(H1dofs, vector_vals);
-            evaluator->GetVectorGrad(vecvalMat, grad_v_ref);
-         }
-         for (int q = 0; q < nqp; q++)
-         {
-            const IntegrationPoint &ip = integ_rule.IntPoint(q);
-            T->SetIntPoint(&ip);
-            // Note that the Jacobian was already computed above. We've chosen
-            // not to store the Jacobians for all batched quadrature points.
-            const DenseMatrix &Jpr = Jpr_b[z](q);
-            CalcInverse(Jpr, Jinv);
-            const double detJ = Jpr.Det(), rho = rho_b[z*nqp + q],
-                         p = p_b[z*nqp + q], sound_speed = cs_b[z*nqp + q];
-
-            stress = 0.0;
-            for (int d = 0; d < dim; d++) { stress(d, d) = -p; }
-
-            double visc_coeff = 0.0;
-            if (use_viscosity)
+            // Zone-interleaved layout: the zones of the block are processed
+            // together, point by point, in loops over the zones of the block
+            // with contiguous data. The sum factorization evaluations of the
+            // Jacobians and velocity gradients stay per zone, and so do the
+            // eigenvalues and singular values at each point.
+            const int W = simd_width, dd = dim * dim;
+            double *Jpr_w = ws.Jpr_w.GetData(),
+                   *grad_v_w = ws.grad_v_w.GetData(),
+                   *J0_w = ws.J0_w.GetData(), *Jinv_w = ws.Jinv_w.GetData(),
+                   *detJ_w = ws.detJ_w.GetData(),
+                   *sgrad_v_w = ws.sgrad_v_w.GetData(),
+                   *Jac0inv_w = ws.Jac0inv_w.GetData(),
+                   *visc_w = ws.visc_w.GetData();
+            for (int w = 0; w < nz_b; w++)
             {
-               // Compression-based length scale at the point. The first
-               // eigenvector of the symmetric velocity gradient gives the
-               // direction of maximal compression. This is used to define the
-               // relative change of the initial length scale.
-               if (p_assembly)
+               const int z_id = z_begin + w;
+               if (use_viscosity)
                {
-                  mfem::Mult(grad_v_ref(q), Jinv, sgrad_v);
+                  H1FESpace.GetElementVDofs(z_id, H1dofs);
+                  v.GetSubVector(H1dofs, vector_vals);
+                  evaluator->GetVectorGrad(vecvalMat, grad_v_ref);
+                  if (recompute_jac0inv)
+                  {
+                     x0.GetSubVector(H1dofs, vector_vals);
+                     evaluator->GetVectorGrad(vecvalMat, J0_ref);
+                  }
                }
-               else
+               for (int q = 0; q < nqp; q++)
                {
-                  v.GetVectorGradient(*T, sgrad_v);
+                  for (int i = 0; i < dim; i++)
+                  {
+                     for (int j = 0; j < dim; j++)
+                     {
+                        const int idx = (q*dd + i*dim + j) * W + w;
+                        Jpr_w[idx] = Jpr_b[w](i, j, q);
+                        if (!use_viscosity) { continue; }
+                        grad_v_w[idx] = grad_v_ref(i, j, q);
+                        if (recompute_jac0inv) { J0_w[idx] = J0_ref(i, j, q); }
+                     }
+                  }
                }
-               sgrad_v.Symmetrize();
-               double eig_val_data[3], eig_vec_data[9];
-               if (dim==1)
-               {
-                  eig_val_data[0] = sgrad_v(0, 0);
-                  eig_vec_data[0] = 1.;
-               }
-               else { sgrad_v.CalcEigenvalues(eig_val_data, eig_vec_data); }
-               Vector compr_dir(eig_vec_data, dim);
-               // Computes the initial->physical transformation Jacobian.
-               mfem::Mult(Jpr, quad_data.Jac0inv(z_id*nqp + q), Jpi);
-               Vector ph_dir(dim); Jpi.Mult(compr_dir, ph_dir);
-               // Change of the initial mesh size in the compression direction.
-               const double h = quad_data.h0 * ph_dir.Norml2() /
-                                compr_dir.Norml2();
-
-               // Measure of maximal compression.
-               const double mu = eig_val_data[0];
-               visc_coeff = 2.0 * rho * h * h * fabs(mu);
-               // The following represents a "smooth" version of the statement
-               // "if (mu < 0) visc_coeff += 0.5 rho h sound_speed".  Note that
-               // eps must be scaled appropriately if a different unit system is
-               // being used.
-               const double eps = 1e-12;
-               visc_coeff += 0.5 * rho * h * sound_speed *
-                             (1.0 - smooth_step_01(mu - 2.0 * eps, eps));
-
-               stress.Add(visc_coeff, sgrad_v);
             }
 
-            // Time step estimate at the point. Here the more relevant length
-            // scale is related to the actual mesh deformation; we use the min
-            // singular value of the ref->physical Jacobian. In addition, the
-            // time step estimate should be aware of the presence of shocks.
-            const double h_min =
-               Jpr.CalcSingularvalue(dim-1) / (double) H1FESpace.GetOrder(0);
-            const double inv_dt = sound_speed / h_min +
-                                  2.5 * visc_coeff / rho / h_min / h_min;
-            if (min_detJ < 0.0)
+            for (int q = 0; q < nqp; q++)
             {
-               // This will force repetition of the step with smaller dt.
-               quad_data.dt_est = 0.0;
+               const double *Jpr_q = Jpr_w + q*dd*W;
+               CalcBlockInverse(dim, W, nz_b, Jpr_q, Jinv_w, detJ_w);
+               for (int w = 0; w < nz_b; w++)
+               {
+                  const double rho = rho_b[w*nqp + q], p = p_b[w*nqp + q];
+                  rho_min = min(rho_min, rho);
+                  rho_max = max(rho_max, rho);
+                  p_min = min(p_min, p);
+                  p_max = max(p_max, p);
+                  detJ_min = min(detJ_min, detJ_w[w]);
+                  visc_w[w] = 0.0;
+               }
+
+               if (use_viscosity)
+               {
+                  // Symmetric part of the physical velocity gradient.
+                  const double *grad_v_q = grad_v_w + q*dd*W;
+                  for (int i = 0; i < dim; i++)
+                  {
+                     for (int j = 0; j < dim; j++)
+                     {
+                        double *s_ij = sgrad_v_w + (i*dim + j)*W;
+                        for (int w = 0; w < nz_b; w++) { s_ij[w] = 0.0; }
+                        for (int k = 0; k < dim; k++)
+                        {
+                           const double *g_ik = grad_v_q + (i*dim + k)*W,
+                                         *Ji_kj = Jinv_w + (k*dim + j)*W;
+                           for (int w = 0; w < nz_b; w++)
+                           {
+                              s_ij[w] += g_ik[w] * Ji_kj[w];
+                           }
+                        }
+                     }
+                  }
+                  for (int i = 0; i < dim; i++)
+                  {
+                     for (int j = 0; j < i; j++)
+                     {
+                        double *s_ij = sgrad_v_w + (i*dim + j)*W,
+                                *s_ji = sgrad_v_w + (j*dim + i)*W;
+                        for (int w = 0; w < nz_b; w++)
+                        {
+                           s_ij[w] = s_ji[w] = 0.5 * (s_ij[w] + s_ji[w]);
+                        }
+                     }
+                  }
+
+                  // Initial inverse Jacobians of the zones of the block.
+                  if (recompute_jac0inv)
+                  {
+                     CalcBlockInverse(dim, W, nz_b, J0_w + q*dd*W, Jac0inv_w,
+                                      NULL);
+                  }
+                  else if (quad_data.Jac0inv_zf.NumZones() > 0)
+                  {
+                     for (int c = 0; c < dd; c++)
+                     {
+                        const float *J0i =
+                           &quad_data.Jac0inv_zf(z_begin, c, q);
+                        for (int w = 0; w < nz_b; w++)
+                        {
+                           Jac0inv_w[c*W + w] = J0i[w];
+                        }
+                     }
+                  }
+                  else
+                  {
+                     for (int c = 0; c < dd; c++)
+                     {
+                        const double *J0i =
+                           &quad_data.Jac0inv_zi(z_begin, c, q);
+                        for (int w = 0; w < nz_b; w++)
+                        {
+                           Jac0inv_w[c*W + w] = J0i[w];
+                        }
+                     }
+                  }
+
+                  // Compression-based length scale and viscosity coefficient,
+                  // see the standard layout below.
+                  for (int w = 0; w < nz_b; w++)
+                  {
+                     for (int c = 0; c < dd; c++)
+                     {
+                        sgrad_v(c / dim, c % dim) = sgrad_v_w[c*W + w];
+                     }
+                     double eig_val_data[3], eig_vec_data[9];
+                     if (dim==1)
+                     {
+                        eig_val_data[0] = sgrad_v(0, 0);
+                        eig_vec_data[0] = 1.;
+                     }
+                     else
+                     {
+                        sgrad_v.CalcEigenvalues(eig_val_data, eig_vec_data);
+                     }
+                     // ph_dir = Jpr Jac0inv compr_dir.
+                     double J0i_dir[3], ph_dir2 = 0.0, dir2 = 0.0;
+                     for (int i = 0; i < dim; i++)
+                     {
+                        J0i_dir[i] = 0.0;
+                        for (int j = 0; j < dim; j++)
+                        {
+                           J0i_dir[i] += Jac0inv_w[(i*dim + j)*W + w] *
+                                         eig_vec_data[j];
+                        }
+                        dir2 += eig_vec_data[i] * eig_vec_data[i];
+                     }
+                     for (int i = 0; i < dim; i++)
+                     {
+                        double ph_i = 0.0;
+                        for (int j = 0; j < dim; j++)
+                        {
+                           ph_i += Jpr_q[(i*dim + j)*W + w] * J0i_dir[j];
+                        }
+                        ph_dir2 += ph_i * ph_i;
+                     }
+                     const double h = quad_data.h0 * sqrt(ph_dir2 / dir2);
+
+                     const double mu = eig_val_data[0],
+                                  rho = rho_b[w*nqp + q],
+                                  sound_speed = cs_b[w*nqp + q],
+                                  eps = 1e-12;
+                     visc_w[w] = 2.0 * rho * h * h * fabs(mu) +
+                                 0.5 * rho * h * sound_speed *
+                                 (1.0 - smooth_step_01(mu - 2.0 * eps, eps));
+                  }
+               }
+
+               // Time step estimate, with the min singular value of the
+               // ref->physical Jacobian of each zone.
+               for (int w = 0; w < nz_b; w++)
+               {
+                  for (int c = 0; c < dd; c++)
+                  {
+                     Jpi(c / dim, c % dim) = Jpr_q[c*W + w];
+                  }
+                  const double rho = rho_b[w*nqp + q],
+                               sound_speed = cs_b[w*nqp + q];
+                  const double h_min = Jpi.CalcSingularvalue(dim-1) /
+                                       (double) H1FESpace.GetOrder(0);
+                  const double inv_dt = sound_speed / h_min +
+                                        2.5 * visc_w[w] / rho / h_min / h_min;
+                  if (min_detJ < 0.0) { dt_b = 0.0; }
+                  else { dt_b = min(dt_b, cfl * (1.0 / inv_dt)); }
+               }
+
+               // Quadrature data for partial assembly of the force operator:
+               // (-p I + visc sgrad_v) Jinv^T, times the weight and detJ.
+               const double weight = integ_rule.IntPoint(q).weight;
+               for (int vd = 0; vd < dim; vd++)
+               {
+                  for (int gd = 0; gd < dim; gd++)
+                  {
+                     const int c = vd*dim + gd;
+                     double *sJiT = NULL;
+                     float *sJiT_f = NULL;
+                     if (fused_force)
+                     {
+                        sJiT = stress_b.GetData() + (c*nqp + q) * sw;
+                     }
+                     else if (quad_data.single_qdata)
+                     {
+                        sJiT_f = &quad_data.stressJinvT_zf(z_begin, c, q);
+                     }
+                     else { sJiT = &quad_data.stressJinvT_zi(z_begin, c, q); }
+                     const double *Ji_gv = Jinv_w + (gd*dim + vd)*W;
+                     for (int w = 0; w < nz_b; w++)
+                     {
+                        double sJ = -p_b[w*nqp + q] * Ji_gv[w];
+                        if (use_viscosity)
+                        {
+                           for (int k = 0; k < dim; k++)
+                           {
+                              sJ += visc_w[w] * sgrad_v_w[(vd*dim + k)*W + w] *
+                                    Jinv_w[(gd*dim + k)*W + w];
+                           }
+                        }
+                        sJ *= weight * detJ_w[w];
+                        if (sJiT) { sJiT[w] = sJ; }
+                        else { sJiT_f[w] = (float) sJ; }
+                     }
+                  }
+               }
             }
-            else
+         }
+         else
+         {
+            for (int z = 0; z < nz_b; z++)
             {
-               quad_data.dt_est = min(quad_data.dt_est, cfl * (1.0 / inv_dt) );
+               const int z_id = z_begin + z;
+               H1FESpace.GetMesh()->GetElementTransformation(z_id, &T);
+               if (p_assembly)
+               {
+                  // All reference->physical Jacobians at the quadrature points.
+                  H1FESpace.GetElementVDofs(z_id, H1dofs);
+                  v.GetSubVector(H1dofs, vector_vals);
+                  evaluator->GetVectorGrad(vecvalMat, grad_v_ref);
+                  if (recompute_jac0inv && use_viscosity)
+                  {
+                     // Initial Jacobians, inverted below at each point.
+                     x0.GetSubVector(H1dofs, vector_vals);
+                     evaluator->GetVectorGrad(vecvalMat, J0_ref);
+                  }
+               }
+               for (int q = 0; q < nqp; q++)
+               {
+                  const IntegrationPoint &ip = integ_rule.IntPoint(q);
+                  T.SetIntPoint(&ip);
+                  // Note that the Jacobian was already computed above. We've
+                  // chosen not to store the Jacobians for all batched
+                  // quadrature points.
+                  const DenseMatrix &Jpr = Jpr_b[z](q);
+                  CalcInverse(Jpr, Jinv);
+                  const double detJ = Jpr.Det(), rho = rho_b[z*nqp + q],
+                               p = p_b[z*nqp + q],
+                               sound_speed = cs_b[z*nqp + q];
+                  rho_min = min(rho_min, rho);
+                  rho_max = max(rho_max, rho);
+                  p_min = min(p_min, p);
+                  p_max = max(p_max, p);
+                  detJ_min = min(detJ_min, detJ);
+
+                  stress = 0.0;
+                  for (int d = 0; d < dim; d++) { stress(d, d) = -p; }
+
+                  double visc_coeff = 0.0;
+                  if (use_viscosity)
+                  {
+                     // Compression-based length scale at the point. The first
+                     // eigenvector of the symmetric velocity gradient gives the
+                     // direction of maximal compression. This is used to define
+                     // the relative change of the initial length scale.
+                     if (p_assembly)
+                     {
+                        mfem::Mult(grad_v_ref(q), Jinv, sgrad_v);
+                     }
+                     else
+                     {
+                        v.GetVectorGradient(T, sgrad_v);
+                     }
+                     sgrad_v.Symmetrize();
+                     double eig_val_data[3], eig_vec_data[9];
+                     if (dim==1)
+                     {
+                        eig_val_data[0] = sgrad_v(0, 0);
+                        eig_vec_data[0] = 1.;
+                     }
+                     else
+                     {
+                        sgrad_v.CalcEigenvalues(eig_val_data, eig_vec_data);
+                     }
+                     Vector compr_dir(eig_vec_data, dim);
+                     // Computes the initial->physical transformation
+                     // Jacobian. DenseTensor::operator() reuses an internal
+                     // matrix, so the shared tensor is accessed through a
+                     // thread-local view.
+                     if (recompute_jac0inv)
+                     {
+                        CalcInverse(J0_ref(q), ws.Jac0inv);
+                        mfem::Mult(Jpr, ws.Jac0inv, Jpi);
+                     }
+                     else
+                     {
+                        DenseMatrix Jac0inv(
+                           quad_data.Jac0inv.GetData(z_id*nqp + q), dim, dim);
+                        mfem::Mult(Jpr, Jac0inv, Jpi);
+                     }
+                     double ph_dir_data[3];
+                     Vector ph_dir(ph_dir_data, dim);
+                     Jpi.Mult(compr_dir, ph_dir);
+                     // Change of the initial mesh size in the compression
+                     // direction.
+                     const double h = quad_data.h0 * ph_dir.Norml2() /
+                                      compr_dir.Norml2();
+
+                     // Measure of maximal compression.
+                     const double mu = eig_val_data[0];
+                     visc_coeff = 2.0 * rho * h * h * fabs(mu);
+                     // The following represents a "smooth" version of the
+                     // statement "if (mu < 0) visc_coeff += 0.5 rho h
+                     // sound_speed".  Note that eps must be scaled
+                     // appropriately if a different unit system is being used.
+                     const double eps = 1e-12;
+                     visc_coeff += 0.5 * rho * h * sound_speed *
+                                   (1.0 - smooth_step_01(mu - 2.0 * eps, eps));
+
+                     stress.Add(visc_coeff, sgrad_v);
+                  }
+
+                  // Time step estimate at the point. Here the more relevant
+                  // length scale is related to the actual mesh deformation; we
+                  // use the min singular value of the ref->physical Jacobian.
+                  // In addition, the time step estimate should be aware of the
+                  // presence of shocks.
+                  const double h_min = Jpr.CalcSingularvalue(dim-1) /
+                                       (double) H1FESpace.GetOrder(0);
+                  const double inv_dt = sound_speed / h_min +
+                                        2.5 * visc_coeff / rho / h_min / h_min;
+                  if (min_detJ < 0.0)
+                  {
+                     // This will force repetition of the step with smaller dt.
+                     dt_b = 0.0;
+                  }
+                  else
+                  {
+                     dt_b = min(dt_b, cfl * (1.0 / inv_dt) );
+                  }
+
+                  // Quadrature data for partial assembly of the force operator.
+                  MultABt(stress, Jinv, stressJiT);
+                  stressJiT *= integ_rule.IntPoint(q).weight * detJ;
+                  for (int vd = 0 ; vd < dim; vd++)
+                  {
+                     for (int gd = 0; gd < dim; gd++)
+                     {
+                        if (fused_force)
+                        {
+                           const int c = vd*dim + gd;
+                           stress_b((z*dim*dim + c) * nqp + q) =
+                              stressJiT(vd, gd);
+                        }
+                        else
+                        {
+                           quad_data.stressJinvT(z_id*nqp + q, gd, vd) =
+                              stressJiT(vd, gd);
+                        }
+                     }
+                  }
+               }
             }
+         }
+
+         if (fused_force)
+         {
+            // Apply the stress of the batch to both force right-hand sides.
+            ForcePA.MultZones(stress_b.GetData(), z_begin, z_begin + nz_b,
+                              one_l2, rhs_v_t);
+            ForcePA.MultTransposeZones(stress_b.GetData(), z_begin,
+                                       z_begin + nz_b, v, fused_rhs_e);
+         }
+         batch_dt_est(b) = dt_b;
+         dt_est = min(dt_est, dt_b);
+         nzones_updated += nz_b;
+      }
 
-            // Quadrature data for partial assembly of the force operator.
-            MultABt(stress, Jinv, stressJiT);
-            stressJiT *= integ_rule.IntPoint(q).weight * detJ;
-            for (int vd = 0 ; vd < dim; vd++)
+      if (fused_force)
+      {
+         // Sum the per-thread H1 contributions, always in the same order.
+         #pragma omp for schedule(static)
+         for (int i = 0; i < VsizeH1; i++)
+         {
+            double sum = 0.0;
+            for (int t = 0; t < nthreads; t++)
             {
-               for (int gd = 0; gd < dim; gd++)
-               {
-                  quad_data.stressJinvT(vd)(z_id*nqp + q, gd) =
-                     stressJiT(vd, gd);
-               }
+               sum += fused_rhs_thr(t * VsizeH1 + i);
             }
+            fused_rhs_v(i) = sum;
          }
-         ++z_id;
       }
    }
-
-   delete [] gamma_b;
-   delete [] rho_b;
-   delete [] e_b;
-   delete [] p_b;
-   delete [] cs_b;
-   delete [] Jpr_b;
+   quad_data.dt_est = dt_est;
+   quad_data.rho_min = rho_min;
+   quad_data.rho_max = rho_max;
+   quad_data.p_min = p_min;
+   quad_data.p_max = p_max;
+   quad_data.detJ_min = detJ_min;
    quad_data_is_current = true;
    forcemat_is_assembled = false;
 
-   timer.sw_qdata.Stop();
-   timer.quad_tstep += nzones;
+   profiler.End();
+   timer.quad_tstep += nzones_updated;
+   if (p_assembly)
+   {
+      timer.quad += quad_cost * ((double) nzones_updated / nzones);
+   }
+}
+
+void LagrangianHydroOperator::AssembleEnergySource() const
+{
+   // The L2 zones do not share dofs, so each thread sets its own entries.
+   #pragma omp parallel num_threads(GetNumThreads())
+   {
+      ZoneLoopWorkspace &ws = *zone_work[GetThreadId()];
+      DomainLFIntegrator lfi(*e_source_coeff, &integ_rule);
+      #pragma omp for schedule(static)
+      for (int z = 0; z < nzones; z++)
+      {
+         L2FESpace.GetMesh()->GetElementTransformation(z, &ws.T);
+         lfi.AssembleRHSElementVect(*L2FESpace.GetFE(z), ws.T, ws.loc_rhs);
+         L2FESpace.GetElementDofs(z, ws.L2dofs);
+         e_source.SetSubVector(ws.L2dofs, ws.loc_rhs);
+      }
+   }
 }
 
 void LagrangianHydroOperator::AssembleForceMatrix() const
@@ -695,9 +2164,9 @@ void LagrangianHydroOperator::AssembleForceMatrix() const
    if (forcemat_is_assembled || p_assembly) { return; }
 
    Force = 0.0;
-   timer.sw_force.Start();
+   profiler.Begin("Force");
    Force.Assemble();
-   timer.sw_force.Stop();
+   profiler.End();
 
    forcemat_is_assembled = true;
 }
@@ -19,6 +19,7 @@
 
 #include "mfem.hpp"
 #include "laghos_assembly.hpp"
+#include "laghos_diagnostics.hpp"
 
 #ifdef MFEM_USE_MPI
 
@@ -36,19 +37,171 @@ void VisualizeField(socketstream &sock, const char *vishost, int visport,
                     int x = 0, int y = 0, int w = 400, int h = 400,
                     bool vec = false);
 
-struct TimingData
+// Pipelined preconditioned conjugate gradient method of Ghysels and Vanroose.
+// Mathematically equivalent to CGSolver, but the two inner products of each
+// iteration are combined in a single nonblocking reduction, which is overlapped
+// with the preconditioner and the operator applications. The stopping criterion
+// is the one of CGSolver, based on the preconditioned residual norm (B r, r).
+class PipelinedCGSolver : public IterativeSolver
+{
+protected:
+   mutable Vector r, u, w, m, n, z, q, s, p;
+
+   void UpdateVectors();
+
+public:
+   PipelinedCGSolver(MPI_Comm comm_) : IterativeSolver(comm_) { }
+
+   virtual void SetOperator(const Operator &op)
+   { IterativeSolver::SetOperator(op); UpdateVectors(); }
+
+   virtual void Mult(const Vector &b, Vector &x) const;
+
+   // The recursively updated residual b - A x of the last Mult.
+   const Vector &GetResidual() const { return r; }
+};
+
+// CGSolver that gives access to the recursively updated residual b - A x of
+// its last Mult.
+class ResidualCGSolver : public CGSolver
+{
+public:
+   ResidualCGSolver(MPI_Comm comm_) : CGSolver(comm_) { }
+
+   const Vector &GetResidual() const { return r; }
+};
+
+// Keeps the last (at most max_size) solutions x_i of A x_i = b_i, for a fixed
+// SPD operator A, and computes initial guesses for new right-hand sides by a
+// Galerkin projection onto their span. Each solve adds a single global
+// reduction: the entries of the Galerkin matrix for a new solution are computed
+// together with the projection of the next right-hand side.
+class RecycledSubspace
+{
+protected:
+   MPI_Comm comm;
+   const int max_size;
+   int size, oldest;
+
+   // The stored solutions, one after the other, and A x_k for the solution
+   // whose row k of G is still to be computed (k = pending, or -1 if none).
+   Vector xs, Ax;
+   int pending;
+
+   // Galerkin matrix, G_ij = x_i^T A x_j.
+   DenseMatrix G;
+
+   // Work space of the projections, with room for the max_size entries of
+   // x_j^T b, the max_size entries of x_j^T A x_k and one more inner product.
+   // Only the leading size x size block of L is used.
+   Vector loc, g;
+   DenseMatrix L;
+
+public:
+   RecycledSubspace(MPI_Comm comm_, int max_size_)
+      : comm(comm_), max_size(max_size_), size(0), oldest(0), pending(-1),
+        G(max_size_), loc(2*max_size_ + 1), g(2*max_size_ + 1), L(max_size_) { }
+
+   int MaxSize() const { return max_size; }
+
+   // Sets x to the A-orthogonal projection of A^{-1} b onto the stored span,
+   // and returns the global inner product (c, b), which is reduced together
+   // with the projection. The vector x is not changed if there are no stored
+   // solutions.
+   double InitialGuess(const Vector &b, const Vector &c, Vector &x);
+
+   // Stores the solution x with final residual r = b - A x, replacing the
+   // oldest solution when max_size is reached. A x is taken as b - r, and the
+   // inner products with the other solutions are left to the next
+   // InitialGuess.
+   void Add(const Vector &x, const Vector &b, const Vector &r);
+
+   // Binary I/O of the stored solutions and of G, for the checkpoints.
+   void Save(std::ostream &os) const;
+   void Load(std::istream &is);
+};
+
+// Thread-local scratch data of the zone loops of LagrangianHydroOperator, which
+// is allocated once, in the constructor.
+struct ZoneLoopWorkspace
 {
-   // Total times for all major computations:
-   // CG solves (H1 and L2) / force RHS assemblies / quadrature computations.
-   StopWatch sw_cgH1, sw_cgL2, sw_force, sw_qdata;
+   // UpdateQuadratureData: batch values at all quadrature points, and the
+   // reference->physical Jacobians of the zones of the batch.
+   Vector stress_b, gamma_b, rho_b, e_b, p_b, cs_b;
+   DenseTensor *Jpr_b;
+   Vector e_vals, rho0DetJ0w_z, e_loc, vector_vals;
+   DenseMatrix Jpi, sgrad_v, Jinv, stress, stressJiT, vecvalMat;
+   DenseTensor grad_v_ref, J0_ref;
+   DenseMatrix Jac0inv;
+   Array<int> L2dofs, H1dofs;
+   IsoparametricTransformation T;
+
+   // UpdateQuadratureData with the zone-interleaved layout: the Jacobians,
+   // velocity gradients and initial Jacobians of a block at all points, then
+   // the inverse Jacobians, determinants, symmetric velocity gradients and
+   // viscosity coefficients of the block at one point. Each entry holds the
+   // values of the zones of the block contiguously, as in ZoneInterleavedData.
+   Vector Jpr_w, grad_v_w, J0_w, Jinv_w, detJ_w, sgrad_v_w, Jac0inv_w, visc_w;
+
+   // SolveEnergy: zone right-hand side and solution.
+   Vector loc_rhs, loc_de;
+
+   ZoneLoopWorkspace(int dim, int nqp, int nzones_batch, int h1dofs_cnt,
+                     int l2dofs_cnt, bool fused, bool interleaved);
+
+   ~ZoneLoopWorkspace() { delete [] Jpr_b; }
+};
 
+// Work counters of the major computations. Their times are measured by the
+// profiler regions "CG (H1)", "CG (L2)", "Force" and "UpdateQuadData".
+struct TimingData
+{
    // These accumulate the total processed dofs or quad points:
    // #(CG iterations) for the H1 CG solve.
    // #dofs  * #(CG iterations) for the L2 CG solve.
    // #quads * #(RK sub steps) for the quadrature data computations.
    int H1cg_iter, L2dof_iter, quad_tstep;
 
-   TimingData() : H1cg_iter(0), L2dof_iter(0), quad_tstep(0) { }
+   // Global reductions added to the H1 CG solves by the warm start.
+   int H1cg_reductions;
+
+   // Partial assembly: analytic costs of the force actions, the quadrature
+   // data updates and the energy solves of this rank.
+   KernelCost force, quad, energy;
+
+   TimingData()
+      : H1cg_iter(0), L2dof_iter(0), quad_tstep(0), H1cg_reductions(0) { }
+
+   TimingData &operator+=(const TimingData &t)
+   {
+      H1cg_iter += t.H1cg_iter; L2dof_iter += t.L2dof_iter;
+      quad_tstep += t.quad_tstep; H1cg_reductions += t.H1cg_reductions;
+      force += t.force; quad += t.quad; energy += t.energy;
+      return *this;
+   }
+};
+
+// Partial assembly kernels with analytic costs, and the names of the profiler
+// regions that measure their times.
+enum RooflineKernel { RL_FORCE, RL_MASS, RL_QUAD, RL_ENERGY, RL_NUM_KERNELS };
+const char *RooflineRegionName(int k);
+
+// Times (max over the ranks, in seconds) and rates of the major computations,
+// as printed by PrintTimingData. The rates are in the units printed there,
+// e.g., megadofs x cg_iterations / second for the CG solves.
+struct TimingSummary
+{
+   HYPRE_Int H1gsize, L2gsize;
+   int steps, H1cg_iter, H1cg_reductions;
+   bool fused_force;
+   double H1cg_time, H1cg_rate, L2cg_time, L2cg_rate,
+          force_time, force_rate, quad_time, quad_rate,
+          total_time, total_rate;
+
+   // Partial assembly only: the achieved GFLOP/s and GB/s over all ranks of
+   // the RooflineKernel kernels, and the STREAM triad bandwidth of all ranks
+   // in GB/s (0 when it was not measured).
+   double gflops[RL_NUM_KERNELS], gbytes[RL_NUM_KERNELS], stream_bw;
 };
 
 // Given a solutions state (x, v, e), this class performs all necessary
@@ -65,16 +218,36 @@ protected:
 
    const int dim, nzones, l2dofs_cnt, h1dofs_cnt, source_type;
    const double cfl;
-   const bool use_viscosity, p_assembly;
+   const bool use_viscosity, p_assembly, fused_force;
    const double cg_rel_tol;
    const int cg_max_iter;
+   // Use PipelinedCGSolver for the velocity linear solve.
+   const bool pipelined_cg;
+   IterativeSolver *velocity_cg;
+   // Final residual of the last velocity_cg solve.
+   const Vector *velocity_cg_r;
+   // Previous velocity solutions, used for the initial guesses when the
+   // velocity linear solve is warm-started.
+   mutable RecycledSubspace dv_history;
    Coefficient *material_pcf;
+   // Adiabatic index of each zone, from material_pcf at the zone centers. The
+   // material field is piecewise constant, and evaluating the coefficient in
+   // the threaded zone loops would share the scratch data of its elements.
+   Vector zone_gamma;
 
    // Velocity mass matrix and local inverses of the energy mass matrices. These
    // are constant in time, due to the pointwise mass conservation property.
+   // With partial assembly, they are assembled only when dense_mass is set;
+   // otherwise the energies are computed with VMassPA and locEMassPA, and the
+   // setup cost scales with the number of quadrature points.
+   const bool dense_mass;
    mutable ParBilinearForm Mv;
    SparseMatrix Mv_spmat_copy;
-   DenseTensor Me, Me_inv;
+   // Full assembly: the parallel velocity mass matrix with eliminated essential
+   // dofs, its eliminated part, and its preconditioner. These are set up once.
+   HypreParMatrix *Mv_A, *Mv_Ae;
+   Solver *Mv_prec;
+   mutable DenseTensor Me, Me_inv;
 
    // Integration rule for all assemblies.
    const IntegrationRule &integ_rule;
@@ -84,6 +257,25 @@ protected:
    mutable QuadratureData quad_data;
    mutable bool quad_data_is_current, forcemat_is_assembled;
 
+   // Partial assembly: when set, quad_data.Jac0inv is not stored. The initial
+   // Jacobians are recomputed per zone from the initial node positions x0,
+   // with FastEvaluator::GetVectorGrad, and inverted where they are needed.
+   const bool recompute_jac0inv;
+   Vector x0;
+
+   // Nonblocking MIN reduction of quad_data.dt_est, see StartTimeStepEstimate.
+   mutable double dt_est_local, dt_est_global;
+   mutable MPI_Request dt_est_request;
+
+   // Early abort of a step on mesh tangling. In each stage, the global min of
+   // the Jacobian determinants is reduced while the forces are computed, and
+   // when it is not positive, the remaining solves of the step are skipped
+   // and their slopes are zero. The min determinant and the time of the last
+   // untangled stage, and of the tangled one, are kept for RetryTimeStep.
+   mutable bool step_aborted;
+   mutable double detJ_local, detJ_global, ok_detJ, ok_time, bad_detJ, bad_time;
+   mutable MPI_Request detJ_request;
+
    // Force matrix that combines the kinematic and thermodynamic spaces. It is
    // assembled in each time step and then it is used to compute the final
    // right-hand sides for momentum and specific internal energy.
@@ -92,16 +284,69 @@ protected:
    // Same as above, but done through partial assembly.
    ForcePAOperator ForcePA;
 
+   // Force right-hand sides, (Force * 1) for the momentum and (Force^T * v)
+   // for the energy, when they are computed together with the quadrature data
+   // (fused mode). Then stressJinvT is never stored; the H1 sums are
+   // accumulated per thread in fused_rhs_thr.
+   mutable Vector fused_rhs_v, fused_rhs_e, fused_rhs_thr;
+
    // Mass matrices done through partial assembly:
    // velocity (coupled H1 assembly) and energy (local L2 assemblies).
    mutable MassPAOperator VMassPA;
    mutable DiagonalSolver VMassPA_prec;
-   mutable LocalMassPAOperator locEMassPA;
-
-   // Linear solver for energy.
-   CGSolver locCG;
+   // Used instead of VMassPA_prec when its degree is positive.
+   const int cheb_degree;
+   mutable ChebyshevSolver VMassPA_cheb;
+
+   // Local energy mass operators and their linear solvers, one per thread. The
+   // operator stores the current zone id and the solver its work vectors.
+   const int nthreads;
+   Array<LocalMassPAOperator *> locEMassPA;
+   Array<CGSolver *> locCG;
+   // Used instead of the local solvers above when not NULL.
+   BatchedEnergyMassSolver *EMassPA_batched;
+
+   // Partial assembly: the velocity mass operator in true dofs, with the
+   // essential dofs eliminated. It is set up once, like Mv_A.
+   ConstrainedOperator *VMassPA_c;
+
+   // Work vectors of the time steps, allocated once: a vector of ones in L2,
+   // the force right-hand sides in H1 and L2, the true dof vectors of the
+   // velocity solve, and the mass action of the kinetic energy.
+   mutable Vector one_l2, rhs_h1, rhs_l2, B_tdof, X_tdof, Bb_tdof, Mv_v;
+   Array<ZoneLoopWorkspace *> zone_work;
+
+   // Energy source of the Taylor-Green problem, NULL for other problems. The
+   // source is fixed in space, but its integrals over the zones change when the
+   // mesh moves, so e_source is reassembled in every SolveEnergy call.
+   Coefficient *e_source_coeff;
+   mutable Vector e_source;
+
+   // Multirate time stepping, see MultirateKick. The zone batches of
+   // UpdateQuadratureData are the zone groups: batch_dt_est has the time step
+   // estimate of each batch from its last update, and a batch of level k
+   // takes steps of 2^k fine steps. At a synchronization point m > 0 of a
+   // step, mr_point is m and UpdateQuadratureData updates only the batches
+   // that are active at m, see MultirateActive; otherwise mr_point is -1.
+   mutable Vector batch_dt_est;
+   mutable Array<int> batch_level;
+   mutable int mr_point;
+   // The zone ranges of the active batches, the kick weight of each zone (0
+   // in the inactive ones), the rate of the specific internal energy of each
+   // zone from its last kick, the predicted state of the quadrature data
+   // update, and the velocity increment of the last kick of each class of
+   // synchronization points, see MultirateKick.
+   mutable Array<int> mr_zones;
+   mutable Vector mr_weight, mr_e_rate, mr_state, mr_dv, mr_de;
+   mutable Array<bool> mr_dv_set;
 
    mutable TimingData timer;
+   // Partial assembly: the analytic costs of the force Mult and MultTranspose,
+   // VMassPA.Mult and UpdateQuadratureData on all local zones, and of one
+   // energy solver iteration in one zone. Then the total memory bandwidth
+   // (bytes / second) of all ranks, for the roofline report.
+   KernelCost force_cost, forceT_cost, mass_cost, quad_cost, emass_cost;
+   double stream_bw;
 
    virtual void ComputeMaterialProperties(int nvalues, const double gamma[],
                                           const double rho[], const double e[],
@@ -115,7 +360,22 @@ protected:
    }
 
    void UpdateQuadratureData(const Vector &S) const;
+   // Solves A X = B with velocity_cg, which must be set to use A and prec.
+   void SolveVelocityCG(const Operator &A, Solver &prec,
+                        const Vector &B, Vector &X) const;
    void AssembleForceMatrix() const;
+   // Integrates e_source_coeff against the L2 basis of the current zones.
+   void AssembleEnergySource() const;
+   // Completes the tangling check of the stage; true if the step is aborted.
+   bool StageTangled() const;
+   // Multirate: true if the batch is updated at the synchronization point m.
+   bool MultirateActive(int b, int m) const
+   { return m % (1 << batch_level[b]) == 0; }
+   // Multirate: the velocity increment of a kick with the weights mr_weight
+   // and the current stored stress, in the fraction active of the zones;
+   // false if the step is aborted.
+   bool MultirateVelocityKick(Vector &dv, double active,
+                              bool check_tangling) const;
 
 public:
    LagrangianHydroOperator(int size, ParFiniteElementSpace &h1_fes,
@@ -123,7 +383,12 @@ public:
                            Array<int> &essential_tdofs, ParGridFunction &rho0,
                            int source_type_, double cfl_,
                            Coefficient *material_, bool visc, bool pa,
-                           double cgt, int cgiter);
+                           double cgt, int cgiter, bool pcg, int cg_recycle,
+                           int cheb_deg, bool amg, int simd_width,
+                           bool fused, int energy_solver,
+                           bool mixed_precision = false,
+                           bool recompute_jac0inv_ = false,
+                           bool dense_mass_ = false);
 
    // Solve for dx_dt, dv_dt and de_dt.
    virtual void Mult(const Vector &S, Vector &dS_dt) const;
@@ -132,22 +397,99 @@ public:
    void SolveEnergy(const Vector &S, const Vector &v, Vector &dS_dt) const;
    void UpdateMesh(const Vector &S) const;
 
+   // One kick of the multirate solver, at the synchronization point m of a
+   // step with 2^(levels-1) fine steps of size h, the nodes of S being at
+   // their positions at m. At m = 0 the zone batches are binned in levels by
+   // their time step estimates: a batch takes the largest step 2^k h, k <
+   // levels, within its estimate. The batches whose step boundaries include
+   // m are active; their quadrature data is updated at m and their forces
+   // give the velocity impulse, with weights of half their step at m = 0 and
+   // at the end, and of their step in between. The velocity increment is the
+   // H1 mass solve of the impulse, and the energies of the active zones get
+   // the same weights times the work of the forces with the average of the
+   // velocities before and after the kick. Between kicks, the solver moves
+   // the nodes with the velocity. The state of the update at m is that of a
+   // second order kick-drift-kick scheme, in which the kick at m would be
+   // split at m: the energies of the active zones are predicted with half of
+   // their steps times the rates of their last kicks, and with viscosity,
+   // the velocity with the part of the kick before m, taken from the last
+   // kick of the same class of points (the active levels at m; m = 0 and the
+   // end form one class). With one level, this is the velocity Verlet
+   // scheme. Returns false if the step is aborted.
+   bool MultirateKick(int m, int levels, double h, Vector &S) const;
+
    // Calls UpdateQuadratureData to compute the new quad_data.dt_estimate.
    double GetTimeStepEstimate(const Vector &S) const;
+   // Same as GetTimeStepEstimate, split into the local computation, which
+   // posts a nonblocking global reduction, and its completion. Work that does
+   // not depend on the global estimate can be done in between.
+   void StartTimeStepEstimate(const Vector &S) const;
+   double FinishTimeStepEstimate() const;
+   // Called at the start of every step. Also clears the abort state.
    void ResetTimeStepEstimate() const;
    void ResetQuadratureData() const { quad_data_is_current = false; }
 
+   // True when a stage of the current step found a tangled mesh. The step must
+   // then be repeated with a smaller time step.
+   bool StepAborted() const { return step_aborted; }
+   // Time step for repeating the step from time t0 with time step dt, which
+   // was either aborted or gave the global estimate dt_est < dt. An aborted
+   // step uses half of the time to the tangling, extrapolated linearly from
+   // the min Jacobian determinants of its last good stage and of the tangled
+   // one, limited to [0.1 dt, 0.85 dt]. Otherwise the new step is 0.85 dt, as
+   // without the abort, or with adaptive = true, 0.9 dt_est in the same range.
+   double RetryTimeStep(double t0, double dt, double dt_est,
+                        bool adaptive) const;
+
    // The density values, which are stored only at some quadrature points, are
    // projected as a ParGridFunction.
    void ComputeDensity(ParGridFunction &rho) const;
 
+   // Energies of this rank, and their totals over all ranks.
+   double LocalInternalEnergy(const Vector &e) const;
+   double LocalKineticEnergy(const Vector &v) const;
    double InternalEnergy(const ParGridFunction &e) const;
    double KineticEnergy(const ParGridFunction &v) const;
 
+   // Adds the sizes of the quadrature data, of the mass matrices and of the
+   // force matrix of this rank to mem.
+   void AddMemoryUsage(MemoryReport &mem) const;
+
+   // Sets the local values of the state S in diag: the energies, |e|^2, the
+   // mass, the maximal velocity and the quadrature point extrema. The
+   // quadrature data is updated for S if it is not current.
+   void SetDiagnostics(const Vector &S, Diagnostics &diag) const;
+
+   // Mixed precision check, collective. The force right-hand sides for S are
+   // computed from the single precision stress and again from the stress in
+   // double precision; force_diff is the max over both of the max norm of the
+   // difference, relative to the max norm of the double result. It is 0 with
+   // the fused force, which uses the stress in double precision. The max
+   // relative rounding error of the stored rho0DetJ0w values is mass_rounding.
+   // Nothing is counted or profiled.
+   void MixedPrecisionCheck(const Vector &S, double &force_diff,
+                            double &mass_rounding) const;
+
+   // Collective; the result is set only on rank 0. The number of steps is the
+   // number of RK stages, i.e., of the operator evaluations.
+   void ComputeTimingSummary(int steps, TimingSummary &ts) const;
    void PrintTimingData(bool IamRoot, int steps) const;
 
+   // Sets the total memory bandwidth of all ranks (bytes / second), e.g., from
+   // StreamTriadBandwidth. It is the reference of the roofline report.
+   void SetStreamBandwidth(double bw) { stream_bw = bw; }
+
    int GetH1VSize() const { return H1FESpace.GetVSize(); }
 
+   // Binary I/O of the state that is carried from step to step, besides S:
+   // the initial quadrature data, the velocity solution history and the work
+   // counters. Like GetTimeStepEstimate at the end of a step, LoadState then
+   // recomputes the quadrature data at S, so that a restarted run repeats the
+   // operations of the uninterrupted one. That update is not counted, and the
+   // counters are set to the saved ones, to which the restarted steps add.
+   void SaveState(std::ostream &os) const;
+   void LoadState(std::istream &is, const Vector &S);
+
    ~LagrangianHydroOperator();
 };
 
@@ -156,7 +498,8 @@ class TaylorCoefficient : public Coefficient
    virtual double Eval(ElementTransformation &T,
                        const IntegrationPoint &ip)
    {
-      Vector x(2);
+      double x_data[2];
+      Vector x(x_data, 2);
       T.Transform(ip, x);
       return 3.0 / 8.0 * M_PI * ( cos(3.0*M_PI*x(0)) * cos(M_PI*x(1)) -
                                   cos(M_PI*x(0))     * cos(3.0*M_PI*x(1)) );
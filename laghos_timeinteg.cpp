@@ -36,7 +36,9 @@ void HydroODESolver::Init(TimeDependentOperator &_f)
 void RK2AvgSolver::Step(Vector &S, double &t, double &dt)
 {
    const int Vsize = hydro_oper->GetH1VSize();
-   Vector V(Vsize), dS_dt(S.Size()), S0(S);
+   V.SetSize(Vsize);
+   dS_dt.SetSize(S.Size());
+   S0 = S;
 
    // The monolithic BlockVector stores the unknown fields as follows:
    // (Position, Velocity, Specific Internal Energy).
@@ -53,6 +55,7 @@ void RK2AvgSolver::Step(Vector &S, double &t, double &dt)
 
    // -- 1.
    // S is S0.
+   hydro_oper->SetTime(t);
    hydro_oper->UpdateMesh(S);
    hydro_oper->SolveVelocity(S, dS_dt);
    // V = v0 + 0.5 * dt * dv_dt;
@@ -64,6 +67,7 @@ void RK2AvgSolver::Step(Vector &S, double &t, double &dt)
    // S = S0 + 0.5 * dt * dS_dt;
    add(S0, 0.5 * dt, dS_dt, S);
    hydro_oper->ResetQuadratureData();
+   hydro_oper->SetTime(t + 0.5 * dt);
    hydro_oper->UpdateMesh(S);
    hydro_oper->SolveVelocity(S, dS_dt);
    // V = v0 + 0.5 * dt * dv_dt;
@@ -79,6 +83,29 @@ void RK2AvgSolver::Step(Vector &S, double &t, double &dt)
    t += dt;
 }
 
+void MultirateSolver::Step(Vector &S, double &t, double &dt)
+{
+   const int Vsize = hydro_oper->GetH1VSize(), n = GetSubsteps();
+   const double h = dt / n;
+
+   // The monolithic BlockVector stores the unknown fields as follows:
+   // (Position, Velocity, Specific Internal Energy).
+   Vector x(S.GetData(), Vsize), v(S.GetData() + Vsize, Vsize);
+
+   // Kicks at the fine step boundaries; in between, the nodes move with the
+   // velocity of the last kick. An aborted step is left as is and repeated.
+   for (int m = 0; m <= n; m++)
+   {
+      if (m > 0) { x.Add(h, v); }
+      hydro_oper->SetTime(t + m * h);
+      hydro_oper->UpdateMesh(S);
+      if (!hydro_oper->MultirateKick(m, levels, h, S)) { break; }
+   }
+   hydro_oper->ResetQuadratureData();
+
+   t += dt;
+}
+
 } // namespace hydrodynamics
 
 } // namespace mfem
@@ -43,12 +43,36 @@ public:
 
 class RK2AvgSolver : public HydroODESolver
 {
+protected:
+   // Stage vectors, kept between the steps.
+   Vector V, dS_dt, S0;
+
 public:
    RK2AvgSolver() { }
 
    virtual void Step(Vector &S, double &t, double &dt);
 };
 
+// Multirate kick-drift-kick time stepping (RESPA), for problems in which the
+// time step estimates of the zones differ by orders of magnitude, like Sedov.
+// A step of size dt has 2^(levels-1) fine steps; the forces and energies of
+// the zones with larger estimates are updated only every 2, 4, ... fine steps,
+// while the velocity is updated with an H1 mass solve at every fine step
+// boundary, see LagrangianHydroOperator::MultirateKick. The step dt is thus
+// 2^(levels-1) times the one of the fastest zones.
+class MultirateSolver : public HydroODESolver
+{
+protected:
+   const int levels;
+
+public:
+   MultirateSolver(int levels_) : levels(levels_) { }
+
+   int GetSubsteps() const { return 1 << (levels - 1); }
+
+   virtual void Step(Vector &S, double &t, double &dt);
+};
+
 } // namespace hydrodynamics
 
 } // namespace mfem
@@ -452,12 +452,24 @@ int main(int argc, char *argv[])
       ode_solver->Step(S, t, dt);
       steps++;
 
+      // Adaptive time step control. The global reduction of the estimate is
+      // overlapped with the local work of the new state: the host copy of the
+      // mesh positions and, at output steps, the local |e|^2 and the density.
+      // These are computed provisionally, and a rejected step discards them.
+      oper.StartTimeStepEstimate(S);
+
       // Make sure that the mesh corresponds to the new solution state.
       x_gf = d_x_gf;
       pmesh->NewNodes(x_gf, false);
+      const bool output_step = last_step || (ti % vis_steps) == 0;
+      double loc_norm = 0.0;
+      if (output_step)
+      {
+         loc_norm = d_e_gf * d_e_gf;
+         if (visualization || visit || gfprint) { oper.ComputeDensity(rho_gf); }
+      }
 
-      // Adaptive time step control.
-      const double dt_est = oper.GetTimeStepEstimate(S);
+      const double dt_est = oper.FinishTimeStepEstimate();
       if (dt_est < dt)
       {
          // Repeat (solve again) with a decreased time step - decrease of the
@@ -474,9 +486,9 @@ int main(int argc, char *argv[])
       else if (dt_est > 1.25 * dt) { dt *= 1.02; }
 
 
-      if (last_step || (ti % vis_steps) == 0)
+      if (output_step)
       {
-         double loc_norm = d_e_gf * d_e_gf, tot_norm;
+         double tot_norm;
          MPI_Allreduce(&loc_norm, &tot_norm, 1, MPI_DOUBLE, MPI_SUM,
                        pmesh->GetComm());
          if (mpi.Root())
@@ -493,7 +505,6 @@ int main(int argc, char *argv[])
          // another set of GLVis connections (one from each rank):
          MPI_Barrier(pmesh->GetComm());
 
-         if (visualization || visit || gfprint) { oper.ComputeDensity(rho_gf); }
          if (visualization)
          {
             int Wx = 0, Wy = 0; // window position
@@ -102,6 +102,7 @@ LagrangianHydroOperator::LagrangianHydroOperator(int size,
                              3*h1_fes.GetOrder(0) + l2_fes.GetOrder(0) - 1)),
      quad_data(dim, nzones, integ_rule.GetNPoints()),
      quad_data_is_current(false),
+     dt_est_local(0.0), dt_est_global(0.0), dt_est_request(MPI_REQUEST_NULL),
      VMassPA(H1compFESpace, integ_rule, &quad_data),
      EMassPA(L2FESpace, integ_rule, &quad_data),
      VMassPA_prec(H1FESpace),
@@ -272,12 +273,25 @@ void LagrangianHydroOperator::Mult(const RajaVector &S, RajaVector &dS_dt) const
 }
 
 double LagrangianHydroOperator::GetTimeStepEstimate(const RajaVector &S) const
+{
+   StartTimeStepEstimate(S);
+   return FinishTimeStepEstimate();
+}
+
+void LagrangianHydroOperator::StartTimeStepEstimate(const RajaVector &S) const
 {
    UpdateQuadratureData(S);
-   double glob_dt_est;
-   MPI_Allreduce(&quad_data.dt_est, &glob_dt_est, 1, MPI_DOUBLE, MPI_MIN,
-                 H1FESpace.GetParMesh()->GetComm());
-   return glob_dt_est;
+   // quad_data.dt_est is reset before the next step, so the reduction works
+   // on a copy.
+   dt_est_local = quad_data.dt_est;
+   MPI_Iallreduce(&dt_est_local, &dt_est_global, 1, MPI_DOUBLE, MPI_MIN,
+                  H1FESpace.GetParMesh()->GetComm(), &dt_est_request);
+}
+
+double LagrangianHydroOperator::FinishTimeStepEstimate() const
+{
+   MPI_Wait(&dt_est_request, MPI_STATUS_IGNORE);
+   return dt_est_global;
 }
 
 void LagrangianHydroOperator::ResetTimeStepEstimate() const
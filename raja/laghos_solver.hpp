@@ -91,6 +91,10 @@ protected:
    mutable QuadratureData quad_data;
    mutable bool quad_data_is_current;
 
+   // Nonblocking MIN reduction of quad_data.dt_est, see StartTimeStepEstimate.
+   mutable double dt_est_local, dt_est_global;
+   mutable MPI_Request dt_est_request;
+
    // Force matrix that combines the kinematic and thermodynamic spaces. It is
    // assembled in each time step and then it's used to compute the final
    // right-hand sides for momentum and specific internal energy.
@@ -137,6 +141,10 @@ public:
 
    // Calls UpdateQuadratureData to compute the new quad_data.dt_est.
    double GetTimeStepEstimate(const RajaVector &S) const;
+   // Same as GetTimeStepEstimate, split into the local computation, which
+   // posts a nonblocking global reduction, and its completion.
+   void StartTimeStepEstimate(const RajaVector &S) const;
+   double FinishTimeStepEstimate() const;
    void ResetTimeStepEstimate() const;
    void ResetQuadratureData() const { quad_data_is_current = false; }
 
@@ -62,6 +62,9 @@ void v0(const Vector &, Vector &);
 double e0(const Vector &);
 double gamma(const Vector &);
 void display_banner(ostream & os);
+void GetMemoryReport(const LagrangianHydroOperator &oper, const Vector &S,
+                     int ode_solver_type, FiniteElementSpace &H1FESpace,
+                     FiniteElementSpace &L2FESpace, MemoryReport &mem);
 
 int main(int argc, char *argv[])
 {
@@ -81,11 +84,13 @@ int main(int argc, char *argv[])
    int cg_max_iter = 300;
    int max_tsteps = -1;
    bool p_assembly = true;
+   bool dense_mass = false;
    bool visualization = false;
    int vis_steps = 5;
    bool visit = false;
    bool gfprint = false;
    const char *basename = "results/Laghos";
+   bool memory_report = false;
 
    OptionsParser args(argc, argv);
    args.AddOption(&mesh_file, "-m", "--mesh",
@@ -113,6 +118,11 @@ int main(int argc, char *argv[])
    args.AddOption(&p_assembly, "-pa", "--partial-assembly", "-fa",
                   "--full-assembly",
                   "Activate 1D tensor-based assembly (partial assembly).");
+   args.AddOption(&dense_mass, "-dm", "--dense-mass", "-no-dm",
+                  "--no-dense-mass",
+                  "With partial assembly, also assemble the velocity mass matrix and\n\t"
+                  "the dense zone energy mass matrices, and compute the energies\n\t"
+                  "with them. Full assembly always assembles them.");
    args.AddOption(&visualization, "-vis", "--visualization", "-no-vis",
                   "--no-visualization",
                   "Enable or disable GLVis visualization.");
@@ -124,6 +134,10 @@ int main(int argc, char *argv[])
                   "Enable or disable result output (files in mfem format).");
    args.AddOption(&basename, "-k", "--outputfilename",
                   "Name of the visit dump files");
+   args.AddOption(&memory_report, "-mem", "--memory-report", "-no-mem",
+                  "--no-memory-report",
+                  "Print the memory of the main data structures and the peak RSS\n\t"
+                  "at startup and at the end of the run.");
    args.Parse();
    if (!args.Good())
    {
@@ -132,6 +146,8 @@ int main(int argc, char *argv[])
    }
    args.PrintOptions(cout);
 
+   profiler.Begin("Setup");
+
    // Read the serial mesh from the given mesh file on all processors.
    // Refine the mesh in serial to increase the resolution.
    Mesh *mesh = new Mesh(mesh_file, 1, 1);
@@ -271,7 +287,8 @@ int main(int argc, char *argv[])
 
    LagrangianHydroOperator oper(S.Size(), H1FESpace, L2FESpace,
                                 ess_vdofs, rho, source, cfl, mat_gf_coeff,
-                                visc, p_assembly, cg_tol, cg_max_iter);
+                                visc, p_assembly, cg_tol, cg_max_iter,
+                                dense_mass);
 
    socketstream vis_rho, vis_v, vis_e;
    char vishost[] = "localhost";
@@ -323,10 +340,21 @@ int main(int argc, char *argv[])
    // time-step dt). The object oper is of type LagrangianHydroOperator that
    // defines the Mult() method that used by the time integrators.
    ode_solver->Init(oper);
+   if (memory_report)
+   {
+      MemoryReport mem;
+      GetMemoryReport(oper, S, ode_solver_type, H1FESpace, L2FESpace, mem);
+      mem.Print(cout, "Memory usage at startup");
+   }
    oper.ResetTimeStepEstimate();
    double t = 0.0, dt = oper.GetTimeStepEstimate(S), t_old;
+   profiler.End();
+   profiler.Begin("Time loop");
    bool last_step = false;
    int steps = 0;
+   // Heap allocations in the time steps after the first one (debug builds).
+   long heap_allocs = 0;
+   int heap_steps = 0;
    BlockVector S_old(S);
    for (int ti = 1; !last_step; ti++)
    {
@@ -343,15 +371,26 @@ int main(int argc, char *argv[])
 
       // S is the vector of dofs, t is the current time, and dt is the time step
       // to advance.
+      const long allocs_begin = GetHeapAllocationCount();
+      profiler.Begin("Step");
       ode_solver->Step(S, t, dt);
+      profiler.End();
       steps++;
 
       // Adaptive time step control.
+      profiler.Begin("Time step estimate");
       const double dt_est = oper.GetTimeStepEstimate(S);
+      profiler.End();
+      if (allocs_begin >= 0 && steps > 1)
+      {
+         heap_allocs += GetHeapAllocationCount() - allocs_begin;
+         heap_steps++;
+      }
       if (dt_est < dt)
       {
          // Repeat (solve again) with a decreased time step - decrease of the
          // time estimate suggests appearance of oscillations.
+         ProfileRegion region("Rejected step");
          dt *= 0.85;
          if (dt < numeric_limits<double>::epsilon())
          { MFEM_ABORT("The time step crashed!"); }
@@ -371,6 +410,7 @@ int main(int argc, char *argv[])
 
       if (last_step || (ti % vis_steps) == 0)
       {
+         ProfileRegion region("Output");
          const double loc_norm = e_gf * e_gf;
          cout << fixed;
          cout << "step " << setw(5) << ti
@@ -438,6 +478,7 @@ int main(int argc, char *argv[])
          }
       }
    }
+   profiler.End();
 
    switch (ode_solver_type)
    {
@@ -448,6 +489,20 @@ int main(int argc, char *argv[])
       case 7: steps *= 2;
    }
    oper.PrintTimingData(steps);
+   if (GetHeapAllocationCount() >= 0 && heap_steps > 0)
+   {
+      cout << endl;
+      cout << "Heap allocations per time step: "
+           << (double) heap_allocs / heap_steps << endl;
+   }
+
+   profiler.Print(cout);
+   if (memory_report)
+   {
+      MemoryReport mem;
+      GetMemoryReport(oper, S, ode_solver_type, H1FESpace, L2FESpace, mem);
+      mem.Print(cout, "Memory usage at the end of the run");
+   }
 
    const double energy_final = oper.InternalEnergy(e_gf) +
                                oper.KineticEnergy(v_gf);
@@ -603,3 +658,30 @@ void display_banner(ostream & os)
       << "   /_____/\\__,_/\\__, /_/ /_/\\____/____/  " << endl
       << "               /____/                       " << endl << endl;
 }
+
+void GetMemoryReport(const LagrangianHydroOperator &oper, const Vector &S,
+                     int ode_solver_type, FiniteElementSpace &H1FESpace,
+                     FiniteElementSpace &L2FESpace, MemoryReport &mem)
+{
+   oper.AddMemoryUsage(mem);
+   mem.Add("State S", MemoryUsage(S));
+
+   // Work vectors of the ODE solvers, some of which are allocated only in the
+   // first step, see the parallel version.
+   const long v_bytes = MemoryUsage(S), h1_bytes =
+                           H1FESpace.GetVSize() * (long) sizeof(double);
+   long ode_bytes = 0;
+   switch (ode_solver_type)
+   {
+      case 1: ode_bytes = v_bytes; break;
+      case 2: ode_bytes = 2 * v_bytes; break;
+      case 3: ode_bytes = 2 * v_bytes; break;
+      case 4: ode_bytes = 3 * v_bytes; break;
+      case 6: ode_bytes = 9 * v_bytes; break;
+      case 7: ode_bytes = h1_bytes + 2 * v_bytes; break;
+   }
+   mem.Add("ODE solver work vectors", ode_bytes);
+
+   mem.Add("H1 space", MemoryUsage(H1FESpace));
+   mem.Add("L2 space", MemoryUsage(L2FESpace));
+}
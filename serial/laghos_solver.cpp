@@ -68,7 +68,8 @@ LagrangianHydroOperator::LagrangianHydroOperator(int size,
                                                  int source_type_, double cfl_,
                                                  Coefficient *material_,
                                                  bool visc, bool pa,
-                                                 double cgt, int cgiter)
+                                                 double cgt, int cgiter,
+                                                 bool dense_mass_)
    : TimeDependentOperator(size),
      H1FESpace(h1_fes), L2FESpace(l2_fes),
      ess_tdofs(essential_tdofs),
@@ -78,9 +79,8 @@ LagrangianHydroOperator::LagrangianHydroOperator(int size,
      h1dofs_cnt(h1_fes.GetFE(0)->GetDof()),
      source_type(source_type_), cfl(cfl_),
      use_viscosity(visc), p_assembly(pa), cg_rel_tol(cgt), cg_max_iter(cgiter),
-     material_pcf(material_),
-     Mv(&h1_fes), Mv_spmat_copy(),
-     Me(l2dofs_cnt, l2dofs_cnt, nzones), Me_inv(l2dofs_cnt, l2dofs_cnt, nzones),
+     material_pcf(material_), dense_mass(!pa || dense_mass_),
+     Mv(&h1_fes), Mv_spmat_copy(), Me(), Me_inv(),
      integ_rule(IntRules.Get(h1_fes.GetMesh()->GetElementBaseGeometry(0),
                              3*h1_fes.GetOrder(0) + l2_fes.GetOrder(0) - 1)),
      quad_data(dim, nzones, integ_rule.GetNPoints()),
@@ -90,24 +90,34 @@ LagrangianHydroOperator::LagrangianHydroOperator(int size,
      locEMassPA(&quad_data, l2_fes),
      locCG(), timer()
 {
+   // The partial assembly kernels use the element-to-dof tables.
+   H1FESpace.BuildElementToDofTable();
+   L2FESpace.BuildElementToDofTable();
+
    GridFunctionCoefficient rho_coeff(&rho0);
 
-   // Standard local assembly and inversion for energy mass matrices.
-   MassIntegrator mi(rho_coeff, &integ_rule);
-   for (int i = 0; i < nzones; i++)
+   if (dense_mass)
    {
-      DenseMatrixInverse inv(&Me(i));
-      mi.AssembleElementMatrix(*l2_fes.GetFE(i),
-                               *l2_fes.GetElementTransformation(i), Me(i));
-      inv.Factor();
-      inv.GetInverseMatrix(Me_inv(i));
-   }
+      // Standard local assembly and inversion for energy mass matrices.
+      Me.SetSize(l2dofs_cnt, l2dofs_cnt, nzones);
+      Me_inv.SetSize(l2dofs_cnt, l2dofs_cnt, nzones);
+      MassIntegrator mi(rho_coeff, &integ_rule);
+      for (int i = 0; i < nzones; i++)
+      {
+         DenseMatrixInverse inv(&Me(i));
+         mi.AssembleElementMatrix(*l2_fes.GetFE(i),
+                                  *l2_fes.GetElementTransformation(i), Me(i));
+         inv.Factor();
+         inv.GetInverseMatrix(Me_inv(i));
+      }
 
-   // Standard assembly for the velocity mass matrix.
-   VectorMassIntegrator *vmi = new VectorMassIntegrator(rho_coeff, &integ_rule);
-   Mv.AddDomainIntegrator(vmi);
-   Mv.Assemble();
-   Mv_spmat_copy = Mv.SpMat();
+      // Standard assembly for the velocity mass matrix.
+      VectorMassIntegrator *vmi = new VectorMassIntegrator(rho_coeff,
+                                                           &integ_rule);
+      Mv.AddDomainIntegrator(vmi);
+      Mv.Assemble();
+      Mv_spmat_copy = Mv.SpMat();
+   }
 
    // Values of rho0DetJ0 and Jac0inv at all quadrature points.
    const int nqp = integ_rule.GetNPoints();
@@ -150,13 +160,6 @@ LagrangianHydroOperator::LagrangianHydroOperator(int size,
    }
    quad_data.h0 /= (double) H1FESpace.GetOrder(0);
 
-   ForceIntegrator *fi = new ForceIntegrator(quad_data);
-   fi->SetIntRule(&integ_rule);
-   Force.AddDomainIntegrator(fi);
-   // Make a dummy assembly to figure out the sparsity.
-   Force.Assemble(0);
-   Force.Finalize(0);
-
    if (p_assembly)
    {
       tensors1D = new Tensors1D(H1FESpace.GetFE(0)->GetOrder(),
@@ -169,6 +172,15 @@ LagrangianHydroOperator::LagrangianHydroOperator(int size,
       (dim == 2) ? VMassPA.ComputeDiagonal2D(d) : VMassPA.ComputeDiagonal3D(d);
       VMassPA_prec.SetDiagonal(d);
    }
+   else
+   {
+      ForceIntegrator *fi = new ForceIntegrator(quad_data);
+      fi->SetIntRule(&integ_rule);
+      Force.AddDomainIntegrator(fi);
+      // Make a dummy assembly to figure out the sparsity.
+      Force.Assemble(0);
+      Force.Finalize(0);
+   }
 
    locCG.SetOperator(locEMassPA);
    locCG.iterative_mode = false;
@@ -377,7 +389,7 @@ void LagrangianHydroOperator::ComputeDensity(GridFunction &rho)
 
 double LagrangianHydroOperator::InternalEnergy(const GridFunction &e) const
 {
-   Vector one(l2dofs_cnt), loc_e(l2dofs_cnt);
+   Vector one(l2dofs_cnt), loc_e(l2dofs_cnt), loc_Me(l2dofs_cnt);
    one = 1.0;
    Array<int> l2dofs;
 
@@ -386,7 +398,13 @@ double LagrangianHydroOperator::InternalEnergy(const GridFunction &e) const
    {
       L2FESpace.GetElementDofs(z, l2dofs);
       e.GetSubVector(l2dofs, loc_e);
-      ie += Me(z).InnerProduct(loc_e, one);
+      if (dense_mass) { ie += Me(z).InnerProduct(loc_e, one); }
+      else
+      {
+         locEMassPA.SetZoneId(z);
+         locEMassPA.Mult(loc_e, loc_Me);
+         ie += loc_Me.Sum();
+      }
    }
 
    return ie;
@@ -394,7 +412,20 @@ double LagrangianHydroOperator::InternalEnergy(const GridFunction &e) const
 
 double LagrangianHydroOperator::KineticEnergy(const GridFunction &v) const
 {
-   return 0.5 * Mv_spmat_copy.InnerProduct(v, v);
+   if (dense_mass) { return 0.5 * Mv_spmat_copy.InnerProduct(v, v); }
+   Vector Mv_v(v.Size());
+   VMassPA.MultStandard(v, Mv_v);
+   return 0.5 * (Mv_v * v);
+}
+
+void LagrangianHydroOperator::AddMemoryUsage(MemoryReport &mem) const
+{
+   quad_data.AddMemoryUsage(mem);
+   mem.Add("Me, Me_inv", MemoryUsage(Me) + MemoryUsage(Me_inv));
+   mem.Add("Mv", dense_mass ? MemoryUsage(Mv.SpMat()) : 0);
+   mem.Add("Mv_spmat_copy", MemoryUsage(Mv_spmat_copy));
+   // The partial assembly force operator has no matrix.
+   mem.Add("Force matrix", p_assembly ? 0 : MemoryUsage(Force.SpMat()));
 }
 
 void LagrangianHydroOperator::PrintTimingData(int steps) const
@@ -70,6 +70,9 @@ protected:
 
    // Velocity mass matrix and local inverses of the energy mass matrices. These
    // are constant in time, due to the pointwise mass conservation property.
+   // With partial assembly, they are assembled only when dense_mass is set;
+   // otherwise the energies are computed with VMassPA and locEMassPA.
+   const bool dense_mass;
    mutable BilinearForm Mv;
    SparseMatrix Mv_spmat_copy;
    DenseTensor Me, Me_inv;
@@ -121,7 +124,7 @@ public:
                            Array<int> &essential_tdofs, GridFunction &rho0,
                            int source_type_, double cfl_,
                            Coefficient *material_, bool visc, bool pa,
-                           double cgt, int cgiter);
+                           double cgt, int cgiter, bool dense_mass_ = false);
 
    // Solve for dx_dt, dv_dt and de_dt.
    virtual void Mult(const Vector &S, Vector &dS_dt) const;
@@ -142,6 +145,10 @@ public:
    double InternalEnergy(const GridFunction &e) const;
    double KineticEnergy(const GridFunction &v) const;
 
+   // Adds the sizes of the quadrature data, of the mass matrices and of the
+   // force matrix to mem.
+   void AddMemoryUsage(MemoryReport &mem) const;
+
    void PrintTimingData(int steps) const;
 
    int GetH1VSize() const { return H1FESpace.GetVSize(); }
@@ -36,7 +36,9 @@ void HydroODESolver::Init(TimeDependentOperator &_f)
 void RK2AvgSolver::Step(Vector &S, double &t, double &dt)
 {
    const int Vsize = hydro_oper->GetH1VSize();
-   Vector V(Vsize), dS_dt(S.Size()), S0(S);
+   V.SetSize(Vsize);
+   dS_dt.SetSize(S.Size());
+   S0 = S;
 
    // The monolithic BlockVector stores the unknown fields as follows:
    // (Position, Velocity, Specific Internal Energy).
@@ -43,6 +43,10 @@ public:
 
 class RK2AvgSolver : public HydroODESolver
 {
+protected:
+   // Stage vectors, kept between the steps.
+   Vector V, dS_dt, S0;
+
 public:
    RK2AvgSolver() { }
 
@@ -14,27 +14,16 @@ calc() { awk "BEGIN{print $*}"; }
 
 run_case()
 {
-    # Pass command as all inputs
-    # Outputs: order refs h1_dofs l2_dofs h1_cg_rate l2_cg_rate forces_rate update_quad_rate
+    # Pass the benchmark report file as the first input, and the command as
+    # the rest. The report has the configuration, the dof counts and all
+    # timings and rates of the run, see the --bench-report option.
 
-    "$@" | awk '
-BEGIN { refu= 0 }
-/--refine-serial/ { ref += $2 }
-/--refine-parallel/ { ref += $2 }
-/--order/ { order = $2 }
-/Number of kinematic/ { h1_dofs = $7 }
-/Number of specific internal energy/ { l2_dofs = $7 }
-/CG \(H1\) rate/ { h1_cg_rate = $9 }
-/CG \(L2\) rate/ { l2_cg_rate = $9 }
-/Forces rate/ { forces_rate = $8 }
-/UpdateQuadData rate/ { update_quad_rate = $8 }
-/Major kernels/ { total_time = $6 }
-END { printf("%d %d %d %d %.8f %.8f %.8f %.8f %.8f\n", order, ref, h1_dofs, l2_dofs, h1_cg_rate, l2_cg_rate, forces_rate, update_quad_rate, total_time) }'
+    report=$1; shift
+    "$@" --bench-report $report | grep "Major kernels total rate"
 }
 
-[ -r $outfile ] && cp $outfile $outfile.bak
-echo "# H1order refs h1_dofs l2_dofs h1_cg_rate l2_cg_rate forces_rate update_quad_rate total_time" > $outfile"_"${options[0]}
-echo "# H1order refs h1_dofs l2_dofs h1_cg_rate l2_cg_rate forces_rate update_quad_rate total_time" > $outfile"_"${options[1]}
+mkdir -p $outfile"_"${options[0]}
+mkdir -p $outfile"_"${options[1]}
 for method in "${options[@]}"; do
   for torder in {0..4}; do
     for sref in {0..10}; do
@@ -42,7 +31,8 @@ for method in "${options[@]}"; do
        nL2dof=$(( nzones*(torder+1)**2 ))
        if (( nproc <= nzones )) && (( nL2dof < maxL2dof )) ; then
          echo "np"$nproc "Q"$((torder+1))"Q"$torder $sref"ref" $method
-         echo $(run_case mpirun -np $nproc ./bind_ray.sh ../laghos -$method \
+         run_case $outfile"_"$method/np$nproc"_Q"$((torder+1))"Q"$torder"_"$sref"ref.json" \
+                  mpirun -np $nproc ./bind_ray.sh ../laghos -$method \
                        -p $problem -tf 0.5 -cfl 0.05 -vs 1 \
                        --cg-tol 0 --cg-max-steps 50 \
                        --max-steps 1 \
@@ -50,7 +40,7 @@ for method in "${options[@]}"; do
                        --refine-serial $sref \
                        --refine-parallel $parallel_refs \
                        --order-thermo $torder \
-                       --order-kinematic $((torder+1))) >> $outfile"_"$method
+                       --order-kinematic $((torder+1))
       fi
     done
   done
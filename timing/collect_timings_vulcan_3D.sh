@@ -58,26 +58,16 @@ outfile=timings_3d
 
 run_case()
 {
-    # Pass command as all inputs
-    # Outputs: order refs h1_dofs l2_dofs h1_cg_rate l2_cg_rate forces_rate update_quad_rate total_rate
+    # Pass the benchmark report file as the first input, and the command as
+    # the rest. The report has the configuration, the dof counts and all
+    # timings and rates of the run, see the --bench-report option.
 
-    "$@" | tee -a run"_"$method"_"$nodes.log | awk '
-BEGIN { ref = 0 }
-/--refine-serial/ { ref += $2 }
-/--refine-parallel/ { ref += $2 }
-/--order/ { order = $2 }
-/Number of kinematic/ { h1_dofs = $7 }
-/Number of specific internal energy/ { l2_dofs = $7 }
-/CG \(H1\) rate/ { h1_cg_rate = $9 }
-/CG \(L2\) rate/ { l2_cg_rate = $9 }
-/Forces rate/ { forces_rate = $8 }
-/UpdateQuadData rate/ { update_quad_rate = $8 }
-/Major kernels total rate/ { total_rate = $11 }
-END { printf("%d %d %d %d %.8f %.8f %.8f %.8f %.8f\n", order, ref, h1_dofs, l2_dofs, h1_cg_rate, l2_cg_rate, forces_rate, update_quad_rate, total_rate) }'
+    report=$1; shift
+    "$@" --bench-report $report | tee -a run"_"$method"_"$nodes.log | grep "Major kernels total rate"
 }
 
 for method in "${options[@]}"; do
-  echo "# order refs h1_dofs l2_dofs h1_cg_rate l2_cg_rate forces_rate update_quad_rate total_rate" > $outfile"_"$method"_"$nodes
+  mkdir -p $outfile"_"$method"_"$nodes
   for torder in ${l2orders[@]}; do
     for pref in {0..10}; do
        nzones=$(( 8**(pref+sref)*nzones0 ))
@@ -85,13 +75,14 @@ for method in "${options[@]}"; do
        echo "L2dofs: "$nL2dof "maxL2dofs: "$maxL2dof
        if (( nproc <= nzones )) && (( nL2dof > minL2dof )) && (( nL2dof < maxL2dof )) ; then
          echo "np"$nproc "Q"$((torder+1))"Q"$torder $pref"ref" $method
-         echo $(run_case srun -n $nproc ../laghos -$method -p 1 -tf 0.8 -pt $part_type \
+         run_case $outfile"_"$method"_"$nodes/np$nproc"_Q"$((torder+1))"Q"$torder"_"$pref"ref.json" \
+                  srun -n $nproc ../laghos -$method -p 1 -tf 0.8 -pt $part_type \
                        --cg-tol 0 --cg-max-steps $cg_iter \
                        --max-steps $steps \
                        --mesh $mesh_file \
                        --refine-serial $sref --refine-parallel $pref \
                        --order-thermo $torder \
-                       --order-kinematic $((torder+1))) >> $outfile"_"$method"_"$nodes
+                       --order-kinematic $((torder+1))
       fi
     done
   done
@@ -0,0 +1,46 @@
+#! /usr/bin/env python
+# -*- coding: iso-8859-1 -*-
+
+# Compares the benchmark reports (laghos --bench-report) of mixed precision runs
+# (--precision mixed) with those of the same runs in double precision: the
+# change of the total energy at the final time, the deviation of the final
+# forces of the mixed precision run from double precision, and the total rate.
+#
+# Usage: precision.py <double reports dir> <mixed reports dir>
+
+import glob, json, sys
+
+def load_reports(dirname):
+  reports = []
+  for name in sorted(glob.glob(dirname + '/*.json')):
+    with open(name) as f:
+      reports.append(json.load(f))
+  return reports
+
+# The configuration entries that identify a run, apart from the precision.
+def case_key(r):
+  return (r['config.problem'], r['config.dim'], r['config.mesh'],
+          r['config.refine_serial'], r['config.refine_parallel'],
+          r['config.order_kinematic'], r['config.order_thermo'],
+          r['config.ranks'], r['config.t_final'])
+
+if len(sys.argv) != 3:
+  print('Usage: precision.py <double reports dir> <mixed reports dir>')
+  sys.exit(1)
+
+double_runs = dict((case_key(r), r) for r in load_reports(sys.argv[1]))
+
+print('%3s %6s %10s %12s %12s %12s %12s %10s' %
+      ('dim', 'order', 'H1 dofs', 'E diff (dp)', 'E diff (mp)', 'mp - dp',
+       'F diff (mp)', 'rate mp/dp'))
+for m in sorted(load_reports(sys.argv[2]), key=lambda r: r['dofs.h1']):
+  d = double_runs.get(case_key(m))
+  if d is None:
+    continue
+  order = 'Q%dQ%d' % (m['config.order_kinematic'], m['config.order_thermo'])
+  print('%3d %6s %10d %12.2e %12.2e %12.2e %12.2e %10.3f' %
+        (m['config.dim'], order, m['dofs.h1'], d['result.energy_diff'],
+         m['result.energy_diff'],
+         m['result.energy_diff'] - d['result.energy_diff'],
+         m.get('result.mixed_precision.force_diff', 0.0),
+         m['timing.total.rate'] / d['timing.total.rate']))
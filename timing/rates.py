@@ -2,15 +2,25 @@
 # -*- coding: iso-8859-1 -*-
 
 from pylab import *
+import glob, json
 
 #rc('lines',  linestyle=None, marker='.', markersize=3)
 rc('legend', fontsize=10)
 
-txt_pa  = loadtxt("timings_3d_pa");
-txt_fa  = loadtxt("timings_3d_fa");
-txt_oc  = loadtxt("timings_3d_occa");
+# Loads the benchmark reports (laghos --bench-report) of all runs in a directory
+# written by the collect_timings scripts.
+def load_reports(dirname):
+  reports = []
+  for name in sorted(glob.glob(dirname + '/*.json')):
+    with open(name) as f:
+      reports.append(json.load(f))
+  return reports
 
-def make_plot(column, label_prefix, line_style, txt, title=None, fig=None):
+rep_pa  = load_reports("timings_3d_pa");
+rep_fa  = load_reports("timings_3d_fa");
+rep_oc  = load_reports("timings_3d_occa");
+
+def make_plot(key, label_prefix, line_style, reports, title=None, fig=None):
   cm=get_cmap('Set1') # 'Accent', 'Dark2', 'Set1', 'Set2', 'Set3'
   if '_segmentdata' in cm.__dict__:
     cm_size=len(cm.__dict__['_segmentdata']['red'])
@@ -21,17 +31,16 @@ def make_plot(column, label_prefix, line_style, txt, title=None, fig=None):
   if fig is None:
     fig = figure(figsize=(10,8))
   ax = fig.gca()
-  orders = list(set([int(x) for x in txt[:,0]]))
+  orders = sorted(set([r['config.order_kinematic'] for r in reports]))
 
   for i, p in enumerate(orders):
     dofs = []
     data = []
-    for k in range(txt.shape[0]):
-      o = txt[k,0]
-      if o == p:
-        dofs.append(txt[k, 2])
-        data.append(txt[k, 2]/txt[k, column])
-       #data.append(1e6*txt[k, column])
+    for r in sorted(reports, key=lambda r: r['dofs.h1']):
+      if r['config.order_kinematic'] == p and r[key] is not None:
+        dofs.append(r['dofs.h1'])
+        # The rates are in mega units.
+        data.append(1e6*r[key])
     pm1 = p-1
     ax.plot(dofs, data, line_style, label=label_prefix + 'Q' + str(p) + 'Q' + str(p-1),
             color=colors[i], linewidth=2)
@@ -53,9 +62,10 @@ def make_plot(column, label_prefix, line_style, txt, title=None, fig=None):
     ax.set_title(title, fontsize=18)
   return fig
 
-f1 = make_plot(8, 'PA: ', 'o-', txt_pa, title='Total Rate')
-f2 = make_plot(8, 'FA: ', 'o-', txt_fa, title='Total Rate')
-f3 = make_plot(8, 'OCCA: ', 'o-', txt_oc, title='Total Rate')
+f1 = make_plot('timing.total.rate', 'PA: ', 'o-', rep_pa, title='Total Rate')
+f2 = make_plot('timing.total.rate', 'FA: ', 'o-', rep_fa, title='Total Rate')
+f3 = make_plot('timing.total.rate', 'OCCA: ', 'o-', rep_oc,
+               title='Total Rate')
 #f1.savefig('laghos_3D_TT_PA.png', dpi=300, bbox_inches='tight')
 #f2.savefig('laghos_3D_TT_FA.png', dpi=300, bbox_inches='tight')
 #f3.savefig('laghos_3D_TT_OC.png', dpi=300, bbox_inches='tight')